@@ -0,0 +1,58 @@
+#pragma once
+// Lectura estricta de los argumentos de CryptoBench y LoadBench: lo que no se
+// entiende lanza std::invalid_argument o std::out_of_range y el llamador
+// imprime el uso y sale con 1
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Entero sin signo decimal, con sufijo K o M si allowSuffix, en [minValue, maxValue]
+inline size_t
+ParseSize(const std::string& text, bool allowSuffix = true, size_t maxValue = SIZE_MAX, size_t minValue = 0) {
+    size_t digits = 0;
+    while (digits < text.size() && text[digits] >= '0' && text[digits] <= '9') {
+        ++digits;
+    }
+    size_t multiplier = 1;
+    if (allowSuffix && digits + 1 == text.size()) {
+        char suffix = text.back();
+        if (suffix == 'K' || suffix == 'k') {
+            multiplier = 1024;
+        } else if (suffix == 'M' || suffix == 'm') {
+            multiplier = 1024 * 1024;
+        }
+    }
+    if (digits == 0 || digits + (multiplier != 1) != text.size()) {
+        throw std::invalid_argument("not a number");
+    }
+    // stoull lanza out_of_range si no cabe
+    size_t value = std::stoull(text.substr(0, digits));
+    if (value > maxValue / multiplier) {
+        throw std::out_of_range("too large");
+    }
+    if (value * multiplier < minValue) {
+        throw std::out_of_range("too small");
+    }
+    return value * multiplier;
+}
+
+// "0" o "1"
+inline bool
+ParseSwitch(const std::string& text) {
+    if (text != "0" && text != "1") {
+        throw std::invalid_argument("expected 0 or 1");
+    }
+    return text == "1";
+}
+
+// Real finito y no negativo
+inline double
+ParseRate(const std::string& text) {
+    size_t used = 0;
+    double value = std::stod(text, &used);
+    if (used != text.size() || !std::isfinite(value) || value < 0) {
+        throw std::invalid_argument("not a non-negative number");
+    }
+    return value;
+}
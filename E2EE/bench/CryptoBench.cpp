@@ -0,0 +1,260 @@
+// Micro-benchmarks de CryptoHelper. Una linea JSON por combinacion
+// (operacion, tamano, hilos) en stdout:
+//   CryptoBench [--min-size N] [--max-size N] [--threads N] [--duration-ms N] [--filter texto]
+#include "BenchArgs.h"
+#include "CryptoHelper.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define E2EE_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define E2EE_HAS_TSC 1
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    size_t minSize = 16;
+    size_t maxSize = 16 * 1024 * 1024;
+    unsigned maxThreads = 0;
+    int durationMs = 300;
+    int minIterations = 3;
+    std::string filter;
+};
+
+struct ThreadResult {
+    std::vector<uint64_t> latenciesNs;
+    uint64_t cycles = 0;
+};
+
+uint64_t
+ReadCycles() {
+#ifdef E2EE_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Operacion medida; setup corre una vez por hilo fuera de la medicion
+struct Benchmark {
+    std::string name;
+    size_t bytesPerOp;
+    std::function<std::function<void()>(CryptoHelper&)> setup;
+};
+
+uint64_t
+Percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void
+Run(const Benchmark& bench, unsigned threads, const Options& options, const CryptoHelper& identity) {
+    std::vector<ThreadResult> results(threads);
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> readyCount{0};
+    std::atomic<bool> go{false};
+    double elapsedSeconds = 0;
+
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            CryptoHelper session;
+            session.ShareRSAKeys(identity);
+            std::function<void()> op = bench.setup(session);
+            ThreadResult& result = results[t];
+
+            readyCount.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            auto deadline = Clock::now() + std::chrono::milliseconds(options.durationMs);
+            int iterations = 0;
+            while (iterations < options.minIterations || Clock::now() < deadline) {
+                auto start = Clock::now();
+                uint64_t startCycles = ReadCycles();
+                op();
+                uint64_t endCycles = ReadCycles();
+                auto end = Clock::now();
+                result.cycles += endCycles - startCycles;
+                result.latenciesNs.push_back(
+                    static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+                ++iterations;
+            }
+        });
+    }
+
+    while (readyCount.load() < threads) {
+        std::this_thread::yield();
+    }
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    elapsedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<uint64_t> latencies;
+    uint64_t cycles = 0;
+    for (ThreadResult& result : results) {
+        latencies.insert(latencies.end(), result.latenciesNs.begin(), result.latenciesNs.end());
+        cycles += result.cycles;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    uint64_t ops = latencies.size();
+    double totalBytes = static_cast<double>(ops) * bench.bytesPerOp;
+    double opsPerSec = ops / elapsedSeconds;
+    double mbPerSec = totalBytes / elapsedSeconds / (1024.0 * 1024.0);
+
+    std::cout << "{\"benchmark\":\"" << bench.name << "\""
+              << ",\"bytes\":" << bench.bytesPerOp
+              << ",\"threads\":" << threads
+              << ",\"ops\":" << ops
+              << ",\"seconds\":" << elapsedSeconds
+              << ",\"ops_per_sec\":" << opsPerSec
+              << ",\"mb_per_sec\":" << mbPerSec;
+    if (ReadCycles() != 0 && totalBytes > 0) {
+        std::cout << ",\"cycles_per_byte\":" << cycles / totalBytes;
+    } else {
+        std::cout << ",\"cycles_per_byte\":null";
+    }
+    std::cout << ",\"latency_ns\":{\"p50\":" << Percentile(latencies, 0.50)
+              << ",\"p90\":" << Percentile(latencies, 0.90)
+              << ",\"p99\":" << Percentile(latencies, 0.99)
+              << ",\"p999\":" << Percentile(latencies, 0.999)
+              << ",\"max\":" << (latencies.empty() ? 0 : latencies.back()) << "}}" << std::endl;
+}
+
+std::vector<unsigned>
+ThreadCounts(unsigned maxThreads) {
+    std::vector<unsigned> counts;
+    for (unsigned n = 1; n < maxThreads; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+void
+PrintUsage() {
+    std::cerr << "Usage: CryptoBench [--min-size N[K|M]] [--max-size N[K|M]] [--threads N] [--duration-ms N]"
+                 " [--filter texto]" << std::endl;
+}
+}
+
+int
+main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << flag << std::endl;
+            PrintUsage();
+            return 1;
+        }
+        std::string value = argv[i + 1];
+        try {
+            if (flag == "--min-size") {
+                options.minSize = ParseSize(value);
+            } else if (flag == "--max-size") {
+                options.maxSize = ParseSize(value);
+            } else if (flag == "--threads") {
+                options.maxThreads = static_cast<unsigned>(ParseSize(value, false, 4096));
+            } else if (flag == "--duration-ms") {
+                options.durationMs = static_cast<int>(ParseSize(value, false, INT_MAX));
+            } else if (flag == "--filter") {
+                options.filter = value;
+            } else {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                PrintUsage();
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (options.minSize == 0 || options.minSize > options.maxSize || options.durationMs == 0) {
+        std::cerr << "Sizes must satisfy 0 < --min-size <= --max-size and --duration-ms must be positive"
+                  << std::endl;
+        PrintUsage();
+        return 1;
+    }
+    if (options.maxThreads == 0) {
+        options.maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Identidad compartida para no pagar la generacion RSA en cada hilo
+    CryptoHelper identity;
+    identity.GenerateRSAKeys();
+    std::vector<unsigned char> wrappedKey;
+    {
+        CryptoHelper peer;
+        peer.LoadPeerPublicKey(identity.GetPublicKeyString());
+        peer.GenerateAESKey();
+        wrappedKey = peer.EncryptAESKeyWithPeer();
+    }
+
+    std::vector<Benchmark> benchmarks;
+    benchmarks.push_back({"GenerateRSAKeys", 0, [](CryptoHelper&) {
+        return std::function<void()>([] {
+            CryptoHelper helper;
+            helper.GenerateRSAKeys();
+        });
+    }});
+    benchmarks.push_back({"EncryptAESKeyWithPeer", CryptoHelper::AES_KEY_LENGTH, [&](CryptoHelper& session) {
+        session.LoadPeerPublicKey(identity.GetPublicKeyString());
+        session.GenerateAESKey();
+        return std::function<void()>([&session] { session.EncryptAESKeyWithPeer(); });
+    }});
+    benchmarks.push_back({"DecryptAESKey", CryptoHelper::AES_KEY_LENGTH, [&](CryptoHelper& session) {
+        return std::function<void()>([&session, &wrappedKey] { session.DecryptAESKey(wrappedKey); });
+    }});
+
+    // minSize <= maxSize; se para antes de que size * 4 pase de maxSize (o desborde)
+    for (size_t size = options.minSize;; size *= 4) {
+        benchmarks.push_back({"AESEncrypt", size, [size](CryptoHelper& session) {
+            session.GenerateAESKey();
+            auto plaintext = std::make_shared<std::string>(size, 'a');
+            auto iv = std::make_shared<std::vector<unsigned char>>();
+            return std::function<void()>([&session, plaintext, iv] { session.AESEncrypt(*plaintext, *iv); });
+        }});
+        benchmarks.push_back({"AESDescrypt", size, [size](CryptoHelper& session) {
+            session.GenerateAESKey();
+            auto iv = std::make_shared<std::vector<unsigned char>>();
+            auto ciphertext = std::make_shared<std::vector<unsigned char>>(
+                session.AESEncrypt(std::string(size, 'a'), *iv));
+            return std::function<void()>([&session, ciphertext, iv] { session.AESDescrypt(*ciphertext, *iv); });
+        }});
+        if (size > options.maxSize / 4) {
+            break;
+        }
+    }
+
+    for (const Benchmark& bench : benchmarks) {
+        if (!options.filter.empty() && bench.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        for (unsigned threads : ThreadCounts(options.maxThreads)) {
+            Run(bench, threads, options, identity);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,346 @@
+// Generador de carga de extremo a extremo por loopback. Arranca un Server y
+// N clientes en el mismo proceso; cada cliente hace el handshake completo y
+// luego envia mensajes cifrados que el servidor devuelve (eco). Imprime una
+// linea JSON con handshakes/s, mensajes/s, bytes/s y percentiles de latencia.
+//   LoadBench [--port N] [--clients N] [--message-size N] [--rate msgs/s] [--duration-ms N]
+//             [--address dir]       transporte por esquema: unix:/ruta, unix+seqpacket:/ruta, inproc:nombre
+//             [--shm 1]             un cliente y un eco sobre ShmChannel (ignora --clients y --rate)
+//             [--ktls 1]            los clientes piden cifrado de registros en el kernel (Linux)
+//             [--compress 1]        clientes y servidor comprimen antes de cifrar (ver Compression.h)
+//             [--batch-us N]        clientes y servidor agrupan mensajes con ese plazo (EnableBatching)
+//             [--pipeline N]        mensajes en vuelo por cliente en cada ronda
+//             [--metrics archivo]   vuelca las metricas por etapa (formato Prometheus)
+//             [--trace archivo]     traza las fases del handshake (JSON de Chrome trace)
+#include "AsyncNetwork.h"
+#include "BenchArgs.h"
+#include "Metrics.h"
+#include "Server.h"
+#include "ShmChannel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <thread>
+
+namespace {
+using Clock = EventLoop::Clock;
+
+void
+PrintUsage() {
+    std::cerr << "Usage: LoadBench [--port N] [--clients N] [--message-size N[K|M]] [--rate msgs/s]"
+                 " [--duration-ms N] [--address dir] [--shm 0|1] [--ktls 0|1] [--compress 0|1]"
+                 " [--batch-us N] [--pipeline N] [--metrics archivo] [--trace archivo]" << std::endl;
+}
+
+struct Options {
+    int port = 27015;
+    std::string address; // vacio = TCP por loopback en --port
+    Endpoint endpoint;   // destino de los clientes
+    int clients = 64;
+    size_t messageSize = 256;
+    double rate = 0; // mensajes/s en total; 0 = lazo cerrado, tan rapido como se pueda
+    int durationMs = 5000;
+    std::string metricsPath;
+    std::string tracePath;
+    bool shm = false;
+    bool kernelTls = false;
+    bool compress = false;
+    int batchUs = -1; // < 0 = sin lotes
+    int pipeline = 1;
+};
+
+struct Stats {
+    std::vector<uint64_t> handshakeNs;
+    std::vector<uint64_t> messageNs;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    int kernelTlsSessions = 0;
+    Clock::time_point firstHandshakeStart = Clock::time_point::max();
+    Clock::time_point lastHandshakeEnd = Clock::time_point::min();
+    int finished = 0;
+};
+
+uint64_t
+Nanoseconds(Clock::duration duration) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+uint64_t
+Percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+Task<void>
+RunClient(EventLoop& loop, const Options& options, Stats& stats, int index, Clock::time_point deadline) {
+    Clock::time_point handshakeStart = Clock::now();
+    SOCKET socket = co_await AsyncConnect(loop, options.endpoint);
+    if (socket == INVALID_SOCKET) {
+        ++stats.errors;
+    } else {
+        AsyncConnection connection(loop, socket, options.endpoint.transport);
+        bool established = co_await connection.Handshake(HandshakeRole::Client);
+        if (established && options.kernelTls) {
+            established = co_await connection.RequestKernelTls();
+            stats.kernelTlsSessions += connection.KernelTlsActive() ? 1 : 0;
+        }
+        if (established && options.compress) {
+            connection.EnableCompression();
+        }
+        if (established && options.batchUs >= 0) {
+            connection.EnableBatching(BATCH_DEFAULT_MAX_BYTES, std::chrono::microseconds(options.batchUs));
+        }
+        if (!established) {
+            ++stats.errors;
+        } else {
+            Clock::time_point handshakeEnd = Clock::now();
+            stats.handshakeNs.push_back(Nanoseconds(handshakeEnd - handshakeStart));
+            stats.firstHandshakeStart = std::min(stats.firstHandshakeStart, handshakeStart);
+            stats.lastHandshakeEnd = std::max(stats.lastHandshakeEnd, handshakeEnd);
+
+            std::string message(options.messageSize, static_cast<char>('a' + index % 26));
+            Clock::duration interval = Clock::duration::zero();
+            Clock::time_point next = handshakeEnd;
+            if (options.rate > 0) {
+                interval = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(options.clients / options.rate));
+                // Escalonar los clientes dentro del primer intervalo
+                next += interval * index / options.clients;
+            }
+
+            while (Clock::now() < deadline) {
+                Clock::time_point sendTime = Clock::now();
+                if (options.rate > 0) {
+                    co_await loop.SleepUntil(next);
+                    // Latencia desde el instante previsto: evita la omision coordinada
+                    sendTime = next;
+                    next += interval;
+                }
+                bool ok = true;
+                for (int i = 0; ok && i < options.pipeline; ++i) {
+                    ok = co_await connection.SendEncrypted(message);
+                }
+                for (int i = 0; ok && i < options.pipeline; ++i) {
+                    std::optional<std::string> reply = co_await connection.RecvEncrypted();
+                    ok = reply && reply->size() == message.size();
+                    if (ok) {
+                        stats.messageNs.push_back(Nanoseconds(Clock::now() - sendTime));
+                        stats.bytes += 2 * message.size();
+                    }
+                }
+                if (!ok) {
+                    ++stats.errors;
+                    break;
+                }
+            }
+            co_await connection.Flush();
+        }
+    }
+
+    if (++stats.finished == options.clients) {
+        loop.Stop();
+    }
+}
+
+// Eco en otro hilo sobre un ShmChannel: handshake por el anillo y luego
+// ping-pong cifrado en lazo cerrado
+void
+RunShm(const Options& options, Stats& stats) {
+    std::unique_ptr<ShmChannel> channel = ShmChannel::Create();
+    std::unique_ptr<ShmChannel> peer = channel ? channel->OpenPeer() : nullptr;
+    if (!peer) {
+        ++stats.errors;
+        return;
+    }
+    std::thread echo([&peer] {
+        CryptoHelper crypto;
+        crypto.GenerateRSAKeys();
+        std::shared_ptr<const std::string> publicKey = crypto.GetPublicKeyBuffer();
+        Frame frame;
+        if (!peer->SendFrame(FrameType::PublicKey, reinterpret_cast<const unsigned char*>(publicKey->data()),
+                             publicKey->size())
+            || !peer->ReceiveFrame(frame) || frame.type != FrameType::SessionKey) {
+            peer->Close();
+            return;
+        }
+        crypto.DecryptAESKey(frame.payload);
+        while (std::optional<std::string> message = peer->ReceiveEncrypted(crypto)) {
+            if (!peer->SendEncrypted(crypto, *message)) {
+                break;
+            }
+        }
+        peer->Close();
+    });
+
+    Clock::time_point handshakeStart = Clock::now();
+    CryptoHelper crypto;
+    Frame frame;
+    if (channel->ReceiveFrame(frame) && frame.type == FrameType::PublicKey) {
+        crypto.LoadPeerPublicKey(std::string(frame.payload.begin(), frame.payload.end()));
+        crypto.GenerateAESKey();
+        std::vector<unsigned char> encryptedKey = crypto.EncryptAESKeyWithPeer();
+        if (channel->SendFrame(FrameType::SessionKey, encryptedKey.data(), encryptedKey.size())) {
+            Clock::time_point handshakeEnd = Clock::now();
+            stats.handshakeNs.push_back(Nanoseconds(handshakeEnd - handshakeStart));
+            stats.firstHandshakeStart = handshakeStart;
+            stats.lastHandshakeEnd = handshakeEnd;
+
+            std::string message(options.messageSize, 'a');
+            Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(options.durationMs);
+            while (Clock::now() < deadline) {
+                Clock::time_point sendTime = Clock::now();
+                std::optional<std::string> reply;
+                if (!channel->SendEncrypted(crypto, message) || !(reply = channel->ReceiveEncrypted(crypto))
+                    || reply->size() != message.size()) {
+                    ++stats.errors;
+                    break;
+                }
+                stats.messageNs.push_back(Nanoseconds(Clock::now() - sendTime));
+                stats.bytes += 2 * message.size();
+            }
+        }
+    }
+    if (stats.handshakeNs.empty()) {
+        ++stats.errors;
+    }
+    channel->Close();
+    echo.join();
+}
+}
+
+int
+main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << flag << std::endl;
+            PrintUsage();
+            return 1;
+        }
+        std::string value = argv[i + 1];
+        try {
+            if (flag == "--port") {
+                options.port = static_cast<int>(ParseSize(value, false, 65535, 1));
+            } else if (flag == "--address") {
+                options.address = value;
+            } else if (flag == "--shm") {
+                options.shm = ParseSwitch(value);
+            } else if (flag == "--ktls") {
+                options.kernelTls = ParseSwitch(value);
+            } else if (flag == "--compress") {
+                options.compress = ParseSwitch(value);
+            } else if (flag == "--batch-us") {
+                options.batchUs = static_cast<int>(ParseSize(value, false, INT_MAX));
+            } else if (flag == "--pipeline") {
+                options.pipeline = static_cast<int>(ParseSize(value, false, 4096, 1));
+            } else if (flag == "--clients") {
+                options.clients = static_cast<int>(ParseSize(value, false, 100000, 1));
+            } else if (flag == "--message-size") {
+                // Cabe en una trama Data con su IV y el relleno
+                options.messageSize = ParseSize(value, true, MAX_FRAME_SIZE - 64, 1);
+            } else if (flag == "--rate") {
+                options.rate = ParseRate(value);
+            } else if (flag == "--duration-ms") {
+                options.durationMs = static_cast<int>(ParseSize(value, false, INT_MAX, 1));
+            } else if (flag == "--metrics") {
+                options.metricsPath = value;
+            } else if (flag == "--trace") {
+                options.tracePath = value;
+            } else {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                PrintUsage();
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.address.empty()) {
+        options.address = "127.0.0.1:" + std::to_string(options.port);
+    }
+    if (!ParseEndpoint(options.address, options.endpoint)) {
+        return 1;
+    }
+    if (options.endpoint.transport == Transport::Tcp
+        && (options.endpoint.host.empty() || options.endpoint.host == "*")) {
+        options.endpoint.host = "127.0.0.1";
+    }
+
+    Trace::SetEnabled(!options.tracePath.empty());
+
+    EventLoop loop;
+    Stats stats;
+    Clock::time_point start;
+    if (options.shm) {
+        options.clients = 1;
+        options.rate = 0;
+        start = Clock::now();
+        RunShm(options, stats);
+    } else {
+        Server server(options.address);
+        if (!server.Start()) {
+            return 1;
+        }
+        server.SetCompression(options.compress);
+        if (options.batchUs >= 0) {
+            server.SetBatching(BATCH_DEFAULT_MAX_BYTES, std::chrono::microseconds(options.batchUs));
+        }
+        std::thread serverThread([&server] { server.Run(); });
+
+        start = Clock::now();
+        Clock::time_point deadline = start + std::chrono::milliseconds(options.durationMs);
+        for (int i = 0; i < options.clients; ++i) {
+            Spawn(RunClient(loop, options, stats, i, deadline));
+        }
+        loop.Run();
+
+        server.Stop();
+        serverThread.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(stats.handshakeNs.begin(), stats.handshakeNs.end());
+    std::sort(stats.messageNs.begin(), stats.messageNs.end());
+    double handshakeWindow = stats.handshakeNs.empty()
+                                 ? 0
+                                 : std::chrono::duration<double>(stats.lastHandshakeEnd - stats.firstHandshakeStart).count();
+
+    std::cout << "{\"clients\":" << options.clients
+              << ",\"transport\":\"" << (options.shm ? "shm" : FormatEndpoint(options.endpoint)) << "\""
+              << ",\"kernel_tls_sessions\":" << stats.kernelTlsSessions
+              << ",\"message_size\":" << options.messageSize
+              << ",\"target_rate\":" << options.rate
+              << ",\"seconds\":" << elapsed
+              << ",\"handshakes\":" << stats.handshakeNs.size()
+              << ",\"handshakes_per_sec\":" << (handshakeWindow > 0 ? stats.handshakeNs.size() / handshakeWindow : 0)
+              << ",\"messages\":" << stats.messageNs.size()
+              << ",\"messages_per_sec\":" << stats.messageNs.size() / elapsed
+              << ",\"bytes_per_sec\":" << stats.bytes / elapsed
+              << ",\"errors\":" << stats.errors
+              << ",\"bytes_saved_by_compression\":"
+              << Metrics::Snapshot().Get(MetricCounter::BytesSavedByCompression)
+              << ",\"messages_coalesced\":" << Metrics::Snapshot().Get(MetricCounter::MessagesCoalesced)
+              << ",\"handshake_latency_ns\":{\"p50\":" << Percentile(stats.handshakeNs, 0.50)
+              << ",\"p99\":" << Percentile(stats.handshakeNs, 0.99)
+              << ",\"p999\":" << Percentile(stats.handshakeNs, 0.999) << "}"
+              << ",\"message_latency_ns\":{\"p50\":" << Percentile(stats.messageNs, 0.50)
+              << ",\"p99\":" << Percentile(stats.messageNs, 0.99)
+              << ",\"p999\":" << Percentile(stats.messageNs, 0.999) << "}}" << std::endl;
+
+    if (!options.metricsPath.empty()) {
+        std::ofstream metrics(options.metricsPath);
+        Metrics::WriteExposition(metrics);
+    }
+    if (!options.tracePath.empty()) {
+        std::ofstream trace(options.tracePath);
+        Trace::WriteChromeJson(trace);
+    }
+    return stats.errors == 0 ? 0 : 2;
+}
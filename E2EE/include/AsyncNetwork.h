@@ -0,0 +1,223 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include "CryptoService.h"
+#include "Endpoint.h"
+#include "EventLoop.h"
+#include "Protocol.h"
+#include "Task.h"
+#include <deque>
+#include <memory>
+#include <optional>
+
+// Valores por defecto de AsyncConnection::EnableBatching
+constexpr size_t BATCH_DEFAULT_MAX_BYTES = 16 * 1024;
+constexpr std::chrono::microseconds BATCH_DEFAULT_DELAY{200};
+
+// Valores por defecto de Server::SetTimeouts; 0 = sin limite
+constexpr std::chrono::milliseconds DEFAULT_HANDSHAKE_TIMEOUT{10000};
+constexpr std::chrono::milliseconds DEFAULT_IDLE_TIMEOUT{0};
+
+// Acepta clientes sobre un socket de escucha ya creado (NetworkHelper::StartSever)
+class E2EE_API
+    AsyncListener {
+public:
+    AsyncListener(EventLoop& loop, SOCKET listenSocket);
+
+    // INVALID_SOCKET si accept falla o el listener se cerro
+    Task<SOCKET>
+    Accept();
+
+    // Despierta a Accept() pendiente; el socket sigue perteneciendo a su dueno
+    void
+    Close();
+
+private:
+    EventLoop& m_loop;
+    SOCKET m_socket;
+    bool m_closed = false;
+};
+
+// Conexion TCP no bloqueante; INVALID_SOCKET si falla
+E2EE_API Task<SOCKET>
+AsyncConnect(EventLoop& loop, const std::string& ip, int port);
+
+// Cualquier transporte (ver ParseEndpoint); la AsyncConnection que tome el
+// socket debe crearse con endpoint.transport
+E2EE_API Task<SOCKET>
+AsyncConnect(EventLoop& loop, Endpoint endpoint);
+
+// Sesion cifrada sobre un socket. Cada operacion es una corrutina que se
+// suspende en el EventLoop mientras el socket no esta listo. La conexion
+// no debe destruirse con una operacion pendiente.
+class E2EE_API
+    AsyncConnection {
+public:
+    // Toma posesion del socket
+    AsyncConnection(EventLoop& loop, SOCKET socket, Transport transport = Transport::Tcp);
+    ~AsyncConnection();
+
+    AsyncConnection(const AsyncConnection&) = delete;
+    AsyncConnection& operator=(const AsyncConnection&) = delete;
+
+    Task<bool>
+    Send(const unsigned char* data, size_t size);
+
+    Task<bool>
+    SendFrame(FrameType type, const unsigned char* payload, size_t size);
+
+    // std::nullopt si el peer cerro o la trama no es valida
+    Task<std::optional<Frame>>
+    RecvFrame();
+
+    // Servidor: envia su clave publica y recibe la clave AES cifrada.
+    // Cliente: recibe la clave publica y envia la clave AES cifrada.
+    // Con offload, las operaciones RSA corren en CryptoService y no en el bucle.
+    // Al terminar bien, Crypto() suelta las claves RSA (ReleaseHandshakeKeys).
+    Task<bool>
+    Handshake(HandshakeRole role, CryptoService* offload = nullptr);
+
+    // Con kTLS activo el payload va en claro y lo cifra el kernel
+    Task<bool>
+    SendEncrypted(const std::string& plaintext);
+
+    // Responde a las peticiones de kTLS del cliente sin devolverlas. Los lotes
+    // (MessageBatch) se devuelven de mensaje en mensaje.
+    Task<std::optional<std::string>>
+    RecvEncrypted();
+
+    // Agrupa los mensajes de SendEncrypted en un solo registro (MessageBatch):
+    // un cifrado y un send por lote. El lote sale al juntar maxBytes o cuando
+    // pasa delay desde su primer mensaje; los mensajes mas grandes salen solos.
+    // RecvEncrypted vacia el lote antes de esperar al peer, asi que
+    // peticion/respuesta no espera al plazo.
+    void
+    EnableBatching(size_t maxBytes = BATCH_DEFAULT_MAX_BYTES, std::chrono::microseconds delay = BATCH_DEFAULT_DELAY);
+
+    // Limites sobre los temporizadores del EventLoop: al vencer se hace
+    // shutdown del socket y la operacion pendiente falla como si el peer
+    // hubiera cerrado. 0 = sin limite.
+
+    // Plazo para todo Handshake(): corta a quien conecta y no lo termina
+    void
+    SetHandshakeTimeout(std::chrono::milliseconds timeout);
+
+    // Tiempo maximo sin recibir nada
+    void
+    SetIdleTimeout(std::chrono::milliseconds timeout);
+
+    // Tras Handshake: envia una trama Heartbeat si no se envio nada en
+    // interval, para que el limite de inactividad del peer no corte una
+    // sesion viva. Si hay un envio a medias no hace falta.
+    void
+    SetHeartbeat(std::chrono::milliseconds interval);
+
+    // Envia el lote pendiente. Con lotes activos hay que esperarlo antes de
+    // destruir la conexion: el envio por plazo puede estar en curso.
+    Task<bool>
+    Flush();
+
+    // Cliente, tras Handshake: pide cifrar los registros en el kernel (ver
+    // KernelTls.h). false solo si la conexion fallo; si el kernel o el
+    // servidor no lo admiten, la sesion sigue en espacio de usuario.
+    Task<bool>
+    RequestKernelTls();
+
+    bool
+    KernelTlsActive() const;
+
+    // Comprime antes de cifrar los mensajes de SendEncrypted que lo merezcan
+    // (ver Compression.h). Solo si se pide: el tamano comprimido puede filtrar
+    // contenido. RecvEncrypted acepta CompressedData siempre.
+    void
+    EnableCompression();
+
+    CryptoHelper&
+    Crypto();
+
+    SOCKET
+    Socket() const;
+
+    EventLoop&
+    Loop();
+
+    void
+    Close();
+
+private:
+    Task<bool>
+    RecvExact(unsigned char* data, size_t size);
+
+    // SOCK_SEQPACKET: un send/recv por registro (ver SEQPACKET_RECORD_SIZE)
+    Task<bool>
+    SendRecord(const unsigned char* data, size_t size);
+
+    Task<bool>
+    RecvRecord(unsigned char* data, size_t size, int flags = 0);
+
+    Task<bool>
+    RunHandshake(HandshakeRole role, CryptoService* offload);
+
+    Task<void>
+    RunCrypto(CryptoService* offload, std::function<void(CryptoHelper&)> job);
+
+    Task<bool>
+    AnswerKernelTls();
+
+    // Data o MessageBatch, comprimido si toca
+    Task<bool>
+    SendMessage(FrameType type, const std::string& plaintext);
+
+    // Un solo envio a la vez entre el llamador y el plazo del lote
+    Task<void>
+    LockSend();
+
+    void
+    UnlockSend();
+
+    void
+    ArmBatchTimer();
+
+    // Cierra la sesion por plazo vencido
+    void
+    Expire();
+
+    void
+    ArmIdleTimer();
+
+    void
+    ArmHeartbeat(EventLoop::Clock::time_point deadline);
+
+    // Espera al plazo del lote; owner queda a nullptr al destruir la conexion
+    static Task<void>
+    FlushOnDeadline(std::shared_ptr<AsyncConnection*> owner, EventLoop& loop);
+
+    EventLoop& m_loop;
+    SOCKET m_socket;
+    Transport m_transport;
+    CryptoHelper m_crypto;
+    bool m_kernelTls = false;
+    bool m_compression = false;
+
+    size_t m_batchMaxBytes = 0; // 0 = sin lotes
+    std::chrono::microseconds m_batchDelay{0};
+    std::string m_batch;
+    size_t m_batchMessages = 0;
+    EventLoop::Clock::time_point m_batchDeadline;
+    bool m_batchTimerArmed = false;
+    bool m_batchFailed = false;
+    std::shared_ptr<AsyncConnection*> m_owner;
+    bool m_sending = false;
+    std::vector<std::coroutine_handle<>> m_sendWaiters;
+    std::deque<std::string> m_received; // resto del ultimo lote recibido
+
+    std::chrono::milliseconds m_handshakeTimeout{0};
+    std::chrono::milliseconds m_idleTimeout{0};
+    std::chrono::milliseconds m_heartbeatInterval{0};
+    EventLoop::TimerId m_idleTimer = 0;
+    EventLoop::TimerId m_heartbeatTimer = 0;
+    // Se comparan al vencer el temporizador en vez de rearmarlo en cada envio o recepcion
+    EventLoop::Clock::time_point m_lastReceive;
+    EventLoop::Clock::time_point m_lastSend;
+    bool m_writeBlocked = false; // un envio a medias espera al socket
+};
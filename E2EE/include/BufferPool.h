@@ -0,0 +1,47 @@
+#pragma once
+#include "Prerequisites.h"
+#include <array>
+#include <memory>
+#include <mutex>
+
+// Buffer del pool: vuelve al pool cuando se suelta la ultima referencia. Un
+// envio zero-copy guarda una referencia hasta que el kernel confirma que ya
+// no lee la memoria (ver NetworkHelper::EnableZeroCopy).
+using PooledBuffer = std::shared_ptr<std::vector<unsigned char>>;
+
+// Buffers grandes reutilizables para payloads cifrados. Clases de tamano en
+// potencias de dos desde MIN_BUFFER_SIZE; cada clase guarda a lo sumo
+// MAX_CACHED_PER_CLASS buffers libres. Los mayores que la ultima clase no se
+// reutilizan.
+class E2EE_API
+    BufferPool {
+public:
+    static constexpr size_t MIN_BUFFER_SIZE = 64 * 1024;
+    static constexpr size_t CLASS_COUNT = 12; // 64 KiB .. 128 MiB
+    static constexpr size_t MAX_CACHED_PER_CLASS = 8;
+
+    BufferPool() = default;
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Pool global del proceso
+    static BufferPool&
+    Instance();
+
+    // size() >= size; el contenido es el que dejo el uso anterior
+    PooledBuffer
+    Acquire(size_t size);
+
+    // Bytes en buffers libres
+    size_t
+    CachedBytes() const;
+
+private:
+    void
+    Release(std::vector<unsigned char>* buffer);
+
+    mutable std::mutex m_mutex;
+    std::array<std::vector<std::vector<unsigned char>*>, CLASS_COUNT> m_free;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include "Prerequisites.h"
+#include <optional>
+
+// Compresion opcional antes de cifrar (tramas CompressedData). El codec es un
+// LZ77 rapido con el formato de bloque de LZ4: secuencias [token][literales]
+// [offset u16 little-endian][longitud extra], sin diccionario ni entropia.
+// Comprimir antes de cifrar deja ver por el tamano cuanto se parece el
+// mensaje a si mismo (CRIME/BREACH): solo se comprime en los canales que lo
+// activan (NetworkHelper::EnableCompression, AsyncConnection::EnableCompression)
+// y no deberia mezclarse en un mismo mensaje texto del atacante con secretos.
+
+// Por debajo no compensa: cabecera y cifrado se comen el ahorro
+constexpr size_t COMPRESSION_MIN_SIZE = 256;
+// Bytes que se muestrean para estimar la entropia
+constexpr size_t COMPRESSION_SAMPLE_SIZE = 4096;
+// Entropia de orden 0 (bits por byte) a partir de la cual no se intenta:
+// datos cifrados, comprimidos o aleatorios
+constexpr double COMPRESSION_MAX_ENTROPY = 7.2;
+// [longitud original u32] delante del bloque
+constexpr size_t COMPRESSION_HEADER_SIZE = 4;
+// Lo mas que un byte de bloque puede producir al descomprimir (un byte de
+// longitud extendida); limita la longitud original que se acepta del peer
+constexpr size_t COMPRESSION_MAX_RATIO = 255;
+
+// Heuristica barata antes de comprimir: tamano minimo y entropia de una muestra
+E2EE_API bool
+LooksCompressible(const unsigned char* data, size_t size);
+
+// Comprime en out; 0 si el resultado no cabe en capacity
+E2EE_API size_t
+CompressBlock(const unsigned char* in, size_t size, unsigned char* out, size_t capacity);
+
+// false si el bloque esta mal formado o no da exactamente outSize bytes
+E2EE_API bool
+DecompressBlock(const unsigned char* in, size_t size, unsigned char* out, size_t outSize);
+
+// Texto plano de CompressedData: [longitud original u32][bloque].
+// std::nullopt si el mensaje no pasa la heuristica o no ahorra al menos 1/8.
+E2EE_API std::optional<std::string>
+CompressMessage(const std::string& plaintext);
+
+// std::nullopt si esta mal formado o la longitud original supera MAX_FRAME_SIZE
+// o COMPRESSION_MAX_RATIO veces el bloque (se comprueba antes de reservar)
+E2EE_API std::optional<std::string>
+DecompressMessage(const std::string& message);
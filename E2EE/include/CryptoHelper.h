@@ -2,13 +2,36 @@
 #include "Prerequisites.h"
 #include <openssl/rsa.h>
 #include <openssl/aes.h>
+#include <openssl/evp.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 
-class
+class AeadCipher;
+class SecureArena;
+
+class E2EE_API
     CryptoHelper {
 public:
+    static constexpr size_t AES_KEY_LENGTH = 32;
+    static constexpr size_t AEAD_NONCE_SIZE = 12;
+    static constexpr size_t AEAD_TAG_SIZE = 16;
+
+    // Expansiones AES-256 de la clave de sesion, para cifrar y descifrar
+    struct KeySchedule {
+        AES_KEY encrypt;
+        AES_KEY decrypt;
+    };
+    // Slot de la arena de expansiones: lineas de cache enteras
+    static constexpr size_t KEY_SCHEDULE_SLOT_SIZE = (sizeof(KeySchedule) + 63) / 64 * 64;
+
     CryptoHelper();
     ~CryptoHelper();
 
+    CryptoHelper(const CryptoHelper&) = delete;
+    CryptoHelper& operator=(const CryptoHelper&) = delete;
+
     // RSA
     void
     GenerateRSAKeys();
@@ -16,13 +39,38 @@ public:
     std::string
     GetPublicKeyString() const;
 
+    // PEM de la clave publica, serializado una sola vez por par de claves.
+    // El buffer es inmutable y puede enviarse directamente con SendData.
+    std::shared_ptr<const std::string>
+    GetPublicKeyBuffer() const;
+
     void
     LoadPeerPublicKey(const std::string& pemKey);
 
+    bool
+    HasRSAKeys() const;
+
+    // Usa el par de claves de otro helper (identidad de largo plazo del
+    // servidor) por referencia, junto con su PEM ya serializado
+    void
+    ShareRSAKeys(const CryptoHelper& identity);
+
+    // Tras el handshake: suelta el par de claves, la clave del peer y el PEM,
+    // que ya no hacen falta para los mensajes
+    void
+    ReleaseHandshakeKeys();
+
     // AES
     void
     GenerateAESKey();
 
+    // Arena (con slots de al menos KEY_SCHEDULE_SLOT_SIZE) donde AESEncrypt y
+    // AESDescrypt guardan la clave ya expandida, p. ej. una por hilo de
+    // EventLoop para que las sesiones de un hilo queden contiguas. Por
+    // defecto, una global. Debe vivir mas que el helper.
+    void
+    UseScheduleArena(SecureArena& arena);
+
     std::vector<unsigned char>
     EncryptAESKeyWithPeer();
 
@@ -32,12 +80,115 @@ public:
     std::vector<unsigned char>
     AESEncrypt(const std::string& plaintext, std::vector<unsigned char>& outIV);
 
+    // Salida de AESEncrypt; std::runtime_error con menos de AES_BLOCK_SIZE bytes
     std::string
     AESDescrypt(const std::vector<unsigned char>& ciphertext,
                 const std::vector<unsigned char>& iv);
 
+    // Sobre buffers del llamador (p. ej. directamente en un ShmChannel).
+    // outIV recibe AES_BLOCK_SIZE bytes y out size + AES_BLOCK_SIZE.
+    void
+    AESEncrypt(const unsigned char* plaintext, size_t size, unsigned char* outIV, unsigned char* out);
+
+    // out recibe size bytes; iv debe tener AES_BLOCK_SIZE bytes. size debe ser
+    // un multiplo no nulo de AES_BLOCK_SIZE (si no, std::runtime_error).
+    void
+    AESDescrypt(const unsigned char* ciphertext, size_t size, const unsigned char* iv, unsigned char* out);
+
+    // AES-256-GCM de los registros de archivo, con una clave derivada de la de
+    // sesion ("e2ee file record"). El nonce (AEAD_NONCE_SIZE bytes) no debe
+    // repetirse nunca con la misma clave; out recibe size bytes. Otros usos de
+    // GCM tienen su propio AeadCipher.
+    void
+    AEADEncrypt(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+                const unsigned char* plaintext, size_t size, unsigned char* out, unsigned char* tag);
+
+    // false si el registro no autentica (out queda indefinido)
+    bool
+    AEADDecrypt(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+                const unsigned char* ciphertext, size_t size, const unsigned char* tag, unsigned char* out);
+
+    // HKDF-SHA256 sobre la clave de sesion: material independiente por
+    // etiqueta (p. ej. las claves kTLS de cada sentido)
+    void
+    DeriveKeyMaterial(const char* label, unsigned char* out, size_t size) const;
+
+    // Numeracion de los datagramas de la sesion (ver DatagramSession). Vive con
+    // la clave: otro DatagramSession sobre la misma sesion sigue la cuenta en
+    // vez de volver a 1, asi que nunca repite un nonce ni acepta un registro
+    // ya visto. Vuelve a empezar solo cuando cambia la clave.
+    struct DatagramSequence {
+        std::atomic<uint64_t> nextSend{1};
+        std::atomic<uint64_t> highestReceived{0};
+    };
+
+    DatagramSequence&
+    Datagrams() {
+        return datagrams;
+    }
+
+    // Agrupa en Trace los spans de esta sesion
+    uint64_t
+    TraceId() const {
+        return traceId;
+    }
+
 private:
+    AeadCipher&
+    PrepareAEAD();
+
+    // Expande la clave la primera vez y cuando cambia, no en cada mensaje
+    const KeySchedule&
+    PrepareSchedule();
+
+    // Lo que se toca en cada mensaje va junto al principio del objeto
+
+    // Slot de SecureArena: memoria bloqueada, se borra al destruir
+    unsigned char* aesKey;
+    // Slot de scheduleArena; nullptr hasta el primer mensaje
+    KeySchedule* schedule;
+    SecureArena* scheduleArena;
+    // GCM de AEADEncrypt/AEADDecrypt; nullptr hasta el primer uso y si cambia la clave
+    std::unique_ptr<AeadCipher> aeadCipher;
+    uint64_t traceId;
+    bool scheduleKeyed;
+
+    DatagramSequence datagrams;
+
+    // Solo durante el handshake (ver ReleaseHandshakeKeys)
     RSA* rsaKeyPair;
     RSA* peerPublicKey;
-    unsigned char aesKey[32];
+    mutable std::mutex publicKeyMutex;
+    mutable std::shared_ptr<const std::string> publicKeyCache;
+};
+
+// AES-256-GCM con una clave derivada de la de sesion (DeriveKeyMaterial con
+// label). Cada uso de GCM tiene su etiqueta, asi sus nonces nunca se cruzan
+// bajo la misma clave. La clave se deriva al construir: si la sesion cambia
+// de clave despues, este objeto sigue con la anterior.
+class E2EE_API
+    AeadCipher {
+public:
+    // std::runtime_error si no se puede derivar la clave
+    AeadCipher(const CryptoHelper& session, const char* label);
+    ~AeadCipher();
+
+    AeadCipher(const AeadCipher&) = delete;
+    AeadCipher& operator=(const AeadCipher&) = delete;
+
+    // El nonce (AEAD_NONCE_SIZE bytes) no debe repetirse nunca; out recibe
+    // size bytes y tag AEAD_TAG_SIZE
+    void
+    Seal(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+         const unsigned char* plaintext, size_t size, unsigned char* out, unsigned char* tag);
+
+    // false si el registro no autentica (out queda indefinido)
+    bool
+    Open(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+         const unsigned char* ciphertext, size_t size, const unsigned char* tag, unsigned char* out);
+
+private:
+    // Con la clave ya expandida; cada registro solo cambia el nonce
+    EVP_CIPHER_CTX* m_sealContext;
+    EVP_CIPHER_CTX* m_openContext;
 };
@@ -0,0 +1,109 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+// Servicio de cifrado asincrono. Los trabajos se encolan por sesion
+// (CryptoHelper) y un pool de hilos, del tamano del numero de nucleos, los
+// ejecuta. Cada sesion se procesa en lotes por un solo hilo a la vez: el
+// orden por sesion se conserva y el contexto de cifrado sigue caliente.
+class E2EE_API
+    CryptoService {
+public:
+    struct EncryptResult {
+        std::vector<unsigned char> ciphertext;
+        std::vector<unsigned char> iv;
+    };
+
+    using Job = std::function<void(CryptoHelper&)>;
+
+    template <typename T>
+    using Callback = std::function<void(std::exception_ptr, T)>;
+
+    // workerCount = 0 usa std::thread::hardware_concurrency()
+    explicit CryptoService(size_t workerCount = 0, size_t batchSize = 32);
+
+    // Termina los trabajos pendientes antes de unir los hilos
+    ~CryptoService();
+
+    CryptoService(const CryptoService&) = delete;
+    CryptoService& operator=(const CryptoService&) = delete;
+
+    // La sesion debe seguir viva hasta que terminen sus trabajos
+    void
+    Post(CryptoHelper& session, Job job);
+
+    template <typename Fn>
+    auto
+    Submit(CryptoHelper& session, Fn fn) -> std::future<std::invoke_result_t<Fn&, CryptoHelper&>> {
+        using Result = std::invoke_result_t<Fn&, CryptoHelper&>;
+        auto promise = std::make_shared<std::promise<Result>>();
+        std::future<Result> future = promise->get_future();
+        Post(session, [promise, fn](CryptoHelper& helper) mutable {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    fn(helper);
+                    promise->set_value();
+                } else {
+                    promise->set_value(fn(helper));
+                }
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+
+    // Datos
+    std::future<EncryptResult>
+    Encrypt(CryptoHelper& session, std::string plaintext);
+
+    void
+    Encrypt(CryptoHelper& session, std::string plaintext, Callback<EncryptResult> onDone);
+
+    std::future<std::string>
+    Decrypt(CryptoHelper& session, std::vector<unsigned char> ciphertext, std::vector<unsigned char> iv);
+
+    void
+    Decrypt(CryptoHelper& session, std::vector<unsigned char> ciphertext, std::vector<unsigned char> iv,
+            Callback<std::string> onDone);
+
+    // Handshake
+    std::future<void>
+    GenerateKeys(CryptoHelper& session);
+
+    // Cliente: carga la clave publica del peer, genera la clave AES y la cifra
+    std::future<std::vector<unsigned char>>
+    WrapSessionKey(CryptoHelper& session, std::string peerPemKey);
+
+    // Servidor: descifra la clave AES recibida del peer
+    std::future<void>
+    UnwrapSessionKey(CryptoHelper& session, std::vector<unsigned char> encryptedKey);
+
+    size_t
+    WorkerCount() const;
+
+private:
+    struct SessionQueue {
+        std::deque<Job> jobs;
+        bool scheduled = false;
+    };
+
+    void
+    WorkerLoop();
+
+    size_t m_batchSize;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::unordered_map<CryptoHelper*, SessionQueue> m_sessions;
+    std::deque<CryptoHelper*> m_readySessions;
+    std::vector<std::thread> m_workers;
+    bool m_stopping = false;
+};
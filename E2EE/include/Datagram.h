@@ -0,0 +1,94 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include "Endpoint.h"
+#include "Protocol.h"
+#include <optional>
+
+// Filtro de repeticiones con ventana deslizante de 64 secuencias (como DTLS,
+// RFC 6347 4.1.2.6). Las secuencias empiezan en 1.
+class
+    ReplayWindow {
+public:
+    static constexpr uint64_t SIZE = 64;
+
+    // Todo lo que no pase de highest cuenta como ya visto
+    explicit ReplayWindow(uint64_t highest = 0) :
+        m_highest(highest), m_bitmap(highest ? ~uint64_t(0) : 0) {
+    }
+
+    // false si ya se vio o quedo por detras de la ventana
+    bool
+    IsFresh(uint64_t sequence) const {
+        if (sequence == 0) {
+            return false;
+        }
+        if (sequence > m_highest) {
+            return true;
+        }
+        uint64_t offset = m_highest - sequence;
+        return offset < SIZE && !((m_bitmap >> offset) & 1);
+    }
+
+    // Solo despues de autenticar el registro
+    void
+    Mark(uint64_t sequence) {
+        if (sequence > m_highest) {
+            uint64_t shift = sequence - m_highest;
+            m_bitmap = shift >= SIZE ? 1 : (m_bitmap << shift) | 1;
+            m_highest = sequence;
+        } else {
+            m_bitmap |= uint64_t(1) << (m_highest - sequence);
+        }
+    }
+
+private:
+    uint64_t m_highest;
+    uint64_t m_bitmap; // bit i: se recibio m_highest - i
+};
+
+// Proteccion de registros de datagrama con una clave derivada de la de sesion
+// del handshake TCP ("e2ee datagram"). Cada registro se descifra por su cuenta:
+//   [tipo u8][secuencia u64 big-endian][texto cifrado][tag GCM]
+// La cabecera va como datos asociados y el nonce es [sentido u32][secuencia],
+// asi los dos sentidos nunca repiten nonce con la misma clave. La secuencia
+// de envio y la mas alta recibida se guardan en la sesion
+// (CryptoHelper::Datagrams): si se crea otro DatagramSession (al reabrir el
+// socket UDP) sigue donde lo dejo el anterior. Lo que llegue tarde con una
+// secuencia anterior a la ultima recibida por el anterior se descarta.
+class E2EE_API
+    DatagramSession {
+public:
+    static constexpr size_t HEADER_SIZE = 9;
+    static constexpr size_t OVERHEAD = HEADER_SIZE + CryptoHelper::AEAD_TAG_SIZE;
+    // MTU de Ethernet sin cabeceras IPv4/UDP: los registros no se fragmentan
+    static constexpr size_t MAX_RECORD_SIZE = 1472;
+    static constexpr size_t MAX_PLAINTEXT_SIZE = MAX_RECORD_SIZE - OVERHEAD;
+
+    // role indica que lado del handshake es este extremo. crypto debe tener ya
+    // la clave de sesion y vivir mas que este objeto.
+    DatagramSession(CryptoHelper& crypto, HandshakeRole role);
+
+    // Escribe el registro en out (size + OVERHEAD bytes) y devuelve su tamano
+    size_t
+    Seal(const unsigned char* plaintext, size_t size, unsigned char* out);
+
+    // std::nullopt si el registro esta mal formado, no autentica o es repetido
+    std::optional<std::string>
+    Open(const unsigned char* record, size_t size);
+
+    // Destino en sockets UDP sin conectar: el origen del ultimo registro valido
+    SocketAddress&
+    Peer();
+
+    bool
+    HasPeer() const;
+
+private:
+    AeadCipher m_cipher;
+    CryptoHelper::DatagramSequence& m_sequence;
+    uint32_t m_sendDirection;
+    uint32_t m_receiveDirection;
+    ReplayWindow m_window;
+    SocketAddress m_peer;
+};
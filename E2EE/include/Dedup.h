@@ -0,0 +1,165 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include "FileTransfer.h"
+#include <array>
+#include <unordered_map>
+
+// Sincronizacion con deduplicacion (ver NetworkHelper::SyncFile). El emisor
+// corta el archivo por contenido (FastCDC: hash rodante Gear con mascaras
+// normalizadas), asi insertar o borrar bytes solo cambia los bloques de
+// alrededor. Tramas:
+//   SyncManifest emisor -> receptor  [tamano u64][bloques u32] y [SHA-256][tamano u32] por bloque
+//   SyncNeed     receptor -> emisor  mapa de bits de los bloques que hay que enviar
+//   SyncChunk    emisor -> receptor  [indice u32][texto cifrado][tag]
+//   SyncEnd      receptor -> emisor  vacio: el archivo nuevo quedo en su sitio
+// El receptor busca cada hash en el indice de lo que ya tiene (su version
+// anterior del archivo) y rearma el archivo copiando de ahi: solo los bloques
+// nuevos se cifran y viajan, y un bloque repetido viaja una vez.
+
+constexpr size_t CDC_MIN_SIZE = 16 * 1024;
+constexpr size_t CDC_AVERAGE_SIZE = 64 * 1024;
+constexpr size_t CDC_MAX_SIZE = 256 * 1024;
+constexpr size_t SYNC_MANIFEST_HEADER_SIZE = 12;
+constexpr size_t SYNC_MANIFEST_ENTRY_SIZE = 36;
+constexpr size_t SYNC_CHUNK_HEADER_SIZE = 4;
+
+using ChunkHash = std::array<unsigned char, 32>;
+
+struct ChunkHashHasher {
+    size_t
+    operator()(const ChunkHash& hash) const {
+        return static_cast<size_t>(ReadU64(hash.data())); // ya es uniforme
+    }
+};
+
+struct ContentChunk {
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    ChunkHash hash{};
+};
+
+// Longitud del primer bloque de [data, data + size)
+E2EE_API size_t
+NextChunkBoundary(const unsigned char* data, size_t size);
+
+// Corta el archivo entero y calcula el SHA-256 de cada bloque. Suelta las
+// paginas leidas a medida que avanza.
+E2EE_API std::vector<ContentChunk>
+ChunkFile(MappedFile& file);
+
+// Bloques que el receptor ya tiene en path, por hash. Se guarda en
+// path + ".chunks" con la identidad del archivo: si el archivo cambio por
+// otro lado, se vuelve a cortar.
+class E2EE_API
+    ChunkIndex {
+public:
+    // Sin archivo en path el indice queda vacio
+    bool
+    Load(const std::string& path);
+
+    const ContentChunk*
+    Find(const ChunkHash& hash) const;
+
+    // Contenido de un bloque del indice
+    const unsigned char*
+    Data(const ContentChunk& chunk) const;
+
+    // Guarda los bloques del archivo que acaba de quedar en path
+    static bool
+    Save(const std::string& path, uint64_t fingerprint, const std::vector<ContentChunk>& chunks);
+
+    // Para que la siguiente carga vuelva a cortar el archivo
+    static void
+    Discard(const std::string& path);
+
+private:
+    MappedFile m_file;
+    std::unordered_map<ChunkHash, ContentChunk, ChunkHashHasher> m_chunks;
+};
+
+// Payload de SyncManifest
+E2EE_API std::vector<unsigned char>
+EncodeSyncManifest(uint64_t size, const std::vector<ContentChunk>& chunks);
+
+// Los offsets salen de los tamanos. false si no cuadran con el total o algun
+// bloque esta vacio o supera CDC_MAX_SIZE.
+E2EE_API bool
+DecodeSyncManifest(const unsigned char* in, size_t size, std::vector<ContentChunk>& chunks);
+
+// Lado receptor de SyncFile: el indice de lo que ya hay en path y el archivo
+// nuevo, que se escribe en orden en path + ".sync" y reemplaza a path al final
+class E2EE_API
+    SyncSink {
+public:
+    SyncSink() = default;
+    ~SyncSink();
+
+    SyncSink(const SyncSink&) = delete;
+    SyncSink& operator=(const SyncSink&) = delete;
+
+    // Pide cada bloque que no este en el indice, una sola vez: las
+    // repeticiones se copian de donde quedo la primera
+    bool
+    Open(const std::string& path, std::vector<ContentChunk> chunks);
+
+    const std::vector<ContentChunk>&
+    Chunks() const;
+
+    // Mapa de bits de SyncNeed
+    const std::vector<unsigned char>&
+    Need() const;
+
+    bool
+    Needs(size_t index) const;
+
+    // Bloques en orden: data es el bloque recibido, o nullptr para copiar lo
+    // que ya se tenia
+    bool
+    Write(size_t index, const unsigned char* data);
+
+    // Reemplaza path y guarda el indice del archivo nuevo
+    bool
+    Commit();
+
+private:
+    std::string m_path;
+    std::string m_temporaryPath;
+    int m_descriptor = -1;
+    ChunkIndex m_index;
+    std::vector<ContentChunk> m_chunks;
+    std::vector<unsigned char> m_need;
+    std::unordered_map<ChunkHash, uint64_t, ChunkHashHasher> m_written; // offset de la primera aparicion
+    std::vector<unsigned char> m_copy;
+};
+
+// Cifrado convergente de bloques: la clave de cada bloque es HMAC(clave de
+// dedup de la sesion, SHA-256 del bloque) y el nonce es fijo, porque una
+// clave solo cifra siempre el mismo contenido. El mismo bloque da el mismo
+// texto cifrado dentro de la sesion y nada reconocible fuera de ella.
+class E2EE_API
+    ConvergentCipher {
+public:
+    // Lanza std::runtime_error si no se puede derivar la clave
+    explicit ConvergentCipher(const CryptoHelper& session);
+    ~ConvergentCipher();
+
+    ConvergentCipher(const ConvergentCipher&) = delete;
+    ConvergentCipher& operator=(const ConvergentCipher&) = delete;
+
+    // out: size + AEAD_TAG_SIZE bytes
+    void
+    Seal(const ChunkHash& hash, const unsigned char* data, size_t size, unsigned char* out);
+
+    // Descifra en el sitio (size bytes de texto cifrado seguidos del tag).
+    // false si no autentica o el contenido no da hash.
+    bool
+    Open(const ChunkHash& hash, unsigned char* data, size_t size);
+
+private:
+    void
+    ChunkKey(const ChunkHash& hash, unsigned char* key) const;
+
+    unsigned char m_key[CryptoHelper::AES_KEY_LENGTH];
+    EVP_CIPHER_CTX* m_context;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+// Cabecera publica de la biblioteca e2ee: transporte cifrado embebible en
+// proceso (handshake RSA + AES, tramas, servidor y cliente asincronos).
+#include "Export.h"
+#include "BufferPool.h"
+#include "Compression.h"
+#include "CryptoHelper.h"
+#include "CryptoService.h"
+#include "Datagram.h"
+#include "Dedup.h"
+#include "Endpoint.h"
+#include "Epoch.h"
+#include "FileTransfer.h"
+#include "KernelTls.h"
+#include "Merkle.h"
+#include "NetworkHelper.h"
+#include "Protocol.h"
+#include "TimerWheel.h"
+#include "EventLoop.h"
+#include "AsyncNetwork.h"
+#include "SessionTable.h"
+#include "Server.h"
+#include "ShmChannel.h"
+#include "Metrics.h"
+#include "Trace.h"
@@ -0,0 +1,65 @@
+#pragma once
+#include "Prerequisites.h"
+#include "SocketCompat.h"
+
+// Transportes seleccionables por el esquema de la direccion
+enum class Transport {
+    Tcp,           // "tcp://host:puerto" o "host:puerto"
+    Unix,          // "unix:/ruta/al/socket"           (AF_UNIX, SOCK_STREAM)
+    UnixSeqPacket, // "unix+seqpacket:/ruta/al/socket" (AF_UNIX, SOCK_SEQPACKET)
+    InProc         // "inproc:nombre"  entre hilos del mismo proceso (ver CheckInProcPeer)
+};
+
+struct Endpoint {
+    Transport transport = Transport::Tcp;
+    std::string host; // Tcp; vacio o "*" = todas las interfaces al escuchar
+    int port = 0;     // Tcp
+    std::string path; // Unix/UnixSeqPacket: ruta; InProc: nombre
+};
+
+// Direccion de socket lista para bind/connect
+struct SocketAddress {
+    sockaddr_storage storage{};
+    socklen_t length = 0;
+    int family = AF_INET;
+    int type = SOCK_STREAM;
+    int protocol = 0;
+};
+
+// false (y mensaje en std::cerr) si la direccion no es valida
+E2EE_API bool
+ParseEndpoint(const std::string& address, Endpoint& endpoint);
+
+E2EE_API std::string
+FormatEndpoint(const Endpoint& endpoint);
+
+// Un mensaje por llamada a send/recv. Las tramas se parten en registros de a
+// lo sumo SEQPACKET_RECORD_SIZE bytes (el primero lleva la cabecera) para no
+// depender del tamano del buffer de envio del socket.
+constexpr size_t SEQPACKET_RECORD_SIZE = 64 * 1024;
+
+inline bool
+IsMessageOriented(Transport transport) {
+    return transport == Transport::UnixSeqPacket;
+}
+
+// Direccion para bind (listening) o connect. Para InProc, al escuchar se
+// reserva una direccion propia del proceso (un nombre abstracto AF_UNIX en
+// Linux, un puerto de loopback en otras plataformas) y al conectar se busca
+// el nombre en el registro; falla si nadie escucha con ese nombre.
+E2EE_API bool
+ResolveEndpoint(const Endpoint& endpoint, bool listening, SocketAddress& address);
+
+// Publica / retira un nombre InProc una vez que el socket ya escucha
+E2EE_API bool
+RegisterInProc(const std::string& name, const SocketAddress& address);
+
+E2EE_API void
+UnregisterInProc(const std::string& name);
+
+// Tras accept: false si listenSocket es un listener InProc y el peer es otro
+// proceso (SO_PEERCRED); el llamador debe cerrar clientSocket. Solo Linux:
+// en otras plataformas InProc es loopback TCP, alcanzable por cualquier
+// usuario local, y esto siempre devuelve true.
+E2EE_API bool
+CheckInProcPeer(SOCKET listenSocket, SOCKET clientSocket);
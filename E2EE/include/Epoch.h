@@ -0,0 +1,38 @@
+#pragma once
+#include "Prerequisites.h"
+#include <functional>
+
+// Reclamacion por epocas (Fraser): los lectores no toman cerrojos ni
+// contadores compartidos. Cada hilo anuncia en su propio registro la epoca
+// global al entrar en un EpochGuard. Lo que un escritor desenlaza se retira
+// con la epoca del momento y se libera cuando la global ha avanzado dos veces:
+// para entonces ningun hilo que pudiera verlo sigue dentro de un EpochGuard.
+// La global solo avanza si todos los hilos dentro de un EpochGuard ya han
+// visto la actual, asi que un lector que no sale retrasa la liberacion.
+//
+// Un registro por hilo (hasta EPOCH_MAX_THREADS a la vez); se recicla al
+// terminar el hilo.
+
+constexpr size_t EPOCH_MAX_THREADS = 256;
+
+// Mientras viva, nada de lo retirado despues de crearlo se libera.
+// Se puede anidar. Solo en la pila: no cruza hilos ni un co_await.
+class E2EE_API
+    EpochGuard {
+public:
+    EpochGuard();
+    ~EpochGuard();
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+// Llama a fn (desde cualquier hilo) cuando ningun lector pueda seguir
+// viendo lo que se desenlazo antes de retirarlo. Seguro desde cualquier hilo.
+E2EE_API void
+EpochRetire(std::function<void()> fn);
+
+// Intenta avanzar la epoca y liberar lo retirado. EpochRetire ya lo hace;
+// sirve para vaciar la lista cuando no se retira nada nuevo.
+E2EE_API void
+EpochCollect();
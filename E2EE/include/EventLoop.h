@@ -0,0 +1,203 @@
+#pragma once
+#include "Prerequisites.h"
+#include "NetworkHelper.h"
+#include "TimerWheel.h"
+#include <chrono>
+#include <cstdint>
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+// Bucle de eventos de un solo hilo sobre epoll (Linux) o WSAPoll. Las
+// corrutinas que esperan un socket se suspenden aqui y se reanudan cuando el
+// socket esta listo, de modo que miles de sesiones comparten el hilo que llama
+// a Run(). El registro de cada socket persiste entre vueltas: esperar o
+// cancelar cuesta O(1) y no depende del numero de sesiones.
+class E2EE_API
+    EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = TimerWheel::TimerId;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Procesa eventos hasta que se llame a Stop()
+    void
+    Run();
+
+    // Seguro desde cualquier hilo
+    void
+    Stop();
+
+    // Ejecuta fn en el hilo del bucle. Seguro desde cualquier hilo.
+    void
+    Post(std::function<void()> fn);
+
+    void
+    WaitReadable(SOCKET socket, std::coroutine_handle<> handle);
+
+    void
+    WaitWritable(SOCKET socket, std::coroutine_handle<> handle);
+
+    // Reanuda a todas las corrutinas que esperan este socket, esten listas o no
+    void
+    Cancel(SOCKET socket);
+
+    void
+    ResumeAt(Clock::time_point deadline, std::coroutine_handle<> handle);
+
+    // Llama a fn en el hilo del bucle al llegar deadline (ver TimerWheel.h).
+    // Solo desde el hilo del bucle.
+    TimerId
+    AddTimer(Clock::time_point deadline, std::function<void()> fn);
+
+    // false si ya vencio o ya se cancelo. Solo desde el hilo del bucle.
+    bool
+    CancelTimer(TimerId id);
+
+    struct SocketAwaiter {
+        EventLoop& loop;
+        SOCKET socket;
+        bool write;
+
+        bool
+        await_ready() const noexcept {
+            return false;
+        }
+
+        void
+        await_suspend(std::coroutine_handle<> handle) {
+            if (write) {
+                loop.WaitWritable(socket, handle);
+            } else {
+                loop.WaitReadable(socket, handle);
+            }
+        }
+
+        void
+        await_resume() const noexcept {
+        }
+    };
+
+    // co_await loop.Readable(s) / co_await loop.Writable(s)
+    SocketAwaiter
+    Readable(SOCKET socket) {
+        return SocketAwaiter{*this, socket, false};
+    }
+
+    SocketAwaiter
+    Writable(SOCKET socket) {
+        return SocketAwaiter{*this, socket, true};
+    }
+
+    // Reanuda la corrutina en el hilo del bucle (p. ej. tras un trabajo en CryptoService)
+    struct ResumeAwaiter {
+        EventLoop& loop;
+
+        bool
+        await_ready() const noexcept {
+            return false;
+        }
+
+        void
+        await_suspend(std::coroutine_handle<> handle) {
+            loop.Post([handle] { handle.resume(); });
+        }
+
+        void
+        await_resume() const noexcept {
+        }
+    };
+
+    ResumeAwaiter
+    Schedule() {
+        return ResumeAwaiter{*this};
+    }
+
+    struct TimerAwaiter {
+        EventLoop& loop;
+        Clock::time_point deadline;
+
+        bool
+        await_ready() const noexcept {
+            return deadline <= Clock::now();
+        }
+
+        void
+        await_suspend(std::coroutine_handle<> handle) {
+            loop.ResumeAt(deadline, handle);
+        }
+
+        void
+        await_resume() const noexcept {
+        }
+    };
+
+    TimerAwaiter
+    SleepUntil(Clock::time_point deadline) {
+        return TimerAwaiter{*this, deadline};
+    }
+
+    TimerAwaiter
+    SleepFor(Clock::duration delay) {
+        return TimerAwaiter{*this, Clock::now() + delay};
+    }
+
+private:
+    // Un registro por socket con las corrutinas que esperan leer o escribir.
+    // events es el interes registrado (POLLIN/POLLOUT).
+    struct Watch {
+        SOCKET socket;
+        short events;
+        std::vector<std::coroutine_handle<>> readers;
+        std::vector<std::coroutine_handle<>> writers;
+    };
+
+    void
+    AddWaiter(SOCKET socket, bool write, std::coroutine_handle<> handle);
+
+    // Ajusta el interes de m_watches[index] a sus esperas; added si es nuevo
+    void
+    UpdateInterest(size_t index, bool added);
+
+    // Pasa a ready las esperas satisfechas por revents (bits POLL*)
+    void
+    TakeReady(size_t index, short revents, std::vector<std::coroutine_handle<>>& ready);
+
+    // Quita m_watches[index] moviendo el ultimo a su hueco
+    void
+    RemoveWatch(size_t index);
+
+    int
+    PollTimeoutMs() const;
+
+    void
+    Wake();
+
+    void
+    DrainWakeups();
+
+    SOCKET m_wakeSocket = INVALID_SOCKET;
+    std::vector<Watch> m_watches;
+    std::unordered_map<SOCKET, size_t> m_watchIndex;
+#ifdef __linux__
+    int m_epoll = -1;
+    std::vector<epoll_event> m_events;
+#else
+    // [0] es m_wakeSocket; [i + 1] corresponde a m_watches[i]
+    std::vector<WSAPOLLFD> m_pollSet;
+#endif
+    std::vector<std::coroutine_handle<>> m_cancelled;
+    TimerWheel m_timers;
+    std::mutex m_postMutex;
+    std::vector<std::function<void()>> m_posted;
+    bool m_stopping = false;
+};
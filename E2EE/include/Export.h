@@ -0,0 +1,18 @@
+#pragma once
+
+// Visibilidad de la API publica. La biblioteca estatica no necesita nada; al
+// compilarla como compartida (E2EE_SHARED) se exportan solo los simbolos
+// marcados con E2EE_API y el resto queda oculto.
+#if defined(E2EE_SHARED)
+#if defined(_WIN32)
+#if defined(E2EE_BUILDING_LIBRARY)
+#define E2EE_API __declspec(dllexport)
+#else
+#define E2EE_API __declspec(dllimport)
+#endif
+#else
+#define E2EE_API __attribute__((visibility("default")))
+#endif
+#else
+#define E2EE_API
+#endif
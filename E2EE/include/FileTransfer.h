@@ -0,0 +1,241 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include "Merkle.h"
+#include "Protocol.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Transferencia de archivos sobre una o varias sesiones en paralelo (ver
+// NetworkHelper::SendFile y SendFileParallel). Tramas de cada stream:
+//   FileStart    emisor -> receptor  FileInfo
+//   FileManifest emisor -> receptor  hojas de Merkle de los bloques y raiz autenticada
+//   FileResume   receptor -> emisor  mapa de bloques que el receptor ya tiene
+//   FileChunk    emisor -> receptor  un bloque y su offset
+//   FileEnd      emisor -> receptor  vacio: este stream no envia mas bloques
+//   FileEnd      receptor -> emisor  vacio: el archivo completo quedo escrito
+// Los streams toman los bloques pendientes de una cola comun, asi una
+// conexion lenta no retrasa a las demas.
+// En espacio de usuario cada payload es un registro AES-GCM independiente:
+//   [offset u64][nonce][texto cifrado][tag]
+// con [tipo][id de transferencia][offset] como datos asociados, asi un bloque
+// no puede moverse a otra posicion ni a otra transferencia. La clave GCM se
+// deriva de la de sesion solo para estos registros (CryptoHelper::AEADEncrypt)
+// y el nonce es aleatorio.
+// Con kTLS el payload es [offset u64][datos] en claro y los bloques salen del
+// archivo con sendfile.
+// Ademas cada bloque se compara con su hoja del manifiesto al llegar, en el
+// hilo de su stream. Al reanudar, los bloques ya escritos se vuelven a
+// comprobar en paralelo y los que no coinciden se piden otra vez.
+
+constexpr size_t FILE_CHUNK_SIZE = 1024 * 1024;
+constexpr int DEFAULT_FILE_STREAMS = 4;
+constexpr int MAX_FILE_STREAMS = 16;
+// Espera del receptor por cada stream anunciado que aun no se conecto
+constexpr int FILE_STREAM_ACCEPT_TIMEOUT_MS = 10000;
+constexpr size_t FILE_RECORD_HEADER_SIZE = 8;
+constexpr size_t FILE_RECORD_OVERHEAD =
+    FILE_RECORD_HEADER_SIZE + CryptoHelper::AEAD_NONCE_SIZE + CryptoHelper::AEAD_TAG_SIZE;
+
+#ifndef _WIN32
+// pwrite completo: reintenta las escrituras parciales
+E2EE_API bool
+WriteAt(int descriptor, const unsigned char* data, size_t size, uint64_t offset);
+#endif
+
+// Identidad estable del archivo mientras no cambie: dispositivo, inodo, tamano,
+// mtime y salt. 0 si no se puede leer.
+E2EE_API uint64_t
+FileFingerprint(int descriptor, uint32_t salt);
+
+// Payload de FileStart: [id u64][tamano u64][tamano de bloque u32][streams u16].
+// El id sale de los metadatos del archivo: es el mismo al reintentar.
+struct FileInfo {
+    static constexpr size_t ENCODED_SIZE = 22;
+
+    uint64_t transferId = 0;
+    uint64_t size = 0;
+    uint32_t chunkSize = 0;
+    uint16_t streams = 1;
+
+    uint64_t
+    ChunkCount() const;
+
+    void
+    Encode(unsigned char* out) const;
+
+    // false si el tamano de bloque no cabe en una trama o sobran streams
+    bool
+    Decode(const unsigned char* in, size_t size);
+
+    bool
+    operator==(const FileInfo& other) const = default;
+};
+
+// Payload de FileManifest: [raiz][HMAC-SHA256 de FileInfo y raiz][hoja de cada
+// bloque]. La clave del HMAC se deriva de la de sesion, asi el manifiesto queda
+// autenticado una vez tambien cuando kTLS lleva los bloques en claro.
+E2EE_API std::vector<unsigned char>
+EncodeFileManifest(const CryptoHelper& crypto, const FileInfo& info, const MerkleTree& tree);
+
+// false si el HMAC no autentica, falta alguna hoja o las hojas no dan la raiz
+E2EE_API bool
+DecodeFileManifest(const CryptoHelper& crypto, const FileInfo& info, const unsigned char* in, size_t size,
+                   MerkleTree& tree);
+
+// Archivo de solo lectura proyectado en memoria. Solo POSIX: en Windows Open
+// devuelve false.
+class E2EE_API
+    MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool
+    Open(const std::string& path);
+
+    // nullptr si el archivo esta vacio
+    const unsigned char*
+    Data() const;
+
+    uint64_t
+    Size() const;
+
+    // Para sendfile
+    int
+    Descriptor() const;
+
+    // Suelta las paginas ya leidas del rango: siguen en la cache del sistema,
+    // pero dejan de contar en la memoria residente del proceso
+    void
+    Release(uint64_t offset, size_t size);
+
+private:
+    int m_descriptor = -1;
+    unsigned char* m_data = nullptr;
+    uint64_t m_size = 0;
+};
+
+// Escribe el registro en out (FILE_RECORD_OVERHEAD + size bytes)
+E2EE_API void
+SealFileRecord(CryptoHelper& crypto, FrameType type, uint64_t transferId, uint64_t offset,
+               const unsigned char* data, size_t size, unsigned char* out);
+
+// Descifra sobre el propio registro; data queda apuntando al texto plano.
+// false si el registro esta mal formado o no autentica.
+E2EE_API bool
+OpenFileRecord(CryptoHelper& crypto, FrameType type, uint64_t transferId, unsigned char* record, size_t size,
+               uint64_t& offset, unsigned char*& data, size_t& length);
+
+// Lado emisor: el archivo, su manifiesto y la cola de bloques pendientes que
+// comparten los streams
+class E2EE_API
+    FileSource {
+public:
+    // Calcula las hojas del manifiesto repartiendo los bloques entre los nucleos
+    bool
+    Open(const std::string& path, size_t chunkSize, int streams);
+
+    const FileInfo&
+    Info() const;
+
+    const MerkleTree&
+    Manifest() const;
+
+    MappedFile&
+    File();
+
+    // Descarta los bloques que el receptor ya tiene (FileResume). Solo antes
+    // de empezar a enviar.
+    bool
+    SkipHeld(const unsigned char* bitmap, size_t size);
+
+    // Siguiente bloque pendiente; false cuando no quedan. Seguro entre hilos.
+    bool
+    Next(uint64_t& offset, size_t& size);
+
+private:
+    MappedFile m_file;
+    FileInfo m_info;
+    MerkleTree m_manifest;
+    std::vector<unsigned char> m_held; // mapa de bits, como en FileResume
+    std::atomic<uint64_t> m_next{0};
+};
+
+// Lado receptor: el archivo de destino y el mapa de bloques escritos, que se
+// guarda en path + ".resume" a medida que llegan. Si la transferencia se corta,
+// la siguiente con el mismo FileInfo sigue donde quedo. Los streams escriben
+// desde hilos distintos.
+class E2EE_API
+    FileSink {
+public:
+    FileSink() = default;
+    ~FileSink();
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    // Retoma el estado guardado si corresponde a info; si no, empieza de cero
+    bool
+    Open(const std::string& path, const FileInfo& info);
+
+    bool
+    IsOpen() const;
+
+    const FileInfo&
+    Info() const;
+
+    // Fija el manifiesto (antes de arrancar los streams) y comprueba en
+    // paralelo los bloques que ya estaban escritos: los que no coinciden
+    // vuelven a faltar
+    bool
+    SetManifest(MerkleTree manifest);
+
+    const MerkleTree&
+    Manifest() const;
+
+    // true si el bloque coincide con su hoja. Sin bloqueo: el manifiesto no
+    // cambia mientras reciben los streams.
+    bool
+    Matches(uint64_t offset, const unsigned char* data, size_t size) const;
+
+    // Un bit por bloque, el bloque i en el bit (i % 8) del byte i / 8
+    std::vector<unsigned char>
+    Bitmap() const;
+
+    // Escribe un bloque completo en su offset y lo marca. Repetir un bloque
+    // no es un error.
+    bool
+    Write(uint64_t offset, const unsigned char* data, size_t size);
+
+    // Cada stream se registra al empezar y avisa al terminar
+    void
+    AddStream();
+
+    void
+    EndStream();
+
+    // Espera a que el archivo este completo o no quede ningun stream activo
+    bool
+    WaitComplete();
+
+    // Cierra; con el archivo completo borra el estado de reanudacion
+    bool
+    Finish();
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::string m_statePath;
+    int m_descriptor = -1;
+    int m_stateDescriptor = -1;
+    FileInfo m_info;
+    MerkleTree m_manifest;
+    std::vector<unsigned char> m_bitmap;
+    uint64_t m_missing = 0;
+    int m_streams = 0;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include "Protocol.h"
+#include "SocketCompat.h"
+
+// Cifrado de registros en el kernel (kTLS, Linux). Tras el handshake cada
+// sentido del socket se programa con AES-256-GCM en registros TLS 1.3: send()
+// entrega texto plano y el kernel lo cifra; recv() devuelve el texto ya
+// descifrado. Asi sendfile puede enviar archivos cifrados y desaparece la
+// copia por espacio de usuario. La clave de cada sentido se deriva de la clave
+// de sesion con HKDF, de modo que no comparte nonces con DatagramSession.
+//
+// Negociacion, en claro y siempre iniciada por el cliente:
+//   cliente  -> KernelTls []        solo si pudo preparar su socket
+//   servidor -> KernelTls [0 | 1]   con 1 activa TX y RX antes de leer nada mas
+//   el cliente lee la respuesta y con 1 activa RX y TX
+// Con 0 (sin modulo tls, AF_UNIX...) la sesion sigue cifrando en espacio de usuario.
+
+// Prepara el socket (TCP_ULP "tls"). Sin claves el socket se comporta igual
+// que antes, asi que un fallo no obliga a nada.
+E2EE_API bool
+AttachKernelTls(SOCKET socket);
+
+// Programa las claves de los dos sentidos. Si falla a medias la conexion
+// queda inservible y hay que cerrarla.
+E2EE_API bool
+EnableKernelTls(SOCKET socket, const CryptoHelper& crypto, HandshakeRole role);
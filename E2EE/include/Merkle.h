@@ -0,0 +1,39 @@
+#pragma once
+#include "Prerequisites.h"
+#include <array>
+
+// Arbol de Merkle SHA-256 con separacion de dominios como RFC 6962: hoja =
+// H(0x00 || datos), nodo = H(0x01 || izquierdo || derecho). Un nodo sin pareja
+// sube tal cual al nivel siguiente. Se transmiten todas las hojas: con la raiz
+// autenticada una sola vez y las hojas comprobadas contra ella, cada bloque se
+// compara con su hoja por separado, en cualquier orden y en cualquier hilo.
+
+constexpr size_t MERKLE_HASH_SIZE = 32;
+
+using MerkleHash = std::array<unsigned char, MERKLE_HASH_SIZE>;
+
+E2EE_API MerkleHash
+MerkleLeaf(const unsigned char* data, size_t size);
+
+E2EE_API MerkleHash
+MerkleNode(const MerkleHash& left, const MerkleHash& right);
+
+class E2EE_API
+    MerkleTree {
+public:
+    // Arbol sin hojas
+    MerkleTree();
+
+    explicit MerkleTree(std::vector<MerkleHash> leaves);
+
+    // Sin hojas la raiz es H() (RFC 6962 2.1)
+    const MerkleHash&
+    Root() const;
+
+    const std::vector<MerkleHash>&
+    Leaves() const;
+
+private:
+    std::vector<MerkleHash> m_leaves;
+    MerkleHash m_root{};
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include "Prerequisites.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Etapas con histograma de latencia (nanosegundos)
+enum class MetricStage : size_t {
+    Send,          // envio completo de una trama o buffer
+    Receive,       // cuerpo de la trama, desde que llega la cabecera
+    Encrypt,       // AESEncrypt
+    Decrypt,       // AESDescrypt
+    KeyGeneration, // GenerateRSAKeys
+    KeyLoad,       // LoadPeerPublicKey
+    KeyWrap,       // EncryptAESKeyWithPeer
+    KeyUnwrap,     // DecryptAESKey
+    Handshake,     // handshake completo, lado servidor o cliente
+    Count
+};
+
+// Contadores monotonos
+enum class MetricCounter : size_t {
+    BytesSent,
+    BytesReceived,
+    MessagesSent,
+    MessagesReceived,
+    SendErrors,
+    ReceiveErrors,
+    BytesEncrypted,
+    BytesDecrypted,
+    CryptoErrors,
+    Handshakes,
+    HandshakeErrors,
+    DatagramsDropped,        // registros UDP que no autentican, repetidos o fuera de la ventana
+    BytesZeroCopied,         // bytes entregados al kernel con MSG_ZEROCOPY
+    KernelTlsSessions,       // sesiones con el cifrado de registros en el kernel
+    BytesDeduplicated,       // bytes que SyncFile no envio porque el receptor ya los tenia
+    BytesSavedByCompression, // texto plano que no hizo falta cifrar ni enviar (CompressedData)
+    MessagesCoalesced,       // mensajes enviados dentro de una trama MessageBatch
+    ConnectionsTimedOut,     // sesiones cortadas por plazo de handshake o inactividad
+    Count
+};
+
+constexpr size_t METRIC_STAGE_COUNT = static_cast<size_t>(MetricStage::Count);
+constexpr size_t METRIC_COUNTER_COUNT = static_cast<size_t>(MetricCounter::Count);
+
+// Histograma log-lineal estilo HDR: 16 sub-cubetas por potencia de dos
+// (error relativo < 6.25%) hasta 2^42 ns; los valores mayores van a la ultima.
+struct E2EE_API HistogramSnapshot {
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int MAX_EXPONENT = 42;
+    static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    std::array<uint64_t, BUCKET_COUNT> buckets{};
+
+    static size_t
+    BucketFor(uint64_t value);
+
+    // Mayor valor que cae en la cubeta
+    static uint64_t
+    BucketUpperBound(size_t bucket);
+
+    // p en [0, 1]
+    uint64_t
+    Percentile(double p) const;
+
+    double
+    Mean() const;
+};
+
+struct MetricsSnapshot {
+    std::array<uint64_t, METRIC_COUNTER_COUNT> counters{};
+    std::array<HistogramSnapshot, METRIC_STAGE_COUNT> stages{};
+
+    uint64_t
+    Get(MetricCounter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    const HistogramSnapshot&
+    Get(MetricStage stage) const {
+        return stages[static_cast<size_t>(stage)];
+    }
+};
+
+// Metricas del proceso. Cada hilo escribe solo en su propio bloque (cargas y
+// almacenamientos relajados, sin candados ni RMW); Snapshot() suma todos los
+// bloques bajo demanda. Los bloques de hilos terminados se reutilizan.
+class E2EE_API
+    Metrics {
+public:
+    static void
+    Record(MetricStage stage, uint64_t nanoseconds);
+
+    static void
+    Add(MetricCounter counter, uint64_t value = 1);
+
+    static MetricsSnapshot
+    Snapshot();
+
+    // Formato de texto de Prometheus (version 0.0.4)
+    static void
+    WriteExposition(std::ostream& out);
+
+    static std::string
+    Exposition();
+
+    static const char*
+    Name(MetricStage stage);
+
+    static const char*
+    Name(MetricCounter counter);
+};
+
+// Mide desde la construccion hasta la destruccion (o hasta Stop)
+class
+    LatencyTimer {
+public:
+    explicit LatencyTimer(MetricStage stage) :
+        m_stage(stage), m_start(std::chrono::steady_clock::now()) {
+    }
+
+    ~LatencyTimer() {
+        Stop();
+    }
+
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+    void
+    Stop() {
+        if (m_running) {
+            m_running = false;
+            auto elapsed = std::chrono::steady_clock::now() - m_start;
+            Metrics::Record(m_stage, static_cast<uint64_t>(
+                                         std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    // Descarta la medicion (p. ej. si la operacion fallo)
+    void
+    Cancel() {
+        m_running = false;
+    }
+
+private:
+    MetricStage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+    bool m_running = true;
+};
@@ -1,10 +1,19 @@
 #pragma once
 #include "Prerequisites.h"
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#pragma comment(lib, "Ws2_32.lib")
+#include "BufferPool.h"
+#include "Datagram.h"
+#include "Protocol.h"
+#include "SocketCompat.h"
+#include "Endpoint.h"
+#include "FileTransfer.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <unordered_map>
 
-class
+class E2EE_API
     NetworkHelper {
 public:
     NetworkHelper();
@@ -17,6 +26,11 @@ public:
     bool
     StartSever(int port);
 
+    // Direccion con esquema: "tcp://host:puerto", "unix:/ruta",
+    // "unix+seqpacket:/ruta" o "inproc:nombre" (ver Endpoint.h)
+    bool
+    StartSever(const std::string& address);
+
     SOCKET
     AcceptClient();
 
@@ -24,6 +38,17 @@ public:
     bool
     ConnectToServer(const std::string& ip, int port);
 
+    bool
+    ConnectToServer(const std::string& address);
+
+    // Handshake bloqueante. Cliente: sobre el socket de ConnectToServer.
+    // Servidor: crypto debe tener el par RSA (propio o ShareRSAKeys).
+    bool
+    ClientHandshake(CryptoHelper& crypto);
+
+    bool
+    ServerHandshake(SOCKET socket, CryptoHelper& crypto);
+
     // Enviar y recibir datos
     bool
     SendData(SOCKET socket, const std::string& data);
@@ -37,10 +62,220 @@ public:
     std::vector<unsigned char>
     ReceiveData(SOCKET socket, int size = 0);
 
+    // Envio grande desde un buffer del pool. Con zero-copy activo en el socket
+    // y size >= ZEROCOPY_THRESHOLD el kernel lee el buffer sin copiarlo y el
+    // buffer vuelve al pool cuando el kernel lo confirma; si no, se copia.
+    bool
+    SendData(SOCKET socket, const PooledBuffer& buffer, size_t size);
+
+    // Activa MSG_ZEROCOPY (Linux, TCP). false si el sistema no lo admite; los
+    // envios siguen copiando.
+    bool
+    EnableZeroCopy(SOCKET socket);
+
+    // Procesa las confirmaciones pendientes sin esperar; devuelve cuantos
+    // envios zero-copy siguen retenidos por el kernel
+    size_t
+    ReapZeroCopy(SOCKET socket);
+
+    // Espera hasta timeoutMs a que el kernel suelte todos los buffers
+    bool
+    FlushZeroCopy(SOCKET socket, int timeoutMs);
+
+    // Tramas completas en modo bloqueante (mismo formato que AsyncConnection)
+    bool
+    SendFrame(SOCKET socket, FrameType type, const unsigned char* payload, size_t size);
+
+    bool
+    ReceiveFrame(SOCKET socket, Frame& frame);
+
+    // Trama desde un buffer del pool con el payload en data() + FRAME_HEADER_SIZE:
+    // la cabecera se escribe delante y la trama sale por SendData(buffer)
+    bool
+    SendFrame(SOCKET socket, FrameType type, const PooledBuffer& buffer, size_t size);
+
+    // Mensajes Data de la sesion. Con kTLS activo en el socket el payload va
+    // en claro y lo cifra el kernel; si no, AES en espacio de usuario.
+    bool
+    SendEncrypted(SOCKET socket, CryptoHelper& crypto, const std::string& plaintext);
+
+    // Responde a las peticiones de kTLS del cliente y salta otras tramas de
+    // control. Los lotes (MessageBatch) se devuelven de mensaje en mensaje.
+    // std::nullopt si el peer cerro o el mensaje esta mal formado.
+    std::optional<std::string>
+    ReceiveEncrypted(SOCKET socket, CryptoHelper& crypto);
+
+    // Cliente, tras el handshake: pide cifrar los registros en el kernel (ver
+    // KernelTls.h). false solo si la conexion fallo; si el kernel o el
+    // servidor no lo admiten, la sesion sigue en espacio de usuario.
+    bool
+    RequestKernelTls(SOCKET socket, CryptoHelper& crypto);
+
+    bool
+    KernelTlsActive(SOCKET socket) const;
+
+    // Comprime antes de cifrar los mensajes de SendEncrypted que lo merezcan
+    // (ver Compression.h). Solo en este sentido y solo si se pide: el tamano
+    // comprimido puede filtrar contenido. Recibir CompressedData no necesita
+    // activarlo.
+    void
+    EnableCompression(SOCKET socket);
+
+    bool
+    CompressionEnabled(SOCKET socket) const;
+
+    // Envia un archivo por una sola sesion (ver FileTransfer.h). Se proyecta
+    // con mmap y cada bloque se cifra directamente en un buffer del pool; con
+    // kTLS los bloques salen del archivo con sendfile. La memoria no crece con
+    // el archivo. true cuando el receptor confirma que lo escribio.
+    bool
+    SendFile(SOCKET socket, CryptoHelper& crypto, const std::string& path, size_t chunkSize = FILE_CHUNK_SIZE);
+
+    // Abre streams conexiones a address (handshake y kTLS si se puede en cada
+    // una) y reparte entre ellas los bloques que le faltan al receptor, un hilo
+    // por conexion. Lado receptor: Server::ReceiveFile.
+    static bool
+    SendFileParallel(const std::string& address, const std::string& path, int streams = DEFAULT_FILE_STREAMS,
+                     size_t chunkSize = FILE_CHUNK_SIZE);
+
+    // Recibe un archivo de SendFile (un solo stream). Cada bloque se escribe
+    // en su offset con pwrite y el progreso queda en path + ".resume".
+    bool
+    ReceiveFile(SOCKET socket, CryptoHelper& crypto, const std::string& path);
+
+    // Piezas de un stream de archivo, para repartir una transferencia entre
+    // varias conexiones. Emisor: FileStart y FileResume, luego bloques de la
+    // cola comun hasta vaciarla.
+    bool
+    StartFileStream(SOCKET socket, CryptoHelper& crypto, FileSource& source);
+
+    bool
+    SendFileStream(SOCKET socket, CryptoHelper& crypto, FileSource& source);
+
+    // Receptor: el primer stream abre sink (o retoma el estado guardado);
+    // ReceiveFileStream puede correr en su propio hilo.
+    bool
+    AcceptFileStream(SOCKET socket, CryptoHelper& crypto, FileSink& sink, const std::string& path);
+
+    bool
+    ReceiveFileStream(SOCKET socket, CryptoHelper& crypto, FileSink& sink);
+
+    // Sincroniza path con la copia que el receptor ya tiene (ver Dedup.h):
+    // solo se cifran y envian los bloques que el receptor no encuentra en su
+    // indice. true cuando el receptor confirma el archivo nuevo.
+    bool
+    SyncFile(SOCKET socket, CryptoHelper& crypto, const std::string& path);
+
+    // Rearma en path el archivo de SyncFile a partir de la version anterior y
+    // los bloques recibidos; lo reemplaza de una vez al terminar.
+    bool
+    ReceiveSync(SOCKET socket, CryptoHelper& crypto, const std::string& path);
+
+    // Modo datagrama (UDP): cada datagrama lleva un registro AEAD que se
+    // descifra por su cuenta (ver DatagramSession). La clave se deriva de la
+    // del handshake TCP; un socket UDP sirve a una sola sesion.
+    bool
+    OpenDatagram(int port);
+
+    bool
+    OpenDatagram(const std::string& ip, int port);
+
+    // Cifra y envia en lotes (sendmmsg en Linux); devuelve cuantos mensajes salieron.
+    // En el servidor el destino es el ultimo origen valido visto por ReceiveDatagrams.
+    size_t
+    SendDatagrams(DatagramSession& session, const std::vector<std::string>& messages);
+
+    // Espera hasta timeoutMs (-1 sin limite) y recibe un lote (recvmmsg en Linux).
+    // Los registros que no autentican o repetidos se descartan.
+    size_t
+    ReceiveDatagrams(DatagramSession& session, std::vector<std::string>& messages, size_t maxMessages = 32,
+                     int timeoutMs = -1);
+
+    SOCKET
+    GetDatagramSocket() const;
+
     void
     close(SOCKET socket);
 
+    // Socket de escucha (modo servidor) o conectado (modo cliente)
+    SOCKET
+    GetSocket() const;
+
+    // Transporte del socket de escucha o conectado; lo comparten los clientes aceptados
+    Transport
+    GetTransport() const;
+
+    static bool
+    SetNonBlocking(SOCKET socket, bool enabled);
+
+    // recv bloqueante con limite: al vencer falla como un error. 0 = sin limite.
+    static bool
+    SetReceiveTimeout(SOCKET socket, std::chrono::milliseconds timeout);
+
+    // Por debajo, pinchar paginas y leer la confirmacion cuesta mas que copiar
+    static constexpr size_t ZEROCOPY_THRESHOLD = 64 * 1024;
+
 private:
+    bool
+    Listen(const Endpoint& endpoint);
+
+    bool
+    Connect(const Endpoint& endpoint);
+
+    bool
+    OpenDatagram(const Endpoint& endpoint, bool listening);
+
     SOCKET m_serverSocket = -1;
     bool m_initialized;
+    Transport m_transport = Transport::Tcp;
+    std::string m_unixPath;   // socket Unix creado por StartSever; se borra al cerrar
+    std::string m_inprocName; // nombre InProc publicado por StartSever
+    // Envios MSG_ZEROCOPY de un socket a la espera de confirmacion del kernel.
+    // El kernel numera cada llamada a send con MSG_ZEROCOPY y confirma rangos
+    // de esos numeros por la cola de errores.
+    struct ZeroCopyState {
+        uint32_t nextId = 0;
+        uint32_t completedBelow = 0;                           // todos los ids menores confirmados
+        std::set<uint32_t> completedAbove;                     // confirmaciones fuera de orden
+        std::deque<std::pair<uint32_t, PooledBuffer>> pending; // ultimo id de cada buffer
+        bool copied = false;                                   // el kernel copio igualmente
+    };
+
+    bool
+    SendZeroCopy(SOCKET socket, ZeroCopyState& state, const PooledBuffer& buffer, size_t size);
+
+    // Servidor: contesta a una trama KernelTls del cliente
+    bool
+    AnswerKernelTls(SOCKET socket, CryptoHelper& crypto);
+
+    // kTLS no admite MSG_ZEROCOPY: el socket vuelve a los envios con copia
+    void
+    MarkKernelTls(SOCKET socket);
+
+    // Registros de control de archivo; sellados o, con kTLS, en claro
+    bool
+    SendFileRecord(SOCKET socket, CryptoHelper& crypto, FrameType type, uint64_t transferId, uint64_t offset,
+                   const unsigned char* data, size_t size);
+
+    // Siguiente trama que no sea KernelTls; contesta a esas por el camino
+    bool
+    ReceiveFileFrame(SOCKET socket, CryptoHelper& crypto, Frame& frame);
+
+    // Siguiente registro de archivo, de cualquier tipo (frame.type); contesta a
+    // KernelTls por el camino. data apunta dentro de frame.payload.
+    bool
+    ReceiveFileRecord(SOCKET socket, CryptoHelper& crypto, Frame& frame, uint64_t transferId, uint64_t& offset,
+                      unsigned char*& data, size_t& length);
+
+    std::unordered_map<SOCKET, ZeroCopyState> m_zeroCopy;
+    // Estado por socket: kTLS en los dos sentidos, compresion y el resto del
+    // ultimo lote recibido. Los streams de Server::ReceiveFile lo consultan
+    // desde sus hilos mientras se aceptan los siguientes.
+    mutable std::mutex m_socketOptionsMutex;
+    std::set<SOCKET> m_kernelTls;
+    std::set<SOCKET> m_compression;
+    std::unordered_map<SOCKET, std::deque<std::string>> m_received;
+    SOCKET m_datagramSocket = INVALID_SOCKET;
+    bool m_datagramConnected = false;
+    std::vector<unsigned char> m_datagramBuffer; // un lote de registros
 };
@@ -0,0 +1,74 @@
+#pragma once
+#include "Prerequisites.h"
+#include <openssl/rsa.h>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Cache LRU del proceso: huella SHA-256 del PEM del peer -> RSA* ya parseado.
+// Particionado en shards con mutex propio para que los handshakes concurrentes
+// no compitan por un unico candado. Las claves se comparten con RSA_up_ref.
+class E2EE_API
+    PeerKeyCache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size;
+        size_t capacity;
+
+        double
+        HitRate() const {
+            uint64_t total = hits + misses;
+            return total ? static_cast<double>(hits) / total : 0.0;
+        }
+    };
+
+    explicit PeerKeyCache(size_t capacity = 1024, size_t shardCount = 16);
+    ~PeerKeyCache();
+
+    PeerKeyCache(const PeerKeyCache&) = delete;
+    PeerKeyCache& operator=(const PeerKeyCache&) = delete;
+
+    static PeerKeyCache&
+    Instance();
+
+    // Devuelve una referencia propia (liberar con RSA_free) o nullptr si el
+    // PEM no es una clave publica RSA valida.
+    RSA*
+    Acquire(const std::string& pemKey);
+
+    void
+    Clear();
+
+    Stats
+    GetStats() const;
+
+    // SHA-256 del PEM codificado (32 bytes binarios)
+    static std::string
+    Fingerprint(const std::string& pemKey);
+
+private:
+    struct Entry {
+        std::string fingerprint;
+        RSA* key;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru; // frente = uso mas reciente
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    Shard&
+    ShardFor(const std::string& fingerprint);
+
+    size_t m_shardCapacity;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_evictions{0};
+};
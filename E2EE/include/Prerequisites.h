@@ -1,5 +1,9 @@
 #pragma once
+#include "Export.h"
 
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 #include <iostream>
 #include <vector>
\ No newline at end of file
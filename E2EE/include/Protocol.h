@@ -0,0 +1,92 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+// Trama en el cable: [longitud u32 big-endian][tipo u8][payload]
+enum class FrameType : uint8_t {
+    PublicKey = 1,
+    SessionKey = 2,
+    Data = 3,
+    KernelTls = 4, // negociacion de kTLS (ver KernelTls.h)
+    FileStart = 5, // transferencia de archivos (ver FileTransfer.h)
+    FileChunk = 6,
+    FileEnd = 7,
+    FileResume = 8,
+    FileManifest = 9,
+    SyncManifest = 10, // sincronizacion con deduplicacion (ver Dedup.h)
+    SyncNeed = 11,
+    SyncChunk = 12,
+    SyncEnd = 13,
+    CompressedData = 14, // Data con el texto plano comprimido (ver Compression.h)
+    MessageBatch = 15,   // varios mensajes en un solo registro (ver AppendBatchMessage)
+    CompressedBatch = 16,
+    Heartbeat = 17, // vacia: mantiene viva una sesion inactiva (ver AsyncConnection::SetHeartbeat)
+};
+
+enum class HandshakeRole {
+    Server,
+    Client,
+};
+
+struct Frame {
+    FrameType type;
+    std::vector<unsigned char> payload;
+};
+
+constexpr uint32_t FRAME_HEADER_SIZE = 5;
+constexpr uint32_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+E2EE_API void
+WriteU32(unsigned char* out, uint32_t value);
+
+E2EE_API uint32_t
+ReadU32(const unsigned char* in);
+
+E2EE_API void
+WriteU64(unsigned char* out, uint64_t value);
+
+E2EE_API uint64_t
+ReadU64(const unsigned char* in);
+
+E2EE_API void
+WriteFrameHeader(unsigned char* out, FrameType type, uint32_t size);
+
+// false si la longitud supera MAX_FRAME_SIZE
+E2EE_API bool
+ReadFrameHeader(const unsigned char* in, FrameType& type, uint32_t& size);
+
+// Payload de una trama Data: [longitud del texto plano u32][IV][texto cifrado].
+// Con kTLS activo el payload es el texto plano: lo cifra el kernel.
+E2EE_API std::vector<unsigned char>
+SealDataPayload(CryptoHelper& crypto, const std::string& plaintext);
+
+// std::nullopt si el payload esta mal formado
+E2EE_API std::optional<std::string>
+OpenDataPayload(CryptoHelper& crypto, const std::vector<unsigned char>& payload);
+
+// Tamano exacto del payload Data para un texto plano de plaintextSize bytes
+constexpr size_t
+DataPayloadSize(size_t plaintextSize) {
+    return 4 + AES_BLOCK_SIZE + plaintextSize + AES_BLOCK_SIZE;
+}
+
+// Cifra directamente en out (DataPayloadSize(size) bytes), sin buffers intermedios
+E2EE_API void
+SealDataPayload(CryptoHelper& crypto, const unsigned char* plaintext, size_t size, unsigned char* out);
+
+E2EE_API std::optional<std::string>
+OpenDataPayload(CryptoHelper& crypto, const unsigned char* payload, size_t size);
+
+// Texto plano de MessageBatch: [longitud u32][mensaje] por cada mensaje. Se
+// cifra y se envia como un Data.
+constexpr size_t BATCH_MESSAGE_HEADER_SIZE = 4;
+
+E2EE_API void
+AppendBatchMessage(std::string& batch, const std::string& message);
+
+// Anade los mensajes del lote a messages. false si esta vacio o mal formado.
+E2EE_API bool
+SplitBatch(const std::string& batch, std::deque<std::string>& messages);
@@ -0,0 +1,72 @@
+#pragma once
+#include "Prerequisites.h"
+#include <mutex>
+
+// Arena de memoria bloqueada (no paginable) para material de claves.
+// Todas las claves de sesion comparten una region mlock'eada rodeada por
+// paginas de guarda; los slots son de tamano fijo y se borran al liberarse.
+// Las regiones empiezan en pagina: con slotSize multiplo de 64 cada slot
+// ocupa sus propias lineas de cache, contiguas a las de las demas sesiones.
+class E2EE_API
+    SecureArena {
+public:
+    static constexpr size_t SLOT_SIZE = 32;
+
+    explicit SecureArena(size_t slotsPerRegion = 4096, size_t slotSize = SLOT_SIZE);
+    ~SecureArena();
+
+    SecureArena(const SecureArena&) = delete;
+    SecureArena& operator=(const SecureArena&) = delete;
+
+    // Arena global del proceso
+    static SecureArena&
+    Instance();
+
+    // Devuelve un slot de SlotSize() bytes a cero
+    unsigned char*
+    Allocate();
+
+    // Borra el slot y lo devuelve a la lista libre. Se llama desde
+    // destructores: no lanza. Un puntero ajeno a la arena o un slot ya libre
+    // (doble liberacion, que entregaria la misma clave a dos sesiones) se
+    // informa por std::cerr y aborta el proceso.
+    void
+    Free(unsigned char* slot) noexcept;
+
+    size_t
+    SlotSize() const;
+
+    size_t
+    Capacity() const;
+
+    size_t
+    InUse() const;
+
+    // false si el sistema no permitio bloquear alguna region (RLIMIT_MEMLOCK)
+    bool
+    IsLocked() const;
+
+private:
+    struct Region {
+        unsigned char* base;
+        size_t mapSize;
+        unsigned char* slots;
+        size_t slotBytes;
+        bool locked;
+        std::vector<bool> inUse; // por slot: entregado por Allocate y aun no liberado
+    };
+
+    bool
+    AddRegion();
+
+    // Region del slot y su indice en ella; nullptr si no es un slot de la arena
+    Region*
+    Locate(const unsigned char* slot, size_t& index);
+
+    size_t m_slotsPerRegion;
+    size_t m_slotSize;
+    size_t m_pageSize;
+    mutable std::mutex m_mutex;
+    std::vector<Region> m_regions;
+    std::vector<unsigned char*> m_freeList;
+};
@@ -1,22 +1,92 @@
 #pragma once
 #include "NetworkHelper.h"
 #include "CryptoHelper.h"
+#include "SecureArena.h"
+#include "AsyncNetwork.h"
+#include "SessionTable.h"
+#include <functional>
+#include <memory>
 
-class
+class E2EE_API
 Server {
 public:
     Server() = default;
     Server(int port);
 
+    // Direccion con esquema: "tcp://*:27015", "unix:/ruta", "inproc:nombre"...
+    Server(const std::string& address);
+
     ~Server();
 
     bool Start();
     void WaitForClient();
     void ReceiveEncryptedData();
 
+    // Recibe un archivo de NetworkHelper::SendFile o SendFileParallel: acepta
+    // los streams que anuncie el emisor y escribe en path. Si se corta, la
+    // siguiente llamada con el mismo archivo sigue donde quedo.
+    bool ReceiveFile(const std::string& path);
+
+    // Espera un cliente y actualiza path con NetworkHelper::ReceiveSync
+    bool ReceiveSync(const std::string& path);
+
+    // Atiende clientes concurrentes sobre el EventLoop hasta Stop().
+    // Cada mensaje recibido se devuelve cifrado al cliente (eco).
+    void Run();
+
+    // Seguro desde cualquier hilo
+    void Stop();
+
+    // Run() comprime los ecos que lo merezcan (ver Compression.h). Antes de Run().
+    void SetCompression(bool enabled);
+
+    // Run() agrupa los ecos en lotes (ver AsyncConnection::EnableBatching);
+    // maxBytes 0 los desactiva. Antes de Run().
+    void SetBatching(size_t maxBytes, std::chrono::microseconds delay = BATCH_DEFAULT_DELAY);
+
+    // Limites por sesion (0 = sin limite): plazo del handshake, tiempo sin
+    // recibir nada y latido de Run() (ver AsyncConnection::SetIdleTimeout).
+    // WaitForClient y ReceiveFile aplican el del handshake y el de inactividad
+    // con SO_RCVTIMEO. Antes de aceptar clientes.
+    void SetTimeouts(std::chrono::milliseconds handshake, std::chrono::milliseconds idle,
+                     std::chrono::milliseconds heartbeat = std::chrono::milliseconds(0));
+
+    // Sesiones abiertas de Run() (ver SessionTable.h). Las consultas no
+    // bloquean al bucle ni entre si; fn no debe guardar la referencia.
+    // Seguros desde cualquier hilo.
+    size_t SessionCount() const;
+    bool VisitSession(uint64_t id, const std::function<void(const Session&)>& fn) const;
+    void ForEachSession(const std::function<void(const Session&)>& fn) const;
+
+    // Corta la sesion id en el hilo del bucle (el cliente ve EOF); false si
+    // ya no esta. Seguro desde cualquier hilo.
+    bool Disconnect(uint64_t id);
+
 private:
-    int m_port;
-    int m_clientSocket;
+    Task<void> AcceptLoop();
+    Task<void> ServeClient(SOCKET socket);
+    void StopIfIdle();
+
+    int m_port = 0;
+    std::string m_address;
+    SOCKET m_clientSocket = INVALID_SOCKET;
     NetworkHelper m_networkHelper;
     CryptoHelper m_cryptoHelper;
+
+    // Expansiones de clave de las sesiones de Run(), contiguas y solo del
+    // hilo del bucle. Antes que m_loop: se destruye despues de las conexiones.
+    SecureArena m_scheduleArena{1024, CryptoHelper::KEY_SCHEDULE_SLOT_SIZE};
+    std::unique_ptr<EventLoop> m_loop;
+    std::unique_ptr<CryptoService> m_cryptoService;
+    std::unique_ptr<AsyncListener> m_listener;
+    SessionTable m_sessions;
+    uint64_t m_nextSessionId = 0;
+    bool m_stopping = false;
+    bool m_accepting = false;
+    bool m_compression = false;
+    size_t m_batchMaxBytes = 0;
+    std::chrono::microseconds m_batchDelay = BATCH_DEFAULT_DELAY;
+    std::chrono::milliseconds m_handshakeTimeout = DEFAULT_HANDSHAKE_TIMEOUT;
+    std::chrono::milliseconds m_idleTimeout = DEFAULT_IDLE_TIMEOUT;
+    std::chrono::milliseconds m_heartbeatInterval{0};
 };
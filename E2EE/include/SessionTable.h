@@ -0,0 +1,102 @@
+#pragma once
+#include "Prerequisites.h"
+#include "Epoch.h"
+#include "SocketCompat.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+class EventLoop;
+
+// Estado de una sesion de Server::Run que otros hilos pueden consultar
+struct Session {
+    uint64_t id = 0;
+    SOCKET socket = INVALID_SOCKET;
+    std::string peer;          // direccion del cliente
+    EventLoop* loop = nullptr; // hilo que la atiende: para actuar sobre ella, Post()
+    std::chrono::steady_clock::time_point connected;
+    // Los escribe el bucle en cada mensaje: en su propia linea de cache para
+    // no invalidar la de los campos que leen los demas hilos
+    alignas(64) std::atomic<uint64_t> messagesReceived{0};
+    std::atomic<uint64_t> bytesReceived{0};
+};
+
+// Tabla hash de direccionamiento abierto (sondeo lineal) de id de sesion a
+// Session. Buscar no toma cerrojos ni escribe memoria compartida: basta un
+// EpochGuard. Los escritores (Insert, Erase) se serializan entre si. Una
+// ranura solo pasa de vacia a ocupada y de ocupada a borrada, nunca vuelve
+// atras, asi que un lector no puede confundir una sesion con otra que
+// reutilice su ranura. Las borradas se limpian al rehacer la tabla, que se
+// publica de golpe; la vieja y las sesiones borradas se liberan por epocas.
+//
+// Los id son distintos de 0 y de UINT64_MAX y no se reutilizan.
+class E2EE_API
+    SessionTable {
+public:
+    explicit SessionTable(size_t capacity = 1024);
+    ~SessionTable();
+
+    SessionTable(const SessionTable&) = delete;
+    SessionTable& operator=(const SessionTable&) = delete;
+
+    // Toma posesion de la sesion; false si su id ya esta
+    bool
+    Insert(std::unique_ptr<Session> session);
+
+    // La sesion se libera cuando ningun lector pueda seguir viendola
+    bool
+    Erase(uint64_t id);
+
+    // nullptr si no esta. El puntero vale mientras viva guard.
+    Session*
+    Find(uint64_t id, const EpochGuard& guard) const;
+
+    // fn(Session&) sobre las sesiones presentes; las que entren o salgan
+    // mientras tanto pueden verse o no
+    template<typename Fn>
+    void
+    ForEach(Fn&& fn) const {
+        EpochGuard guard;
+        const Table* table = m_table.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            if (Session* session = table->slots[i].value.load(std::memory_order_acquire)) {
+                fn(*session);
+            }
+        }
+    }
+
+    size_t
+    Size() const;
+
+private:
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint64_t ERASED = UINT64_MAX;
+
+    // 16 bytes: cuatro ranuras por linea de cache
+    struct Slot {
+        std::atomic<uint64_t> key{EMPTY};
+        std::atomic<Session*> value{nullptr};
+    };
+
+    struct Table {
+        size_t mask; // capacidad - 1 (potencia de dos)
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    static Table*
+    NewTable(size_t capacity);
+
+    static size_t
+    Home(uint64_t id, size_t mask);
+
+    // Rehace la tabla si la siguiente insercion pasaria del 70% de ocupadas
+    // (vivas y borradas). Con m_writeMutex.
+    void
+    Reserve();
+
+    std::atomic<Table*> m_table;
+    std::mutex m_writeMutex;
+    size_t m_used = 0; // ranuras no vacias de m_table, con m_writeMutex
+    std::atomic<size_t> m_size{0};
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include "Prerequisites.h"
+#include "CryptoHelper.h"
+#include "Protocol.h"
+#include "SocketCompat.h"
+#include <memory>
+#include <optional>
+
+// Canal de tramas entre dos extremos del mismo host sobre memoria compartida:
+// un anillo SPSC por sentido en una region mmap (memfd) y un eventfd por
+// extremo. Con el peer activo, enviar y recibir son solo cargas y
+// almacenamientos en memoria; el eventfd se escribe unicamente si el otro
+// lado anuncio que se iba a dormir. Solo Linux: en otras plataformas Create
+// y ReceiveFrom devuelven nullptr.
+//
+// Cada extremo debe usarse desde un solo hilo (un productor y un consumidor
+// por anillo).
+class E2EE_API
+    ShmChannel {
+public:
+    static constexpr size_t DEFAULT_RING_SIZE = 4 * 1024 * 1024;
+
+    ~ShmChannel();
+
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    // Crea la region (ringSize se redondea a potencia de dos); este extremo es el lado 0
+    static std::unique_ptr<ShmChannel>
+    Create(size_t ringSize = DEFAULT_RING_SIZE);
+
+    // El otro extremo de la misma region, para otro hilo del mismo proceso
+    std::unique_ptr<ShmChannel>
+    OpenPeer() const;
+
+    // Entrega la region y los eventfd a otro proceso por un socket AF_UNIX
+    // bloqueante (SCM_RIGHTS); el receptor queda como el otro extremo
+    bool
+    SendTo(SOCKET unixSocket) const;
+
+    static std::unique_ptr<ShmChannel>
+    ReceiveFrom(SOCKET unixSocket);
+
+    // Escritura sin copias: TryReserve devuelve donde escribir un payload de
+    // hasta size bytes (nullptr si todavia no cabe) y Commit lo publica.
+    unsigned char*
+    TryReserve(size_t size);
+
+    void
+    Commit(FrameType type, size_t size);
+
+    // Lectura sin copias: el payload sigue en el anillo hasta Release().
+    // Un registro del peer que no cabe en lo publicado cierra el canal.
+    const unsigned char*
+    TryPeek(FrameType& type, size_t& size);
+
+    void
+    Release();
+
+    // Igual que TryReserve/TryPeek, pero esperan: primero activamente y
+    // despues en el eventfd. nullptr si el peer cerro el canal.
+    unsigned char*
+    Reserve(size_t size);
+
+    const unsigned char*
+    Peek(FrameType& type, size_t& size);
+
+    bool
+    SendFrame(FrameType type, const unsigned char* payload, size_t size);
+
+    bool
+    ReceiveFrame(Frame& frame);
+
+    // El payload Data se cifra directamente en el anillo y se descifra desde el
+    std::optional<std::string>
+    ReceiveEncrypted(CryptoHelper& crypto);
+
+    bool
+    SendEncrypted(CryptoHelper& crypto, const std::string& plaintext);
+
+    // Despierta al peer; sus esperas terminan cuando vacian el anillo
+    void
+    Close();
+
+    // Tambien si el peer dejo el anillo en un estado imposible (ver TryPeek)
+    bool
+    PeerClosed() const;
+
+    // Mayor payload que cabe en el anillo
+    size_t
+    MaxFrameSize() const;
+
+private:
+    struct Region;
+
+    ShmChannel(int memory, int wakeZero, int wakeOne, int side);
+
+    bool
+    Map();
+
+    template <typename Ready>
+    bool
+    Wait(Ready ready);
+
+    void
+    Notify();
+
+    // Longitudes o posiciones del peer fuera del anillo: se deja de leer
+    // y se cierra este extremo
+    void
+    MarkCorrupt();
+
+    int m_memory;
+    int m_wake[2];
+    int m_side;
+    Region* m_region = nullptr;
+    size_t m_regionSize = 0;
+    size_t m_ringSize = 0;
+    unsigned char* m_rings[2] = {};
+    size_t m_reserved = 0; // bytes del registro reservado y sin publicar
+    uint64_t m_reservedPosition = 0;
+    size_t m_peeked = 0;   // bytes del registro leido y sin liberar
+    bool m_corrupt = false;
+};
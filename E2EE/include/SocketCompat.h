@@ -0,0 +1,63 @@
+#pragma once
+
+// Winsock en Windows; en el resto, sockets BSD con los nombres de Winsock
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+// send() nunca genera SIGPIPE en Winsock
+#define MSG_NOSIGNAL 0
+#else
+// Sockets BSD con los nombres de Winsock que usa el resto del codigo
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using SOCKET = int;
+using WSAPOLLFD = pollfd;
+using ULONG = unsigned long;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define SD_BOTH SHUT_RDWR
+#define WSAEWOULDBLOCK EWOULDBLOCK
+#define MAKEWORD(low, high) ((unsigned short)(((low) & 0xff) | (((high) & 0xff) << 8)))
+
+struct WSADATA {
+};
+
+inline int
+WSAStartup(unsigned short, WSADATA*) {
+    return 0;
+}
+
+inline int
+WSACleanup() {
+    return 0;
+}
+
+inline int
+WSAGetLastError() {
+    // connect() no bloqueante informa EINPROGRESS donde Winsock da WSAEWOULDBLOCK
+    return errno == EAGAIN || errno == EINPROGRESS ? EWOULDBLOCK : errno;
+}
+
+inline int
+WSAPoll(WSAPOLLFD* fds, ULONG count, int timeout) {
+    return ::poll(fds, static_cast<nfds_t>(count), timeout);
+}
+
+inline int
+closesocket(SOCKET socket) {
+    return ::close(socket);
+}
+#endif
@@ -0,0 +1,178 @@
+#pragma once
+#include "Prerequisites.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace detail {
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    // Al terminar se reanuda directamente a quien hizo co_await (transferencia simetrica)
+    struct FinalAwaiter {
+        bool
+        await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+
+        void
+        await_resume() const noexcept {
+        }
+    };
+
+    std::suspend_always
+    initial_suspend() const noexcept {
+        return {};
+    }
+
+    FinalAwaiter
+    final_suspend() const noexcept {
+        return {};
+    }
+
+    void
+    unhandled_exception() noexcept {
+        error = std::current_exception();
+    }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    void
+    return_value(T result) {
+        value.emplace(std::move(result));
+    }
+
+    T
+    Take() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    void
+    return_void() noexcept {
+    }
+
+    void
+    Take() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+}
+
+// Corrutina perezosa: empieza a ejecutarse cuando alguien hace co_await
+template <typename T = void>
+class [[nodiscard]]
+    Task {
+public:
+    struct promise_type : detail::TaskPromise<T> {
+        Task
+        get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    Task(Task&& other) noexcept :
+        m_handle(std::exchange(other.m_handle, {})) {
+    }
+
+    Task&
+    operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) {
+                m_handle.destroy();
+            }
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    bool
+    await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        m_handle.promise().continuation = awaiting;
+        return m_handle;
+    }
+
+    T
+    await_resume() {
+        return m_handle.promise().Take();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) :
+        m_handle(handle) {
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Lanza una Task sin esperar su resultado; se destruye sola al terminar
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask
+        get_return_object() const noexcept {
+            return {};
+        }
+
+        std::suspend_never
+        initial_suspend() const noexcept {
+            return {};
+        }
+
+        std::suspend_never
+        final_suspend() const noexcept {
+            return {};
+        }
+
+        void
+        return_void() const noexcept {
+        }
+
+        void
+        unhandled_exception() const noexcept {
+            try {
+                throw;
+            } catch (const std::exception& e) {
+                std::cerr << "Detached task failed: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Detached task failed" << std::endl;
+            }
+        }
+    };
+};
+
+inline DetachedTask
+Spawn(Task<void> task) {
+    co_await task;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "Prerequisites.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+// Rueda de temporizadores jerarquica (Varghese y Lauck): 4 niveles de 256
+// ranuras con ticks de TIMER_WHEEL_TICK. Un temporizador va al nivel que cubre
+// su plazo, en una lista doblemente enlazada por ranura, asi que insertar y
+// cancelar son O(1) sin importar cuantos haya. Al dar la vuelta un nivel, la
+// ranura siguiente del nivel de arriba se reparte en los de abajo. Un mapa de
+// bits por nivel dice que ranuras estan ocupadas: el bucle duerme hasta el
+// siguiente vencimiento o reparto sin recorrer las ranuras vacias.
+//
+// No es seguro entre hilos: lo usa el hilo de EventLoop.
+
+constexpr std::chrono::milliseconds TIMER_WHEEL_TICK{1};
+
+class E2EE_API
+    TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    // generacion << 32 | nodo; 0 = ninguno
+    using TimerId = uint64_t;
+
+    TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Vence en el primer tick que no sea anterior a deadline: nunca antes
+    TimerId
+    Add(Clock::time_point deadline, std::function<void()> fn);
+
+    // false si ya vencio (y se recogio con PopExpired) o ya se cancelo
+    bool
+    Cancel(TimerId id);
+
+    // Pasa a la lista de vencidos todo lo que vence hasta now
+    void
+    Advance(Clock::time_point now);
+
+    // Saca el siguiente vencido. De uno en uno: la funcion de un temporizador
+    // puede cancelar otro que ya haya vencido en el mismo Advance.
+    bool
+    PopExpired(std::function<void()>& fn);
+
+    // Hasta cuando se puede dormir sin perder un vencimiento ni un reparto.
+    // Clock::time_point::max() sin temporizadores.
+    Clock::time_point
+    NextWakeup() const;
+
+    size_t
+    Size() const;
+
+private:
+    static constexpr int LEVEL_BITS = 8;
+    static constexpr size_t SLOTS = size_t(1) << LEVEL_BITS;
+    static constexpr int LEVELS = 4;
+    static constexpr size_t EXPIRED_LIST = LEVELS * SLOTS;
+    static constexpr size_t FREE_LIST = EXPIRED_LIST + 1;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        std::function<void()> fn;
+        uint64_t expiry = 0; // tick
+        uint32_t prev = NONE;
+        uint32_t next = NONE;
+        uint32_t generation = 1;
+        uint32_t list = FREE_LIST;
+    };
+
+    uint64_t
+    TickFor(Clock::time_point time, bool roundUp) const;
+
+    // Nivel y ranura segun lo que falte desde m_current
+    void
+    Place(uint32_t index);
+
+    void
+    Link(uint32_t index, size_t list);
+
+    void
+    Unlink(uint32_t index);
+
+    void
+    Release(uint32_t index);
+
+    // Reparte la ranura de level que toca en el tick m_current
+    void
+    Cascade(int level);
+
+    void
+    ProcessTick();
+
+    // Ticks desde m_current hasta el siguiente tick con trabajo; UINT64_MAX si no hay
+    uint64_t
+    NextEventDistance() const;
+
+    Clock::time_point m_start;
+    uint64_t m_current = 0; // siguiente tick por procesar
+    std::vector<Node> m_nodes;
+    std::array<uint32_t, FREE_LIST + 1> m_heads;
+    std::array<uint32_t, FREE_LIST + 1> m_tails; // se anade al final: mismo plazo, mismo orden
+    std::array<std::array<uint64_t, SLOTS / 64>, LEVELS> m_occupied{};
+    size_t m_size = 0;
+};
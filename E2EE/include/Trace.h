@@ -0,0 +1,66 @@
+#pragma once
+#include "Prerequisites.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Trazas de las fases del handshake. Cada hilo escribe sus spans en un anillo
+// propio de tamano fijo (un solo escritor, sin candados); Dump() los recoge y
+// los emite como JSON de Chrome trace (chrome://tracing, Perfetto). Desactivado
+// por defecto: con el trazado apagado un span cuesta una carga atomica.
+class E2EE_API
+    Trace {
+public:
+    static constexpr size_t RING_CAPACITY = 8192;
+
+    static void
+    SetEnabled(bool enabled);
+
+    static bool
+    Enabled() {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Identificador nuevo para agrupar los spans de una conexion
+    static uint64_t
+    NewConnectionId();
+
+    // name debe ser un literal: solo se guarda el puntero
+    static void
+    Record(const char* name, uint64_t connection, uint64_t startNs, uint64_t endNs);
+
+    // Nanosegundos desde el arranque del proceso
+    static uint64_t
+    Now();
+
+    // Spans aun presentes en los anillos (los mas antiguos se sobrescriben)
+    static void
+    WriteChromeJson(std::ostream& out);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Span RAII: registra [construccion, destruccion) si el trazado esta activo
+class
+    TraceSpan {
+public:
+    TraceSpan(const char* name, uint64_t connection) :
+        m_name(Trace::Enabled() ? name : nullptr), m_connection(connection), m_start(m_name ? Trace::Now() : 0) {
+    }
+
+    ~TraceSpan() {
+        if (m_name) {
+            Trace::Record(m_name, m_connection, m_start, Trace::Now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_connection;
+    uint64_t m_start;
+};
@@ -0,0 +1,761 @@
+#include "AsyncNetwork.h"
+#include "Compression.h"
+#include "KernelTls.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+bool
+WouldBlock() {
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+// Ejecuta un trabajo en CryptoService y reanuda la corrutina en el EventLoop
+struct OffloadAwaiter {
+    EventLoop& loop;
+    CryptoService& service;
+    CryptoHelper& session;
+    std::function<void(CryptoHelper&)> job;
+    std::exception_ptr error;
+
+    bool
+    await_ready() const noexcept {
+        return false;
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> handle) {
+        uint64_t queued = Trace::Enabled() ? Trace::Now() : 0;
+        service.Post(session, [this, handle, queued](CryptoHelper& helper) {
+            if (queued) {
+                Trace::Record("CryptoServiceQueue", helper.TraceId(), queued, Trace::Now());
+            }
+            try {
+                job(helper);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            uint64_t done = queued ? Trace::Now() : 0;
+            loop.Post([handle, done, id = helper.TraceId()] {
+                if (done) {
+                    Trace::Record("EventLoopResume", id, done, Trace::Now());
+                }
+                handle.resume();
+            });
+        });
+    }
+
+    void
+    await_resume() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+}
+
+AsyncListener::AsyncListener(EventLoop& loop, SOCKET listenSocket) :
+    m_loop(loop), m_socket(listenSocket) {
+    NetworkHelper::SetNonBlocking(m_socket, true);
+}
+
+Task<SOCKET>
+AsyncListener::Accept() {
+    for (;;) {
+        SOCKET clientSocket = accept(m_socket, nullptr, nullptr);
+        if (m_closed) {
+            if (clientSocket != INVALID_SOCKET) {
+                closesocket(clientSocket);
+            }
+            co_return INVALID_SOCKET;
+        }
+        if (clientSocket != INVALID_SOCKET) {
+            if (!CheckInProcPeer(m_socket, clientSocket)) {
+                closesocket(clientSocket);
+                continue;
+            }
+            co_return clientSocket;
+        }
+        if (!WouldBlock()) {
+            std::cerr << "Error accepting client: " << WSAGetLastError() << std::endl;
+            co_return INVALID_SOCKET;
+        }
+        co_await m_loop.Readable(m_socket);
+    }
+}
+
+void
+AsyncListener::Close() {
+    m_closed = true;
+    m_loop.Cancel(m_socket);
+}
+
+Task<SOCKET>
+AsyncConnect(EventLoop& loop, const std::string& ip, int port) {
+    Endpoint endpoint;
+    endpoint.host = ip;
+    endpoint.port = port;
+    co_return co_await AsyncConnect(loop, endpoint);
+}
+
+Task<SOCKET>
+AsyncConnect(EventLoop& loop, Endpoint endpoint) {
+    SocketAddress address;
+    if (!ResolveEndpoint(endpoint, false, address)) {
+        co_return INVALID_SOCKET;
+    }
+    SOCKET connectSocket = socket(address.family, address.type, address.protocol);
+    if (connectSocket == INVALID_SOCKET) {
+        std::cerr << "Error creating socket: " << WSAGetLastError() << std::endl;
+        co_return INVALID_SOCKET;
+    }
+    NetworkHelper::SetNonBlocking(connectSocket, true);
+
+    for (;;) {
+        if (connect(connectSocket, reinterpret_cast<const sockaddr*>(&address.storage), address.length) != SOCKET_ERROR) {
+            co_return connectSocket;
+        }
+        if (!WouldBlock()) {
+            std::cerr << "Error connecting to server: " << WSAGetLastError() << std::endl;
+            closesocket(connectSocket);
+            co_return INVALID_SOCKET;
+        }
+        if (address.family == AF_UNIX) {
+            // AF_UNIX no bloqueante no queda "en progreso": EAGAIN significa
+            // cola de escucha llena y hay que reintentar
+            co_await loop.SleepFor(std::chrono::milliseconds(1));
+            continue;
+        }
+        // La conexion termina cuando el socket se vuelve escribible
+        co_await loop.Writable(connectSocket);
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(connectSocket, SOL_SOCKET, SO_ERROR, (char*)&error, &length);
+        if (error != 0) {
+            std::cerr << "Error connecting to server: " << error << std::endl;
+            closesocket(connectSocket);
+            co_return INVALID_SOCKET;
+        }
+        co_return connectSocket;
+    }
+}
+
+AsyncConnection::AsyncConnection(EventLoop& loop, SOCKET socket, Transport transport) :
+    m_loop(loop), m_socket(socket), m_transport(transport) {
+    NetworkHelper::SetNonBlocking(m_socket, true);
+    // Las tramas se escriben completas: Nagle solo anade latencia. En AF_UNIX
+    // la opcion no existe y setsockopt falla sin efecto.
+    int noDelay = 1;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+}
+
+AsyncConnection::~AsyncConnection() {
+    if (m_owner) {
+        *m_owner = nullptr; // el plazo pendiente ya no encuentra la conexion
+    }
+    Close();
+}
+
+void
+AsyncConnection::Close() {
+    m_loop.CancelTimer(m_idleTimer);
+    m_loop.CancelTimer(m_heartbeatTimer);
+    m_idleTimer = m_heartbeatTimer = 0;
+    if (m_socket != INVALID_SOCKET) {
+        closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+}
+
+void
+AsyncConnection::EnableCompression() {
+    m_compression = true;
+}
+
+void
+AsyncConnection::EnableBatching(size_t maxBytes, std::chrono::microseconds delay) {
+    m_batchMaxBytes = std::max<size_t>(maxBytes, 1);
+    m_batchDelay = delay;
+    if (!m_owner) {
+        m_owner = std::make_shared<AsyncConnection*>(this);
+    }
+}
+
+CryptoHelper&
+AsyncConnection::Crypto() {
+    return m_crypto;
+}
+
+SOCKET
+AsyncConnection::Socket() const {
+    return m_socket;
+}
+
+EventLoop&
+AsyncConnection::Loop() {
+    return m_loop;
+}
+
+void
+AsyncConnection::SetHandshakeTimeout(std::chrono::milliseconds timeout) {
+    m_handshakeTimeout = timeout;
+}
+
+void
+AsyncConnection::SetIdleTimeout(std::chrono::milliseconds timeout) {
+    m_loop.CancelTimer(m_idleTimer);
+    m_idleTimer = 0;
+    m_idleTimeout = timeout;
+    if (timeout.count() > 0) {
+        m_lastReceive = EventLoop::Clock::now();
+        ArmIdleTimer();
+    }
+}
+
+void
+AsyncConnection::SetHeartbeat(std::chrono::milliseconds interval) {
+    m_loop.CancelTimer(m_heartbeatTimer);
+    m_heartbeatTimer = 0;
+    m_heartbeatInterval = interval;
+    if (interval.count() > 0) {
+        m_lastSend = EventLoop::Clock::now();
+        ArmHeartbeat(m_lastSend + interval);
+    }
+}
+
+void
+AsyncConnection::Expire() {
+    if (m_socket != INVALID_SOCKET) {
+        shutdown(m_socket, SD_BOTH);
+        Metrics::Add(MetricCounter::ConnectionsTimedOut);
+    }
+}
+
+void
+AsyncConnection::ArmIdleTimer() {
+    m_idleTimer = m_loop.AddTimer(m_lastReceive + m_idleTimeout, [this] {
+        m_idleTimer = 0;
+        EventLoop::Clock::time_point now = EventLoop::Clock::now();
+        if (now - m_lastReceive >= m_idleTimeout) {
+            // Lo que espera sin leer tambien cuenta: el peer no esta inactivo
+            char byte;
+            if (recv(m_socket, &byte, 1, MSG_PEEK) <= 0) {
+                Expire();
+                return;
+            }
+            m_lastReceive = now;
+        }
+        ArmIdleTimer();
+    });
+}
+
+void
+AsyncConnection::ArmHeartbeat(EventLoop::Clock::time_point deadline) {
+    m_heartbeatTimer = m_loop.AddTimer(deadline, [this] {
+        m_heartbeatTimer = 0;
+        EventLoop::Clock::time_point now = EventLoop::Clock::now();
+        if (now - m_lastSend < m_heartbeatInterval) {
+            ArmHeartbeat(m_lastSend + m_heartbeatInterval);
+            return;
+        }
+        if (!m_writeBlocked && m_socket != INVALID_SOCKET) {
+            // Cinco bytes sin esperar: con el buffer lleno no hace falta latido
+            unsigned char header[FRAME_HEADER_SIZE];
+            WriteFrameHeader(header, FrameType::Heartbeat, 0);
+            int result = send(m_socket, reinterpret_cast<const char*>(header), FRAME_HEADER_SIZE, MSG_NOSIGNAL);
+            if (result == static_cast<int>(FRAME_HEADER_SIZE)) {
+                m_lastSend = now;
+                Metrics::Add(MetricCounter::BytesSent, FRAME_HEADER_SIZE);
+            } else if (result != SOCKET_ERROR || !WouldBlock()) {
+                Expire(); // una cabecera a medias rompe el flujo
+                return;
+            }
+        }
+        ArmHeartbeat(now + m_heartbeatInterval);
+    });
+}
+
+Task<bool>
+AsyncConnection::Send(const unsigned char* data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        int chunk = static_cast<int>(std::min<size_t>(size - sent, 1 << 30));
+        int result = send(m_socket, reinterpret_cast<const char*>(data + sent), chunk, MSG_NOSIGNAL);
+        if (result > 0) {
+            sent += result;
+        } else if (result == SOCKET_ERROR && WouldBlock()) {
+            m_writeBlocked = true;
+            co_await m_loop.Writable(m_socket);
+            m_writeBlocked = false;
+        } else {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+Task<bool>
+AsyncConnection::RecvExact(unsigned char* data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        int chunk = static_cast<int>(std::min<size_t>(size - received, 1 << 30));
+        int result = recv(m_socket, reinterpret_cast<char*>(data + received), chunk, 0);
+        if (result > 0) {
+            received += result;
+            if (m_idleTimeout.count() > 0) {
+                m_lastReceive = EventLoop::Clock::now();
+            }
+        } else if (result == SOCKET_ERROR && WouldBlock()) {
+            co_await m_loop.Readable(m_socket);
+        } else {
+            co_return false; // cerrado por el peer o error
+        }
+    }
+    co_return true;
+}
+
+Task<bool>
+AsyncConnection::SendRecord(const unsigned char* data, size_t size) {
+    for (;;) {
+        int result = send(m_socket, reinterpret_cast<const char*>(data), static_cast<int>(size), MSG_NOSIGNAL);
+        if (result == static_cast<int>(size)) {
+            co_return true;
+        }
+        if (result != SOCKET_ERROR || !WouldBlock()) {
+            co_return false;
+        }
+        m_writeBlocked = true;
+        co_await m_loop.Writable(m_socket);
+        m_writeBlocked = false;
+    }
+}
+
+Task<bool>
+AsyncConnection::RecvRecord(unsigned char* data, size_t size, int flags) {
+    for (;;) {
+        int result = recv(m_socket, reinterpret_cast<char*>(data), static_cast<int>(size), flags);
+        if (result == static_cast<int>(size)) {
+            if (m_idleTimeout.count() > 0) {
+                m_lastReceive = EventLoop::Clock::now();
+            }
+            co_return true;
+        }
+        if (result != SOCKET_ERROR || !WouldBlock()) {
+            co_return false; // cerrado por el peer, error o registro de otro tamano
+        }
+        co_await m_loop.Readable(m_socket);
+    }
+}
+
+Task<bool>
+AsyncConnection::SendFrame(FrameType type, const unsigned char* payload, size_t size) {
+    if (size > MAX_FRAME_SIZE) {
+        co_return false;
+    }
+    LatencyTimer timer(MetricStage::Send);
+    unsigned char header[FRAME_HEADER_SIZE];
+    WriteFrameHeader(header, type, static_cast<uint32_t>(size));
+
+    bool sent;
+    if (IsMessageOriented(m_transport)) {
+        // Primer registro: cabecera + inicio del cuerpo; el resto, en registros enteros
+        size_t first = std::min(size, SEQPACKET_RECORD_SIZE - FRAME_HEADER_SIZE);
+        std::vector<unsigned char> record(FRAME_HEADER_SIZE + first);
+        std::memcpy(record.data(), header, FRAME_HEADER_SIZE);
+        if (first) {
+            std::memcpy(record.data() + FRAME_HEADER_SIZE, payload, first);
+        }
+        sent = co_await SendRecord(record.data(), record.size());
+        for (size_t offset = first; sent && offset < size; offset += SEQPACKET_RECORD_SIZE) {
+            sent = co_await SendRecord(payload + offset, std::min(size - offset, SEQPACKET_RECORD_SIZE));
+        }
+    } else if (size <= 16 * 1024) {
+        // Tramas pequenas en una sola llamada a send
+        std::vector<unsigned char> buffer(FRAME_HEADER_SIZE + size);
+        std::memcpy(buffer.data(), header, FRAME_HEADER_SIZE);
+        if (size) {
+            std::memcpy(buffer.data() + FRAME_HEADER_SIZE, payload, size);
+        }
+        sent = co_await Send(buffer.data(), buffer.size());
+    } else {
+        sent = co_await Send(header, FRAME_HEADER_SIZE) && co_await Send(payload, size);
+    }
+
+    if (!sent) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::SendErrors);
+        co_return false;
+    }
+    Metrics::Add(MetricCounter::BytesSent, FRAME_HEADER_SIZE + size);
+    Metrics::Add(MetricCounter::MessagesSent);
+    if (m_heartbeatInterval.count() > 0) {
+        m_lastSend = EventLoop::Clock::now();
+    }
+    co_return true;
+}
+
+Task<std::optional<Frame>>
+AsyncConnection::RecvFrame() {
+    unsigned char header[FRAME_HEADER_SIZE];
+    // En SOCK_SEQPACKET la cabecera se mira sin consumir el registro
+    bool records = IsMessageOriented(m_transport);
+    bool peeked;
+    if (records) {
+        peeked = co_await RecvRecord(header, FRAME_HEADER_SIZE, MSG_PEEK);
+    } else {
+        peeked = co_await RecvExact(header, FRAME_HEADER_SIZE);
+    }
+    if (!peeked) {
+        co_return std::nullopt;
+    }
+    Frame frame;
+    uint32_t size;
+    if (!ReadFrameHeader(header, frame.type, size)) {
+        std::cerr << "Frame too large: " << size << std::endl;
+        Metrics::Add(MetricCounter::ReceiveErrors);
+        co_return std::nullopt;
+    }
+    // Se mide desde la cabecera: la espera previa es inactividad del peer
+    LatencyTimer timer(MetricStage::Receive);
+    frame.payload.resize(size);
+    bool received;
+    if (records) {
+        size_t first = std::min<size_t>(size, SEQPACKET_RECORD_SIZE - FRAME_HEADER_SIZE);
+        std::vector<unsigned char> record(FRAME_HEADER_SIZE + first);
+        received = co_await RecvRecord(record.data(), record.size());
+        if (received && first) {
+            std::memcpy(frame.payload.data(), record.data() + FRAME_HEADER_SIZE, first);
+        }
+        for (size_t offset = first; received && offset < size; offset += SEQPACKET_RECORD_SIZE) {
+            received = co_await RecvRecord(frame.payload.data() + offset, std::min<size_t>(size - offset, SEQPACKET_RECORD_SIZE));
+        }
+    } else {
+        received = size == 0 || co_await RecvExact(frame.payload.data(), size);
+    }
+    if (!received) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::ReceiveErrors);
+        co_return std::nullopt;
+    }
+    Metrics::Add(MetricCounter::BytesReceived, FRAME_HEADER_SIZE + size);
+    Metrics::Add(MetricCounter::MessagesReceived);
+    co_return frame;
+}
+
+Task<void>
+AsyncConnection::RunCrypto(CryptoService* offload, std::function<void(CryptoHelper&)> job) {
+    if (!offload) {
+        job(m_crypto);
+        co_return;
+    }
+    co_await OffloadAwaiter{m_loop, *offload, m_crypto, std::move(job), nullptr};
+}
+
+Task<bool>
+AsyncConnection::Handshake(HandshakeRole role, CryptoService* offload) {
+    LatencyTimer timer(MetricStage::Handshake);
+    TraceSpan span(role == HandshakeRole::Server ? "ServerHandshake" : "ClientHandshake", m_crypto.TraceId());
+    EventLoop::TimerId deadline = 0;
+    if (m_handshakeTimeout.count() > 0) {
+        deadline = m_loop.AddTimer(EventLoop::Clock::now() + m_handshakeTimeout, [this] { Expire(); });
+    }
+    bool established = co_await RunHandshake(role, offload);
+    m_loop.CancelTimer(deadline);
+    if (!established) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::HandshakeErrors);
+        co_return false;
+    }
+    // Las claves RSA ya no se usan: la sesion se queda solo con su estado caliente
+    m_crypto.ReleaseHandshakeKeys();
+    Metrics::Add(MetricCounter::Handshakes);
+    co_return true;
+}
+
+Task<bool>
+AsyncConnection::RunHandshake(HandshakeRole role, CryptoService* offload) {
+    try {
+        if (role == HandshakeRole::Server) {
+            if (!m_crypto.HasRSAKeys()) {
+                co_await RunCrypto(offload, [](CryptoHelper& helper) { helper.GenerateRSAKeys(); });
+            }
+            std::shared_ptr<const std::string> publicKey = m_crypto.GetPublicKeyBuffer();
+            {
+                TraceSpan span("SendPublicKey", m_crypto.TraceId());
+                if (!co_await SendFrame(FrameType::PublicKey, reinterpret_cast<const unsigned char*>(publicKey->data()),
+                                        publicKey->size())) {
+                    co_return false;
+                }
+            }
+
+            std::optional<Frame> frame;
+            {
+                // Ida y vuelta: incluye el trabajo del cliente con la clave publica
+                TraceSpan span("RecvSessionKey", m_crypto.TraceId());
+                frame = co_await RecvFrame();
+            }
+            if (!frame || frame->type != FrameType::SessionKey) {
+                co_return false;
+            }
+            std::vector<unsigned char> encryptedKey = std::move(frame->payload);
+            co_await RunCrypto(offload, [&encryptedKey](CryptoHelper& helper) { helper.DecryptAESKey(encryptedKey); });
+            co_return true;
+        }
+
+        std::optional<Frame> frame;
+        {
+            TraceSpan span("RecvPublicKey", m_crypto.TraceId());
+            frame = co_await RecvFrame();
+        }
+        if (!frame || frame->type != FrameType::PublicKey) {
+            co_return false;
+        }
+        std::string peerKey(frame->payload.begin(), frame->payload.end());
+        std::vector<unsigned char> encryptedKey;
+        co_await RunCrypto(offload, [&peerKey, &encryptedKey](CryptoHelper& helper) {
+            helper.LoadPeerPublicKey(peerKey);
+            helper.GenerateAESKey();
+            encryptedKey = helper.EncryptAESKeyWithPeer();
+        });
+        TraceSpan span("SendSessionKey", m_crypto.TraceId());
+        co_return co_await SendFrame(FrameType::SessionKey, encryptedKey.data(), encryptedKey.size());
+    } catch (const std::exception& e) {
+        std::cerr << "Handshake failed: " << e.what() << std::endl;
+        co_return false;
+    }
+}
+
+Task<bool>
+AsyncConnection::SendMessage(FrameType type, const std::string& plaintext) {
+    const std::string* message = &plaintext;
+    std::optional<std::string> compressed;
+    if (m_compression && (compressed = CompressMessage(plaintext))) {
+        if (type == FrameType::Data) {
+            type = FrameType::CompressedData;
+        } else {
+            type = FrameType::CompressedBatch;
+        }
+        message = &*compressed;
+    }
+    if (m_kernelTls) {
+        co_return co_await SendFrame(type, reinterpret_cast<const unsigned char*>(message->data()), message->size());
+    }
+    std::vector<unsigned char> payload = SealDataPayload(m_crypto, *message);
+    co_return co_await SendFrame(type, payload.data(), payload.size());
+}
+
+Task<bool>
+AsyncConnection::SendEncrypted(const std::string& plaintext) {
+    if (m_batchMaxBytes == 0) {
+        co_return co_await SendMessage(FrameType::Data, plaintext);
+    }
+    if (m_batchFailed) {
+        co_return false;
+    }
+    size_t size = BATCH_MESSAGE_HEADER_SIZE + plaintext.size();
+    if (!m_batch.empty() && m_batch.size() + size > m_batchMaxBytes) {
+        if (!co_await Flush()) {
+            co_return false;
+        }
+    }
+    if (size > m_batchMaxBytes) {
+        // No cabe en un lote: sale solo, detras de lo pendiente
+        co_await LockSend();
+        bool sent = co_await SendMessage(FrameType::Data, plaintext);
+        UnlockSend();
+        co_return sent;
+    }
+    bool first = m_batch.empty();
+    AppendBatchMessage(m_batch, plaintext);
+    ++m_batchMessages;
+    if (m_batch.size() >= m_batchMaxBytes) {
+        co_return co_await Flush();
+    }
+    if (first) {
+        m_batchDeadline = EventLoop::Clock::now() + m_batchDelay;
+        ArmBatchTimer();
+    }
+    co_return true;
+}
+
+Task<bool>
+AsyncConnection::Flush() {
+    co_await LockSend();
+    if (!m_batch.empty()) {
+        std::string batch;
+        batch.swap(m_batch);
+        size_t messages = std::exchange(m_batchMessages, 0);
+        if (co_await SendMessage(FrameType::MessageBatch, batch)) {
+            Metrics::Add(MetricCounter::MessagesCoalesced, messages);
+        } else {
+            m_batchFailed = true;
+        }
+    }
+    UnlockSend();
+    co_return !m_batchFailed;
+}
+
+Task<void>
+AsyncConnection::LockSend() {
+    struct Waiter {
+        AsyncConnection& connection;
+
+        bool
+        await_ready() const noexcept {
+            return false;
+        }
+
+        void
+        await_suspend(std::coroutine_handle<> handle) {
+            connection.m_sendWaiters.push_back(handle);
+        }
+
+        void
+        await_resume() const noexcept {
+        }
+    };
+    while (m_sending) {
+        co_await Waiter{*this};
+    }
+    m_sending = true;
+}
+
+void
+AsyncConnection::UnlockSend() {
+    m_sending = false;
+    for (std::coroutine_handle<> handle : m_sendWaiters) {
+        m_loop.Post([handle] { handle.resume(); });
+    }
+    m_sendWaiters.clear();
+    // El plazo no espera a otros envios: lo que quedo en el lote lo vuelve a armar
+    if (!m_batch.empty()) {
+        ArmBatchTimer();
+    }
+}
+
+void
+AsyncConnection::ArmBatchTimer() {
+    if (!m_batchTimerArmed) {
+        m_batchTimerArmed = true;
+        Spawn(FlushOnDeadline(m_owner, m_loop));
+    }
+}
+
+Task<void>
+AsyncConnection::FlushOnDeadline(std::shared_ptr<AsyncConnection*> owner, EventLoop& loop) {
+    for (;;) {
+        AsyncConnection* connection = *owner;
+        if (!connection) {
+            co_return;
+        }
+        if (connection->m_batch.empty() || connection->m_sending) {
+            connection->m_batchTimerArmed = false;
+            co_return;
+        }
+        if (connection->m_batchDeadline > EventLoop::Clock::now()) {
+            co_await loop.SleepUntil(connection->m_batchDeadline);
+            continue;
+        }
+        co_await connection->Flush();
+    }
+}
+
+Task<std::optional<std::string>>
+AsyncConnection::RecvEncrypted() {
+    if (!m_received.empty()) {
+        std::string message = std::move(m_received.front());
+        m_received.pop_front();
+        co_return message;
+    }
+    if (!m_batch.empty()) {
+        if (!co_await Flush()) {
+            co_return std::nullopt;
+        }
+    }
+    for (;;) {
+        std::optional<Frame> frame = co_await RecvFrame();
+        if (!frame) {
+            co_return std::nullopt;
+        }
+        if (frame->type == FrameType::KernelTls) {
+            if (!co_await AnswerKernelTls()) {
+                co_return std::nullopt;
+            }
+            continue;
+        }
+        if (frame->type == FrameType::Heartbeat) {
+            continue;
+        }
+        bool batch = frame->type == FrameType::MessageBatch || frame->type == FrameType::CompressedBatch;
+        bool compressed = frame->type == FrameType::CompressedData || frame->type == FrameType::CompressedBatch;
+        if (frame->type != FrameType::Data && !batch && !compressed) {
+            co_return std::nullopt;
+        }
+        std::optional<std::string> message;
+        if (m_kernelTls) {
+            message = std::string(frame->payload.begin(), frame->payload.end());
+        } else {
+            message = OpenDataPayload(m_crypto, frame->payload);
+        }
+        if (message && compressed) {
+            message = DecompressMessage(*message);
+        }
+        if (!message || !batch) {
+            co_return message;
+        }
+        if (!SplitBatch(*message, m_received)) {
+            co_return std::nullopt;
+        }
+        std::string first = std::move(m_received.front());
+        m_received.pop_front();
+        co_return first;
+    }
+}
+
+Task<bool>
+AsyncConnection::RequestKernelTls() {
+    if (m_kernelTls || !AttachKernelTls(m_socket)) {
+        co_return true; // sin kTLS local no hace falta preguntar
+    }
+    if (!co_await SendFrame(FrameType::KernelTls, nullptr, 0)) {
+        co_return false;
+    }
+    std::optional<Frame> frame = co_await RecvFrame();
+    while (frame && frame->type == FrameType::Heartbeat) {
+        frame = co_await RecvFrame();
+    }
+    if (!frame || frame->type != FrameType::KernelTls || frame->payload.size() != 1) {
+        co_return false;
+    }
+    if (frame->payload[0] == 1) {
+        if (!EnableKernelTls(m_socket, m_crypto, HandshakeRole::Client)) {
+            co_return false;
+        }
+        m_kernelTls = true;
+    }
+    co_return true;
+}
+
+Task<bool>
+AsyncConnection::AnswerKernelTls() {
+    unsigned char accepted = !m_kernelTls && AttachKernelTls(m_socket) ? 1 : 0;
+    if (!co_await SendFrame(FrameType::KernelTls, &accepted, 1)) {
+        co_return false;
+    }
+    // Con 1, lo siguiente que llegue del cliente ya viene en registros TLS
+    if (accepted) {
+        if (!EnableKernelTls(m_socket, m_crypto, HandshakeRole::Server)) {
+            co_return false;
+        }
+        m_kernelTls = true;
+    }
+    co_return true;
+}
+
+bool
+AsyncConnection::KernelTlsActive() const {
+    return m_kernelTls;
+}
@@ -0,0 +1,73 @@
+#include "BufferPool.h"
+
+namespace {
+// Clase de tamano para size, o CLASS_COUNT si no cabe en ninguna
+size_t
+ClassFor(size_t size) {
+    size_t index = 0;
+    for (size_t capacity = BufferPool::MIN_BUFFER_SIZE; capacity < size; capacity <<= 1) {
+        if (++index == BufferPool::CLASS_COUNT) {
+            break;
+        }
+    }
+    return index;
+}
+}
+
+BufferPool::~BufferPool() {
+    for (std::vector<std::vector<unsigned char>*>& buffers : m_free) {
+        for (std::vector<unsigned char>* buffer : buffers) {
+            delete buffer;
+        }
+    }
+}
+
+BufferPool&
+BufferPool::Instance() {
+    // Nunca se destruye: un envio zero-copy puede soltar su buffer durante la salida
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+PooledBuffer
+BufferPool::Acquire(size_t size) {
+    size_t index = ClassFor(size);
+    if (index == CLASS_COUNT) {
+        return std::make_shared<std::vector<unsigned char>>(size);
+    }
+    std::vector<unsigned char>* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free[index].empty()) {
+            buffer = m_free[index].back();
+            m_free[index].pop_back();
+        }
+    }
+    if (!buffer) {
+        buffer = new std::vector<unsigned char>(MIN_BUFFER_SIZE << index);
+    }
+    return PooledBuffer(buffer, [this](std::vector<unsigned char>* released) { Release(released); });
+}
+
+void
+BufferPool::Release(std::vector<unsigned char>* buffer) {
+    size_t index = ClassFor(buffer->size());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free[index].size() < MAX_CACHED_PER_CLASS) {
+            m_free[index].push_back(buffer);
+            return;
+        }
+    }
+    delete buffer;
+}
+
+size_t
+BufferPool::CachedBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t bytes = 0;
+    for (size_t index = 0; index < CLASS_COUNT; ++index) {
+        bytes += m_free[index].size() * (MIN_BUFFER_SIZE << index);
+    }
+    return bytes;
+}
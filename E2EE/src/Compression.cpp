@@ -0,0 +1,230 @@
+#include "Compression.h"
+#include "Metrics.h"
+#include "Protocol.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr size_t MIN_MATCH = 4;
+// Como en LZ4: los ultimos bytes van siempre como literales y ninguna
+// coincidencia empieza en los ultimos MATCH_SEARCH_LIMIT
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MATCH_SEARCH_LIMIT = 12;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 13;
+
+uint32_t
+Load32(const unsigned char* in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+uint32_t
+HashSequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Longitud por encima del nibble del token: bytes de 255 y un resto
+void
+WriteLength(unsigned char*& op, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *op++ = 255;
+    }
+    *op++ = static_cast<unsigned char>(length);
+}
+
+bool
+ReadLength(const unsigned char*& ip, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if (ip == end || length > MAX_FRAME_SIZE) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Una secuencia: literales y, si matchLength > 0, la coincidencia que los sigue
+bool
+EmitSequence(unsigned char*& op, const unsigned char* opEnd, const unsigned char* literals, size_t literalLength,
+             size_t offset, size_t matchLength) {
+    size_t worst = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+    if (static_cast<size_t>(opEnd - op) < worst) {
+        return false;
+    }
+    unsigned char* token = op++;
+    *token = static_cast<unsigned char>(std::min<size_t>(literalLength, 15) << 4);
+    if (literalLength >= 15) {
+        WriteLength(op, literalLength - 15);
+    }
+    std::memcpy(op, literals, literalLength);
+    op += literalLength;
+    if (matchLength == 0) {
+        return true;
+    }
+    *op++ = static_cast<unsigned char>(offset);
+    *op++ = static_cast<unsigned char>(offset >> 8);
+    size_t extra = matchLength - MIN_MATCH;
+    *token |= static_cast<unsigned char>(std::min<size_t>(extra, 15));
+    if (extra >= 15) {
+        WriteLength(op, extra - 15);
+    }
+    return true;
+}
+}
+
+bool
+LooksCompressible(const unsigned char* data, size_t size) {
+    if (size < COMPRESSION_MIN_SIZE) {
+        return false;
+    }
+    // Muestra repartida por todo el mensaje, no solo la cabecera
+    uint32_t counts[256] = {};
+    size_t step = std::max<size_t>(1, size / COMPRESSION_SAMPLE_SIZE);
+    size_t sampled = 0;
+    for (size_t i = 0; i < size; i += step, ++sampled) {
+        ++counts[data[i]];
+    }
+    double entropy = 0;
+    for (uint32_t count : counts) {
+        if (count) {
+            double p = static_cast<double>(count) / static_cast<double>(sampled);
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy < COMPRESSION_MAX_ENTROPY;
+}
+
+size_t
+CompressBlock(const unsigned char* in, size_t size, unsigned char* out, size_t capacity) {
+    uint32_t table[1 << HASH_BITS] = {};
+    const unsigned char* const end = in + size;
+    unsigned char* op = out;
+    const unsigned char* const opEnd = out + capacity;
+    const unsigned char* anchor = in;
+    if (size > MATCH_SEARCH_LIMIT) {
+        const unsigned char* const searchEnd = end - MATCH_SEARCH_LIMIT;
+        const unsigned char* const matchEnd = end - LAST_LITERALS;
+        const unsigned char* ip = in;
+        while (ip < searchEnd) {
+            uint32_t sequence = Load32(ip);
+            uint32_t& slot = table[HashSequence(sequence)];
+            const unsigned char* match = in + slot;
+            slot = static_cast<uint32_t>(ip - in);
+            if (match >= ip || static_cast<size_t>(ip - match) > MAX_OFFSET || Load32(match) != sequence) {
+                // Sin coincidencias recientes se avanza cada vez mas rapido
+                ip = std::min(ip + 1 + ((ip - anchor) >> 6), searchEnd);
+                continue;
+            }
+            while (ip > anchor && match > in && ip[-1] == match[-1]) {
+                --ip;
+                --match;
+            }
+            const unsigned char* cursor = ip + MIN_MATCH;
+            const unsigned char* reference = match + MIN_MATCH;
+            while (cursor < matchEnd && *cursor == *reference) {
+                ++cursor;
+                ++reference;
+            }
+            if (!EmitSequence(op, opEnd, anchor, ip - anchor, ip - match, cursor - ip)) {
+                return 0;
+            }
+            ip = anchor = cursor;
+        }
+    }
+    if (!EmitSequence(op, opEnd, anchor, end - anchor, 0, 0)) {
+        return 0;
+    }
+    return op - out;
+}
+
+bool
+DecompressBlock(const unsigned char* in, size_t size, unsigned char* out, size_t outSize) {
+    const unsigned char* ip = in;
+    const unsigned char* const end = in + size;
+    unsigned char* op = out;
+    unsigned char* const opEnd = out + outSize;
+    while (ip < end) {
+        unsigned char token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !ReadLength(ip, end, literals)) {
+            return false;
+        }
+        if (literals > static_cast<size_t>(end - ip) || literals > static_cast<size_t>(opEnd - op)) {
+            return false;
+        }
+        std::memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == end) {
+            break; // la ultima secuencia solo lleva literales
+        }
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !ReadLength(ip, end, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(op - out) || length > static_cast<size_t>(opEnd - op)) {
+            return false;
+        }
+        const unsigned char* reference = op - offset;
+        if (offset >= length) {
+            std::memcpy(op, reference, length);
+        } else {
+            // Solapada: repite los ultimos offset bytes
+            for (size_t i = 0; i < length; ++i) {
+                op[i] = reference[i];
+            }
+        }
+        op += length;
+    }
+    return op == opEnd;
+}
+
+std::optional<std::string>
+CompressMessage(const std::string& plaintext) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(plaintext.data());
+    if (!LooksCompressible(data, plaintext.size()) || plaintext.size() > MAX_FRAME_SIZE) {
+        return std::nullopt;
+    }
+    size_t capacity = plaintext.size() - plaintext.size() / 8 - COMPRESSION_HEADER_SIZE;
+    std::string message(COMPRESSION_HEADER_SIZE + capacity, '\0');
+    unsigned char* out = reinterpret_cast<unsigned char*>(message.data());
+    size_t compressed = CompressBlock(data, plaintext.size(), out + COMPRESSION_HEADER_SIZE, capacity);
+    if (compressed == 0) {
+        return std::nullopt;
+    }
+    WriteU32(out, static_cast<uint32_t>(plaintext.size()));
+    message.resize(COMPRESSION_HEADER_SIZE + compressed);
+    Metrics::Add(MetricCounter::BytesSavedByCompression, plaintext.size() - message.size());
+    return message;
+}
+
+std::optional<std::string>
+DecompressMessage(const std::string& message) {
+    if (message.size() < COMPRESSION_HEADER_SIZE) {
+        return std::nullopt;
+    }
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(message.data());
+    uint32_t length = ReadU32(in);
+    // La longitud viene del peer sin autenticar: no se reserva mas de lo que el bloque puede dar
+    size_t blockSize = message.size() - COMPRESSION_HEADER_SIZE;
+    if (length > MAX_FRAME_SIZE || length > blockSize * COMPRESSION_MAX_RATIO) {
+        return std::nullopt;
+    }
+    std::string plaintext(length, '\0');
+    if (!DecompressBlock(in + COMPRESSION_HEADER_SIZE, blockSize, reinterpret_cast<unsigned char*>(plaintext.data()),
+                         length)) {
+        return std::nullopt;
+    }
+    return plaintext;
+}
@@ -1,11 +1,25 @@
 #include "CryptoHelper.h"
+#include "Metrics.h"
+#include "PeerKeyCache.h"
+#include "SecureArena.h"
+#include "Trace.h"
 #include "openssl/pem.h"
 #include "openssl/rand.h"
 #include "openssl/err.h"
+#include "openssl/kdf.h"
+#include <cstring>
+
+namespace {
+SecureArena&
+DefaultScheduleArena() {
+    static SecureArena arena(1024, CryptoHelper::KEY_SCHEDULE_SLOT_SIZE);
+    return arena;
+}
+}
 
 CryptoHelper::CryptoHelper() :
-    rsaKeyPair(nullptr), peerPublicKey(nullptr) {
-    std::memset(&aesKey, 0, sizeof(aesKey));
+    aesKey(SecureArena::Instance().Allocate()), schedule(nullptr), scheduleArena(&DefaultScheduleArena()),
+    traceId(Trace::NewConnectionId()), scheduleKeyed(false), rsaKeyPair(nullptr), peerPublicKey(nullptr) {
 }
 
 CryptoHelper::~CryptoHelper() {
@@ -15,43 +29,134 @@ CryptoHelper::~CryptoHelper() {
     if (peerPublicKey) {
         RSA_free(peerPublicKey);
     }
+    scheduleArena->Free(reinterpret_cast<unsigned char*>(schedule));
+    SecureArena::Instance().Free(aesKey);
 }
 
 void
 CryptoHelper::GenerateRSAKeys() {
+    LatencyTimer timer(MetricStage::KeyGeneration);
+    TraceSpan span("GenerateRSAKeys", traceId);
     BIGNUM* bn = BN_new();
     BN_set_word(bn, RSA_F4);
-    rsaKeyPair = RSA_new();
-    RSA_generate_key_ex(rsaKeyPair, 2048, bn, nullptr);
+    RSA* keyPair = RSA_new();
+    RSA_generate_key_ex(keyPair, 2048, bn, nullptr);
     BN_free(bn);
+
+    // Nuevo par de claves: el PEM cacheado deja de ser valido
+    std::lock_guard<std::mutex> lock(publicKeyMutex);
+    if (rsaKeyPair) {
+        RSA_free(rsaKeyPair);
+    }
+    rsaKeyPair = keyPair;
+    publicKeyCache.reset();
 }
 
 std::string
 CryptoHelper::GetPublicKeyString() const {
+    return *GetPublicKeyBuffer();
+}
+
+std::shared_ptr<const std::string>
+CryptoHelper::GetPublicKeyBuffer() const {
+    std::lock_guard<std::mutex> lock(publicKeyMutex);
+    if (publicKeyCache) {
+        return publicKeyCache;
+    }
+    if (!rsaKeyPair) {
+        throw std::runtime_error("RSA key pair not generated.");
+    }
+
+    TraceSpan span("GetPublicKeyString", traceId);
     BIO* bio = BIO_new(BIO_s_mem());
     PEM_write_bio_RSAPublicKey(bio, rsaKeyPair);
     char* buffer = nullptr; // KeyData
     size_t length = BIO_get_mem_data(bio, &buffer);
-    std::string publicKey(buffer, length);
+    publicKeyCache = std::make_shared<const std::string>(buffer, length);
     BIO_free(bio);
-    return publicKey;
+    return publicKeyCache;
 }
 
 void
 CryptoHelper::LoadPeerPublicKey(const std::string& pemKey) {
-    BIO* bio = BIO_new_mem_buf(pemKey.data(), static_cast<int>(pemKey.size()));
-    peerPublicKey = PEM_read_bio_RSAPublicKey(bio, nullptr, nullptr, nullptr);
-    BIO_free(bio);
+    LatencyTimer timer(MetricStage::KeyLoad);
+    TraceSpan span("LoadPeerPublicKey", traceId);
+    if (peerPublicKey) {
+        RSA_free(peerPublicKey);
+    }
+    // Los peers que reconectan reutilizan la clave ya parseada
+    peerPublicKey = PeerKeyCache::Instance().Acquire(pemKey);
     if (!peerPublicKey) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::CryptoErrors);
         throw std::runtime_error(
             "Failed to load peer public key : "
             + std::string(ERR_error_string(ERR_get_error(), nullptr)));
     }
 }
 
+bool
+CryptoHelper::HasRSAKeys() const {
+    std::lock_guard<std::mutex> lock(publicKeyMutex);
+    return rsaKeyPair != nullptr;
+}
+
+void
+CryptoHelper::ShareRSAKeys(const CryptoHelper& identity) {
+    std::shared_ptr<const std::string> pem;
+    RSA* keyPair = nullptr;
+    // El PEM y el par de claves se leen juntos por si la identidad se regenera
+    while (!keyPair) {
+        identity.GetPublicKeyBuffer();
+        std::lock_guard<std::mutex> lock(identity.publicKeyMutex);
+        if (identity.publicKeyCache) {
+            pem = identity.publicKeyCache;
+            keyPair = identity.rsaKeyPair;
+            RSA_up_ref(keyPair);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(publicKeyMutex);
+    if (rsaKeyPair) {
+        RSA_free(rsaKeyPair);
+    }
+    rsaKeyPair = keyPair;
+    publicKeyCache = std::move(pem);
+}
+
+void
+CryptoHelper::ReleaseHandshakeKeys() {
+    std::lock_guard<std::mutex> lock(publicKeyMutex);
+    if (rsaKeyPair) {
+        RSA_free(rsaKeyPair);
+        rsaKeyPair = nullptr;
+    }
+    if (peerPublicKey) {
+        RSA_free(peerPublicKey);
+        peerPublicKey = nullptr;
+    }
+    publicKeyCache.reset();
+}
+
 void
 CryptoHelper::GenerateAESKey() {
-    RAND_bytes(aesKey, sizeof(aesKey));
+    RAND_bytes(aesKey, AES_KEY_LENGTH);
+    scheduleKeyed = false;
+    aeadCipher.reset();
+    datagrams.nextSend.store(1, std::memory_order_relaxed);
+    datagrams.highestReceived.store(0, std::memory_order_relaxed);
+}
+
+void
+CryptoHelper::UseScheduleArena(SecureArena& arena) {
+    if (arena.SlotSize() < sizeof(KeySchedule)) {
+        throw std::invalid_argument("SecureArena slots too small for a key schedule.");
+    }
+    if (schedule) {
+        scheduleArena->Free(reinterpret_cast<unsigned char*>(schedule));
+        schedule = nullptr;
+    }
+    scheduleArena = &arena;
 }
 
 std::vector<unsigned char>
@@ -59,8 +164,15 @@ CryptoHelper::EncryptAESKeyWithPeer() {
     if (!peerPublicKey) {
         throw std::runtime_error("Peer public key not loaded.");
     }
+    LatencyTimer timer(MetricStage::KeyWrap);
+    TraceSpan span("EncryptAESKeyWithPeer", traceId);
     std::vector<unsigned char> encryptedKey(256);
-    int result = RSA_public_encrypt(sizeof(aesKey), aesKey, encryptedKey.data(), peerPublicKey, RSA_PKCS1_OAEP_PADDING);
+    int result = RSA_public_encrypt(AES_KEY_LENGTH, aesKey, encryptedKey.data(), peerPublicKey, RSA_PKCS1_OAEP_PADDING);
+    if (result < 0) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::CryptoErrors);
+        throw std::runtime_error("Failed to encrypt AES key.");
+    }
 
     encryptedKey.resize(result);
     return encryptedKey;
@@ -68,28 +180,192 @@ CryptoHelper::EncryptAESKeyWithPeer() {
 
 void
 CryptoHelper::DecryptAESKey(const std::vector<unsigned char>& encryptedKey) {
-    RSA_private_decrypt(encryptedKey.size(), encryptedKey.data(), aesKey, rsaKeyPair, RSA_PKCS1_OAEP_PADDING);
+    if (!rsaKeyPair) {
+        throw std::runtime_error("RSA key pair not generated.");
+    }
+    LatencyTimer timer(MetricStage::KeyUnwrap);
+    TraceSpan span("DecryptAESKey", traceId);
+    // RSA_private_decrypt puede escribir hasta RSA_size bytes: no se descifra
+    // directamente sobre el slot para no pisar las claves vecinas de la arena
+    std::vector<unsigned char> decrypted(RSA_size(rsaKeyPair));
+    int result = RSA_private_decrypt(static_cast<int>(encryptedKey.size()), encryptedKey.data(), decrypted.data(),
+                                     rsaKeyPair, RSA_PKCS1_OAEP_PADDING);
+    if (result != static_cast<int>(AES_KEY_LENGTH)) {
+        OPENSSL_cleanse(decrypted.data(), decrypted.size());
+        timer.Cancel();
+        Metrics::Add(MetricCounter::CryptoErrors);
+        throw std::runtime_error("Failed to decrypt AES key.");
+    }
+    std::memcpy(aesKey, decrypted.data(), AES_KEY_LENGTH);
+    scheduleKeyed = false;
+    aeadCipher.reset();
+    datagrams.nextSend.store(1, std::memory_order_relaxed);
+    datagrams.highestReceived.store(0, std::memory_order_relaxed);
+    OPENSSL_cleanse(decrypted.data(), decrypted.size());
 }
 
 std::vector<unsigned char>
 CryptoHelper::AESEncrypt(const std::string& plaintext, std::vector<unsigned char>& outIV) {
     outIV.resize(AES_BLOCK_SIZE);
-    RAND_bytes(outIV.data(), AES_BLOCK_SIZE);
-
     std::vector<unsigned char> ciphertext(plaintext.size() + AES_BLOCK_SIZE);
-    AES_KEY aesKeyEnc;
-    AES_set_encrypt_key(aesKey, 256, &aesKeyEnc);
-    AES_cbc_encrypt(reinterpret_cast<const unsigned char*>(plaintext.data()), ciphertext.data(), plaintext.size(),
-                    &aesKeyEnc, outIV.data(), AES_ENCRYPT);
+    AESEncrypt(reinterpret_cast<const unsigned char*>(plaintext.data()), plaintext.size(), outIV.data(),
+               ciphertext.data());
     return ciphertext;
 }
 
+void
+CryptoHelper::AESEncrypt(const unsigned char* plaintext, size_t size, unsigned char* outIV, unsigned char* out) {
+    LatencyTimer timer(MetricStage::Encrypt);
+    RAND_bytes(outIV, AES_BLOCK_SIZE);
+
+    // AES_cbc_encrypt avanza el IV que recibe; outIV debe quedar intacto
+    unsigned char iv[AES_BLOCK_SIZE];
+    std::memcpy(iv, outIV, AES_BLOCK_SIZE);
+    AES_cbc_encrypt(plaintext, out, size, &PrepareSchedule().encrypt, iv, AES_ENCRYPT);
+    // El ultimo bloque se rellena hasta AES_BLOCK_SIZE; el resto del buffer, a cero
+    size_t written = (size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
+    std::memset(out + written, 0, size + AES_BLOCK_SIZE - written);
+    Metrics::Add(MetricCounter::BytesEncrypted, size);
+}
+
 std::string
 CryptoHelper::AESDescrypt(const std::vector<unsigned char>& ciphertext, const std::vector<unsigned char>& iv) {
-    std::vector<unsigned char> decrypted(ciphertext.size());
-    AES_KEY aesKeyDec;
-    AES_set_decrypt_key(aesKey, 256, &aesKeyDec);
-    AES_cbc_encrypt(ciphertext.data(), decrypted.data(), ciphertext.size(), &aesKeyDec,
-                    const_cast<unsigned char*>(iv.data()), AES_DECRYPT);
-    return std::string(reinterpret_cast<char*>(decrypted.data()), ciphertext.size());
+    unsigned char ivCopy[AES_BLOCK_SIZE] = {};
+    std::memcpy(ivCopy, iv.data(), iv.size() < AES_BLOCK_SIZE ? iv.size() : AES_BLOCK_SIZE);
+    if (ciphertext.size() < AES_BLOCK_SIZE) {
+        Metrics::Add(MetricCounter::CryptoErrors);
+        throw std::runtime_error("Invalid AES ciphertext size.");
+    }
+    // AESEncrypt devuelve size + AES_BLOCK_SIZE bytes: el bloque parcial del
+    // final es relleno a cero y se devuelve como tal, sin descifrarlo
+    std::string decrypted(ciphertext.size(), '\0');
+    AESDescrypt(ciphertext.data(), ciphertext.size() / AES_BLOCK_SIZE * AES_BLOCK_SIZE, ivCopy,
+                reinterpret_cast<unsigned char*>(decrypted.data()));
+    return decrypted;
+}
+
+void
+CryptoHelper::AESDescrypt(const unsigned char* ciphertext, size_t size, const unsigned char* iv, unsigned char* out) {
+    // AES_cbc_encrypt lee un bloque entero aunque queden menos bytes
+    if (size == 0 || size % AES_BLOCK_SIZE != 0) {
+        Metrics::Add(MetricCounter::CryptoErrors);
+        throw std::runtime_error("Invalid AES ciphertext size.");
+    }
+    LatencyTimer timer(MetricStage::Decrypt);
+    unsigned char ivCopy[AES_BLOCK_SIZE];
+    std::memcpy(ivCopy, iv, AES_BLOCK_SIZE);
+    AES_cbc_encrypt(ciphertext, out, size, &PrepareSchedule().decrypt, ivCopy, AES_DECRYPT);
+    Metrics::Add(MetricCounter::BytesDecrypted, size);
+}
+
+const CryptoHelper::KeySchedule&
+CryptoHelper::PrepareSchedule() {
+    if (!schedule) {
+        schedule = reinterpret_cast<KeySchedule*>(scheduleArena->Allocate());
+        scheduleKeyed = false;
+    }
+    if (!scheduleKeyed) {
+        AES_set_encrypt_key(aesKey, 256, &schedule->encrypt);
+        AES_set_decrypt_key(aesKey, 256, &schedule->decrypt);
+        scheduleKeyed = true;
+    }
+    return *schedule;
+}
+
+AeadCipher&
+CryptoHelper::PrepareAEAD() {
+    if (!aeadCipher) {
+        aeadCipher = std::make_unique<AeadCipher>(*this, "e2ee file record");
+    }
+    return *aeadCipher;
+}
+
+void
+CryptoHelper::AEADEncrypt(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+                          const unsigned char* plaintext, size_t size, unsigned char* out, unsigned char* tag) {
+    PrepareAEAD().Seal(nonce, aad, aadSize, plaintext, size, out, tag);
+}
+
+bool
+CryptoHelper::AEADDecrypt(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+                          const unsigned char* ciphertext, size_t size, const unsigned char* tag, unsigned char* out) {
+    return PrepareAEAD().Open(nonce, aad, aadSize, ciphertext, size, tag, out);
+}
+
+void
+CryptoHelper::DeriveKeyMaterial(const char* label, unsigned char* out, size_t size) const {
+    EVP_PKEY_CTX* context = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    size_t length = size;
+    bool derived = context && EVP_PKEY_derive_init(context) == 1
+                   && EVP_PKEY_CTX_set_hkdf_md(context, EVP_sha256()) == 1
+                   && EVP_PKEY_CTX_set1_hkdf_key(context, aesKey, AES_KEY_LENGTH) == 1
+                   && EVP_PKEY_CTX_add1_hkdf_info(context, reinterpret_cast<const unsigned char*>(label),
+                                                  static_cast<int>(std::strlen(label))) == 1
+                   && EVP_PKEY_derive(context, out, &length) == 1 && length == size;
+    EVP_PKEY_CTX_free(context);
+    if (!derived) {
+        Metrics::Add(MetricCounter::CryptoErrors);
+        throw std::runtime_error("Key derivation failed.");
+    }
+}
+
+AeadCipher::AeadCipher(const CryptoHelper& session, const char* label) :
+    m_sealContext(EVP_CIPHER_CTX_new()), m_openContext(EVP_CIPHER_CTX_new()) {
+    unsigned char key[CryptoHelper::AES_KEY_LENGTH];
+    try {
+        session.DeriveKeyMaterial(label, key, sizeof(key));
+    } catch (...) {
+        EVP_CIPHER_CTX_free(m_sealContext);
+        EVP_CIPHER_CTX_free(m_openContext);
+        throw;
+    }
+    bool keyed = m_sealContext && m_openContext
+                 && EVP_EncryptInit_ex(m_sealContext, EVP_aes_256_gcm(), nullptr, key, nullptr) == 1
+                 && EVP_DecryptInit_ex(m_openContext, EVP_aes_256_gcm(), nullptr, key, nullptr) == 1;
+    OPENSSL_cleanse(key, sizeof(key));
+    if (!keyed) {
+        EVP_CIPHER_CTX_free(m_sealContext);
+        EVP_CIPHER_CTX_free(m_openContext);
+        throw std::runtime_error("Failed to create AES-GCM context.");
+    }
+}
+
+AeadCipher::~AeadCipher() {
+    EVP_CIPHER_CTX_free(m_sealContext);
+    EVP_CIPHER_CTX_free(m_openContext);
+}
+
+void
+AeadCipher::Seal(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+                 const unsigned char* plaintext, size_t size, unsigned char* out, unsigned char* tag) {
+    LatencyTimer timer(MetricStage::Encrypt);
+    int length = 0;
+    if (EVP_EncryptInit_ex(m_sealContext, nullptr, nullptr, nullptr, nonce) != 1
+        || (aadSize && EVP_EncryptUpdate(m_sealContext, nullptr, &length, aad, static_cast<int>(aadSize)) != 1)
+        || EVP_EncryptUpdate(m_sealContext, out, &length, plaintext, static_cast<int>(size)) != 1
+        || EVP_EncryptFinal_ex(m_sealContext, out + length, &length) != 1
+        || EVP_CIPHER_CTX_ctrl(m_sealContext, EVP_CTRL_GCM_GET_TAG, CryptoHelper::AEAD_TAG_SIZE, tag) != 1) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::CryptoErrors);
+        throw std::runtime_error("AES-GCM encryption failed.");
+    }
+    Metrics::Add(MetricCounter::BytesEncrypted, size);
+}
+
+bool
+AeadCipher::Open(const unsigned char* nonce, const unsigned char* aad, size_t aadSize,
+                 const unsigned char* ciphertext, size_t size, const unsigned char* tag, unsigned char* out) {
+    LatencyTimer timer(MetricStage::Decrypt);
+    int length = 0;
+    if (EVP_DecryptInit_ex(m_openContext, nullptr, nullptr, nullptr, nonce) != 1
+        || (aadSize && EVP_DecryptUpdate(m_openContext, nullptr, &length, aad, static_cast<int>(aadSize)) != 1)
+        || EVP_DecryptUpdate(m_openContext, out, &length, ciphertext, static_cast<int>(size)) != 1
+        || EVP_CIPHER_CTX_ctrl(m_openContext, EVP_CTRL_GCM_SET_TAG, CryptoHelper::AEAD_TAG_SIZE,
+                               const_cast<unsigned char*>(tag)) != 1
+        || EVP_DecryptFinal_ex(m_openContext, out + length, &length) != 1) {
+        timer.Cancel();
+        return false;
+    }
+    Metrics::Add(MetricCounter::BytesDecrypted, size);
+    return true;
 }
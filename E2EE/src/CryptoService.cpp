@@ -0,0 +1,157 @@
+#include "CryptoService.h"
+
+CryptoService::CryptoService(size_t workerCount, size_t batchSize) :
+    m_batchSize(batchSize ? batchSize : 1) {
+    if (workerCount == 0) {
+        workerCount = std::thread::hardware_concurrency();
+    }
+    if (workerCount == 0) {
+        workerCount = 1;
+    }
+    m_workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&CryptoService::WorkerLoop, this);
+    }
+}
+
+CryptoService::~CryptoService() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_ready.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void
+CryptoService::Post(CryptoHelper& session, Job job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        SessionQueue& queue = m_sessions[&session];
+        queue.jobs.push_back(std::move(job));
+        // Si la sesion ya esta en cola o en ejecucion, el trabajo entra en su lote
+        if (queue.scheduled) {
+            return;
+        }
+        queue.scheduled = true;
+        m_readySessions.push_back(&session);
+    }
+    m_ready.notify_one();
+}
+
+void
+CryptoService::WorkerLoop() {
+    std::vector<Job> batch;
+    batch.reserve(m_batchSize);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_ready.wait(lock, [this] { return m_stopping || !m_readySessions.empty(); });
+        if (m_readySessions.empty()) {
+            return; // m_stopping y nada pendiente
+        }
+
+        CryptoHelper* session = m_readySessions.front();
+        m_readySessions.pop_front();
+        SessionQueue& queue = m_sessions[session];
+        while (!queue.jobs.empty() && batch.size() < m_batchSize) {
+            batch.push_back(std::move(queue.jobs.front()));
+            queue.jobs.pop_front();
+        }
+
+        lock.unlock();
+        for (Job& job : batch) {
+            try {
+                job(*session);
+            } catch (const std::exception& e) {
+                std::cerr << "CryptoService job failed: " << e.what() << std::endl;
+            }
+        }
+        batch.clear();
+        lock.lock();
+
+        // La sesion sigue marcada mientras se ejecuta su lote, asi ningun otro
+        // hilo la toma en paralelo; al terminar vuelve al final de la cola
+        SessionQueue& current = m_sessions[session];
+        if (current.jobs.empty()) {
+            m_sessions.erase(session);
+        } else {
+            m_readySessions.push_back(session);
+            m_ready.notify_one();
+        }
+    }
+}
+
+std::future<CryptoService::EncryptResult>
+CryptoService::Encrypt(CryptoHelper& session, std::string plaintext) {
+    return Submit(session, [plaintext = std::move(plaintext)](CryptoHelper& helper) {
+        EncryptResult result;
+        result.ciphertext = helper.AESEncrypt(plaintext, result.iv);
+        return result;
+    });
+}
+
+void
+CryptoService::Encrypt(CryptoHelper& session, std::string plaintext, Callback<EncryptResult> onDone) {
+    Post(session, [plaintext = std::move(plaintext), onDone = std::move(onDone)](CryptoHelper& helper) {
+        EncryptResult result;
+        std::exception_ptr error;
+        try {
+            result.ciphertext = helper.AESEncrypt(plaintext, result.iv);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        onDone(error, std::move(result));
+    });
+}
+
+std::future<std::string>
+CryptoService::Decrypt(CryptoHelper& session, std::vector<unsigned char> ciphertext, std::vector<unsigned char> iv) {
+    return Submit(session, [ciphertext = std::move(ciphertext), iv = std::move(iv)](CryptoHelper& helper) {
+        return helper.AESDescrypt(ciphertext, iv);
+    });
+}
+
+void
+CryptoService::Decrypt(CryptoHelper& session, std::vector<unsigned char> ciphertext, std::vector<unsigned char> iv,
+                       Callback<std::string> onDone) {
+    Post(session, [ciphertext = std::move(ciphertext), iv = std::move(iv),
+                   onDone = std::move(onDone)](CryptoHelper& helper) {
+        std::string plaintext;
+        std::exception_ptr error;
+        try {
+            plaintext = helper.AESDescrypt(ciphertext, iv);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        onDone(error, std::move(plaintext));
+    });
+}
+
+std::future<void>
+CryptoService::GenerateKeys(CryptoHelper& session) {
+    return Submit(session, [](CryptoHelper& helper) { helper.GenerateRSAKeys(); });
+}
+
+std::future<std::vector<unsigned char>>
+CryptoService::WrapSessionKey(CryptoHelper& session, std::string peerPemKey) {
+    return Submit(session, [peerPemKey = std::move(peerPemKey)](CryptoHelper& helper) {
+        helper.LoadPeerPublicKey(peerPemKey);
+        helper.GenerateAESKey();
+        return helper.EncryptAESKeyWithPeer();
+    });
+}
+
+std::future<void>
+CryptoService::UnwrapSessionKey(CryptoHelper& session, std::vector<unsigned char> encryptedKey) {
+    return Submit(session, [encryptedKey = std::move(encryptedKey)](CryptoHelper& helper) {
+        helper.DecryptAESKey(encryptedKey);
+    });
+}
+
+size_t
+CryptoService::WorkerCount() const {
+    return m_workers.size();
+}
@@ -0,0 +1,74 @@
+#include "Datagram.h"
+#include "Metrics.h"
+
+namespace {
+void
+BuildNonce(unsigned char* nonce, uint32_t direction, const unsigned char* sequence) {
+    WriteU32(nonce, direction);
+    std::memcpy(nonce + 4, sequence, 8);
+}
+}
+
+DatagramSession::DatagramSession(CryptoHelper& crypto, HandshakeRole role) :
+    m_cipher(crypto, "e2ee datagram"),
+    m_sequence(crypto.Datagrams()),
+    m_sendDirection(role == HandshakeRole::Client ? 0 : 1),
+    m_receiveDirection(role == HandshakeRole::Client ? 1 : 0),
+    m_window(m_sequence.highestReceived.load(std::memory_order_acquire)) {
+}
+
+size_t
+DatagramSession::Seal(const unsigned char* plaintext, size_t size, unsigned char* out) {
+    // Compartida con los demas DatagramSession de la sesion
+    uint64_t sequence = m_sequence.nextSend.fetch_add(1, std::memory_order_relaxed);
+    if (sequence == 0 || sequence == UINT64_MAX) {
+        m_sequence.nextSend.store(UINT64_MAX, std::memory_order_relaxed);
+        throw std::runtime_error("Datagram sequence numbers exhausted.");
+    }
+    out[0] = static_cast<unsigned char>(FrameType::Data);
+    WriteU64(out + 1, sequence);
+    unsigned char nonce[CryptoHelper::AEAD_NONCE_SIZE];
+    BuildNonce(nonce, m_sendDirection, out + 1);
+    m_cipher.Seal(nonce, out, HEADER_SIZE, plaintext, size, out + HEADER_SIZE, out + HEADER_SIZE + size);
+    return size + OVERHEAD;
+}
+
+std::optional<std::string>
+DatagramSession::Open(const unsigned char* record, size_t size) {
+    if (size < OVERHEAD || record[0] != static_cast<unsigned char>(FrameType::Data)) {
+        Metrics::Add(MetricCounter::DatagramsDropped);
+        return std::nullopt;
+    }
+    // La ventana se consulta antes de descifrar y se actualiza solo si el tag es valido
+    uint64_t sequence = ReadU64(record + 1);
+    if (!m_window.IsFresh(sequence)) {
+        Metrics::Add(MetricCounter::DatagramsDropped);
+        return std::nullopt;
+    }
+    unsigned char nonce[CryptoHelper::AEAD_NONCE_SIZE];
+    BuildNonce(nonce, m_receiveDirection, record + 1);
+    size_t length = size - OVERHEAD;
+    std::string plaintext(length, '\0');
+    if (!m_cipher.Open(nonce, record, HEADER_SIZE, record + HEADER_SIZE, length, record + HEADER_SIZE + length,
+                       reinterpret_cast<unsigned char*>(plaintext.data()))) {
+        Metrics::Add(MetricCounter::DatagramsDropped);
+        return std::nullopt;
+    }
+    m_window.Mark(sequence);
+    uint64_t highest = m_sequence.highestReceived.load(std::memory_order_relaxed);
+    while (highest < sequence
+           && !m_sequence.highestReceived.compare_exchange_weak(highest, sequence, std::memory_order_release,
+                                                                std::memory_order_relaxed)) {
+    }
+    return plaintext;
+}
+
+SocketAddress&
+DatagramSession::Peer() {
+    return m_peer;
+}
+
+bool
+DatagramSession::HasPeer() const {
+    return m_peer.length != 0;
+}
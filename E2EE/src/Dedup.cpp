@@ -0,0 +1,412 @@
+#include "Dedup.h"
+#include "Metrics.h"
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#include <fstream>
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Indice guardado: [magic][identidad del archivo u64][bloques u64] y
+// [SHA-256][offset u64][tamano u32] por bloque
+constexpr char INDEX_MAGIC[8] = {'E', '2', 'E', 'E', 'C', 'D', 'X', '1'};
+constexpr size_t INDEX_HEADER_SIZE = 24;
+constexpr size_t INDEX_ENTRY_SIZE = 44;
+
+// Tabla Gear: 256 valores pseudoaleatorios fijos (splitmix64), los mismos en
+// los dos extremos
+constexpr std::array<uint64_t, 256>
+MakeGearTable() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0;
+    for (uint64_t& value : table) {
+        state += 0x9E3779B97F4A7C15;
+        uint64_t mixed = state;
+        mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EB;
+        value = mixed ^ (mixed >> 31);
+    }
+    return table;
+}
+
+constexpr std::array<uint64_t, 256> GEAR = MakeGearTable();
+
+// El hash se desplaza a la izquierda: los bits altos dependen de los ultimos
+// 64 bytes. Antes del tamano medio se exigen mas bits a cero (cortes menos
+// probables) y despues menos, asi los bloques se agrupan cerca de la media.
+constexpr uint64_t MASK_SMALL = ~uint64_t(0) << (64 - 18);
+constexpr uint64_t MASK_LARGE = ~uint64_t(0) << (64 - 14);
+
+ChunkHash
+Sha256(const unsigned char* data, size_t size) {
+    ChunkHash hash{};
+    if (EVP_Digest(data, size, hash.data(), nullptr, EVP_sha256(), nullptr) != 1) {
+        throw std::runtime_error("SHA-256 failed.");
+    }
+    return hash;
+}
+
+std::string
+IndexPath(const std::string& path) {
+    return path + ".chunks";
+}
+
+bool
+LoadStoredIndex(const std::string& path, uint64_t fingerprint, uint64_t size, std::vector<ContentChunk>& chunks) {
+    std::ifstream in(IndexPath(path), std::ios::binary);
+    unsigned char header[INDEX_HEADER_SIZE];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))
+        || std::memcmp(header, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || ReadU64(header + 8) != fingerprint) {
+        return false;
+    }
+    uint64_t count = ReadU64(header + 16);
+    if (count > size) { // cada bloque tiene al menos un byte
+        return false;
+    }
+    std::vector<unsigned char> entries(count * INDEX_ENTRY_SIZE);
+    if (!in.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(entries.size()))) {
+        return false;
+    }
+    chunks.resize(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        const unsigned char* entry = entries.data() + i * INDEX_ENTRY_SIZE;
+        ContentChunk& chunk = chunks[i];
+        std::memcpy(chunk.hash.data(), entry, chunk.hash.size());
+        chunk.offset = ReadU64(entry + 32);
+        chunk.size = ReadU32(entry + 40);
+        if (chunk.size > size || chunk.offset > size - chunk.size) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+size_t
+NextChunkBoundary(const unsigned char* data, size_t size) {
+    if (size <= CDC_MIN_SIZE) {
+        return size;
+    }
+    size_t limit = std::min(size, CDC_MAX_SIZE);
+    size_t normal = std::min(limit, CDC_AVERAGE_SIZE);
+    uint64_t hash = 0;
+    size_t i = CDC_MIN_SIZE;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + GEAR[data[i]];
+        if (!(hash & MASK_SMALL)) {
+            return i + 1;
+        }
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + GEAR[data[i]];
+        if (!(hash & MASK_LARGE)) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+std::vector<ContentChunk>
+ChunkFile(MappedFile& file) {
+    std::vector<ContentChunk> chunks;
+    chunks.reserve(static_cast<size_t>(file.Size() / CDC_AVERAGE_SIZE + 1));
+    uint64_t offset = 0;
+    while (offset < file.Size()) {
+        ContentChunk chunk;
+        chunk.offset = offset;
+        chunk.size = static_cast<uint32_t>(
+            NextChunkBoundary(file.Data() + offset, static_cast<size_t>(std::min<uint64_t>(file.Size() - offset, CDC_MAX_SIZE))));
+        chunk.hash = Sha256(file.Data() + offset, chunk.size);
+        file.Release(offset, chunk.size);
+        offset += chunk.size;
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+bool
+ChunkIndex::Load(const std::string& path) {
+#ifndef _WIN32
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return true; // primera sincronizacion: no hay nada que reutilizar
+    }
+    if (!m_file.Open(path)) {
+        return false;
+    }
+    std::vector<ContentChunk> chunks;
+    uint64_t fingerprint = FileFingerprint(m_file.Descriptor(), CDC_AVERAGE_SIZE);
+    if (!LoadStoredIndex(path, fingerprint, m_file.Size(), chunks)) {
+        try {
+            chunks = ChunkFile(m_file);
+        } catch (const std::exception& e) {
+            std::cerr << "Error indexing file: " << e.what() << std::endl;
+            return false;
+        }
+    }
+    m_chunks.clear();
+    for (const ContentChunk& chunk : chunks) {
+        m_chunks.emplace(chunk.hash, chunk);
+    }
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+const ContentChunk*
+ChunkIndex::Find(const ChunkHash& hash) const {
+    auto found = m_chunks.find(hash);
+    return found == m_chunks.end() ? nullptr : &found->second;
+}
+
+const unsigned char*
+ChunkIndex::Data(const ContentChunk& chunk) const {
+    return m_file.Data() + chunk.offset;
+}
+
+bool
+ChunkIndex::Save(const std::string& path, uint64_t fingerprint, const std::vector<ContentChunk>& chunks) {
+    std::vector<unsigned char> out(INDEX_HEADER_SIZE + chunks.size() * INDEX_ENTRY_SIZE);
+    std::memcpy(out.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    WriteU64(out.data() + 8, fingerprint);
+    WriteU64(out.data() + 16, chunks.size());
+    unsigned char* entry = out.data() + INDEX_HEADER_SIZE;
+    for (const ContentChunk& chunk : chunks) {
+        std::memcpy(entry, chunk.hash.data(), chunk.hash.size());
+        WriteU64(entry + 32, chunk.offset);
+        WriteU32(entry + 40, chunk.size);
+        entry += INDEX_ENTRY_SIZE;
+    }
+    // Un indice a medias no carga: la identidad o la longitud no cuadran
+    std::ofstream file(IndexPath(path), std::ios::binary | std::ios::trunc);
+    return static_cast<bool>(file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size())));
+}
+
+void
+ChunkIndex::Discard(const std::string& path) {
+    std::remove(IndexPath(path).c_str());
+}
+
+std::vector<unsigned char>
+EncodeSyncManifest(uint64_t size, const std::vector<ContentChunk>& chunks) {
+    std::vector<unsigned char> out(SYNC_MANIFEST_HEADER_SIZE + chunks.size() * SYNC_MANIFEST_ENTRY_SIZE);
+    WriteU64(out.data(), size);
+    WriteU32(out.data() + 8, static_cast<uint32_t>(chunks.size()));
+    unsigned char* entry = out.data() + SYNC_MANIFEST_HEADER_SIZE;
+    for (const ContentChunk& chunk : chunks) {
+        std::memcpy(entry, chunk.hash.data(), chunk.hash.size());
+        WriteU32(entry + 32, chunk.size);
+        entry += SYNC_MANIFEST_ENTRY_SIZE;
+    }
+    return out;
+}
+
+bool
+DecodeSyncManifest(const unsigned char* in, size_t size, std::vector<ContentChunk>& chunks) {
+    if (size < SYNC_MANIFEST_HEADER_SIZE) {
+        return false;
+    }
+    uint64_t total = ReadU64(in);
+    size_t count = ReadU32(in + 8);
+    if (size != SYNC_MANIFEST_HEADER_SIZE + count * SYNC_MANIFEST_ENTRY_SIZE) {
+        return false;
+    }
+    chunks.resize(count);
+    const unsigned char* entry = in + SYNC_MANIFEST_HEADER_SIZE;
+    uint64_t offset = 0;
+    for (ContentChunk& chunk : chunks) {
+        std::memcpy(chunk.hash.data(), entry, chunk.hash.size());
+        chunk.size = ReadU32(entry + 32);
+        chunk.offset = offset;
+        if (chunk.size == 0 || chunk.size > CDC_MAX_SIZE) {
+            return false;
+        }
+        offset += chunk.size;
+        entry += SYNC_MANIFEST_ENTRY_SIZE;
+    }
+    return offset == total;
+}
+
+SyncSink::~SyncSink() {
+#ifndef _WIN32
+    // Sin Commit el archivo nuevo quedo a medias: path sigue como estaba
+    if (m_descriptor >= 0) {
+        ::close(m_descriptor);
+        std::remove(m_temporaryPath.c_str());
+    }
+#endif
+}
+
+bool
+SyncSink::Open(const std::string& path, std::vector<ContentChunk> chunks) {
+#ifndef _WIN32
+    m_path = path;
+    m_temporaryPath = path + ".sync";
+    m_chunks = std::move(chunks);
+    if (!m_index.Load(path)) {
+        return false;
+    }
+    m_need.assign((m_chunks.size() + 7) / 8, 0);
+    for (size_t i = 0; i < m_chunks.size(); ++i) {
+        const ContentChunk& chunk = m_chunks[i];
+        if (!m_index.Find(chunk.hash) && m_written.emplace(chunk.hash, chunk.offset).second) {
+            m_need[i / 8] |= static_cast<unsigned char>(1 << (i % 8));
+        }
+    }
+    m_descriptor = ::open(m_temporaryPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_descriptor < 0) {
+        std::cerr << "Error creating file: " << m_temporaryPath << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)path;
+    (void)chunks;
+    std::cerr << "File sync is not supported on this platform" << std::endl;
+    return false;
+#endif
+}
+
+const std::vector<ContentChunk>&
+SyncSink::Chunks() const {
+    return m_chunks;
+}
+
+const std::vector<unsigned char>&
+SyncSink::Need() const {
+    return m_need;
+}
+
+bool
+SyncSink::Needs(size_t index) const {
+    return m_need[index / 8] & (1 << (index % 8));
+}
+
+bool
+SyncSink::Write(size_t index, const unsigned char* data) {
+#ifndef _WIN32
+    const ContentChunk& chunk = m_chunks[index];
+    if (!data) {
+        if (const ContentChunk* held = m_index.Find(chunk.hash)) {
+            data = m_index.Data(*held);
+            // El indice puede haber quedado viejo si el archivo cambio sin tocar el mtime
+            if (held->size != chunk.size || Sha256(data, chunk.size) != chunk.hash) {
+                std::cerr << "Stored chunk does not match its index: " << m_path << std::endl;
+                ChunkIndex::Discard(m_path);
+                return false;
+            }
+        } else {
+            m_copy.resize(chunk.size);
+            auto first = m_written.find(chunk.hash);
+            if (first == m_written.end()
+                || pread(m_descriptor, m_copy.data(), chunk.size, static_cast<off_t>(first->second))
+                       != static_cast<ssize_t>(chunk.size)) {
+                return false;
+            }
+            data = m_copy.data();
+        }
+    }
+    if (!WriteAt(m_descriptor, data, chunk.size, chunk.offset)) {
+        std::cerr << "Error writing file: " << m_temporaryPath << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)index;
+    (void)data;
+    return false;
+#endif
+}
+
+bool
+SyncSink::Commit() {
+#ifndef _WIN32
+    uint64_t fingerprint = FileFingerprint(m_descriptor, CDC_AVERAGE_SIZE);
+    bool closed = ::close(m_descriptor) == 0;
+    m_descriptor = -1;
+    if (!closed || std::rename(m_temporaryPath.c_str(), m_path.c_str()) != 0) {
+        std::cerr << "Error replacing file: " << m_path << std::endl;
+        std::remove(m_temporaryPath.c_str());
+        return false;
+    }
+    // Sin indice la siguiente sincronizacion vuelve a cortar el archivo
+    if (!ChunkIndex::Save(m_path, fingerprint, m_chunks)) {
+        ChunkIndex::Discard(m_path);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+ConvergentCipher::ConvergentCipher(const CryptoHelper& session) : m_context(EVP_CIPHER_CTX_new()) {
+    if (!m_context || EVP_CipherInit_ex(m_context, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, 1) != 1) {
+        EVP_CIPHER_CTX_free(m_context);
+        throw std::runtime_error("Failed to create cipher context.");
+    }
+    try {
+        session.DeriveKeyMaterial("e2ee dedup", m_key, sizeof(m_key));
+    } catch (...) {
+        EVP_CIPHER_CTX_free(m_context);
+        throw;
+    }
+}
+
+ConvergentCipher::~ConvergentCipher() {
+    OPENSSL_cleanse(m_key, sizeof(m_key));
+    EVP_CIPHER_CTX_free(m_context);
+}
+
+void
+ConvergentCipher::ChunkKey(const ChunkHash& hash, unsigned char* key) const {
+    unsigned int length = 0;
+    if (!HMAC(EVP_sha256(), m_key, sizeof(m_key), hash.data(), hash.size(), key, &length)
+        || length != CryptoHelper::AES_KEY_LENGTH) {
+        throw std::runtime_error("HMAC failed.");
+    }
+}
+
+void
+ConvergentCipher::Seal(const ChunkHash& hash, const unsigned char* data, size_t size, unsigned char* out) {
+    unsigned char key[CryptoHelper::AES_KEY_LENGTH];
+    ChunkKey(hash, key);
+    const unsigned char nonce[CryptoHelper::AEAD_NONCE_SIZE] = {};
+    int length = 0;
+    bool sealed = EVP_EncryptInit_ex(m_context, nullptr, nullptr, key, nonce) == 1
+                  && EVP_EncryptUpdate(m_context, nullptr, &length, hash.data(), static_cast<int>(hash.size())) == 1
+                  && EVP_EncryptUpdate(m_context, out, &length, data, static_cast<int>(size)) == 1
+                  && EVP_EncryptFinal_ex(m_context, out + length, &length) == 1
+                  && EVP_CIPHER_CTX_ctrl(m_context, EVP_CTRL_GCM_GET_TAG, CryptoHelper::AEAD_TAG_SIZE, out + size) == 1;
+    OPENSSL_cleanse(key, sizeof(key));
+    if (!sealed) {
+        Metrics::Add(MetricCounter::CryptoErrors);
+        throw std::runtime_error("AES-GCM encryption failed.");
+    }
+    Metrics::Add(MetricCounter::BytesEncrypted, size);
+}
+
+bool
+ConvergentCipher::Open(const ChunkHash& hash, unsigned char* data, size_t size) {
+    unsigned char key[CryptoHelper::AES_KEY_LENGTH];
+    ChunkKey(hash, key);
+    const unsigned char nonce[CryptoHelper::AEAD_NONCE_SIZE] = {};
+    int length = 0;
+    bool opened = EVP_DecryptInit_ex(m_context, nullptr, nullptr, key, nonce) == 1
+                  && EVP_DecryptUpdate(m_context, nullptr, &length, hash.data(), static_cast<int>(hash.size())) == 1
+                  && EVP_DecryptUpdate(m_context, data, &length, data, static_cast<int>(size)) == 1
+                  && EVP_CIPHER_CTX_ctrl(m_context, EVP_CTRL_GCM_SET_TAG, CryptoHelper::AEAD_TAG_SIZE, data + size) == 1
+                  && EVP_DecryptFinal_ex(m_context, data + length, &length) == 1;
+    OPENSSL_cleanse(key, sizeof(key));
+    if (!opened) {
+        return false;
+    }
+    Metrics::Add(MetricCounter::BytesDecrypted, size);
+    ChunkHash actual = Sha256(data, size);
+    return CRYPTO_memcmp(actual.data(), hash.data(), hash.size()) == 0;
+}
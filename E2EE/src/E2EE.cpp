@@ -1,9 +1,140 @@
+#include "Server.h"
+#include "Metrics.h"
 #include <openssl/crypto.h>
 #include <iostream>
 
+namespace {
+// Cliente interactivo: cada linea de stdin se envia cifrada y se imprime el eco
 int
-main()
+RunClient(const std::string& address) {
+    NetworkHelper network;
+    CryptoHelper crypto;
+    if (!network.ConnectToServer(address) || !network.ClientHandshake(crypto)) {
+        return 1;
+    }
+    std::cout << "Secure session established" << std::endl;
+    SOCKET socket = network.GetSocket();
+
+    Frame frame;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::vector<unsigned char> payload = SealDataPayload(crypto, line);
+        if (!network.SendFrame(socket, FrameType::Data, payload.data(), payload.size())
+            || !network.ReceiveFrame(socket, frame) || frame.type != FrameType::Data) {
+            std::cerr << "Connection closed" << std::endl;
+            return 1;
+        }
+        std::optional<std::string> reply = OpenDataPayload(crypto, frame.payload);
+        if (!reply) {
+            std::cerr << "Malformed encrypted message" << std::endl;
+            return 1;
+        }
+        std::cout << "Server: " << *reply << std::endl;
+    }
+    return 0;
+}
+
+// Envia un archivo por varias conexiones; con kTLS cada bloque sale con sendfile
+int
+RunSendFile(const std::string& path, const std::string& address, int streams) {
+    if (!NetworkHelper::SendFileParallel(address, path, streams)) {
+        return 1;
+    }
+    std::cout << "File sent" << std::endl;
+    return 0;
+}
+
+// Envia solo los bloques del archivo que el receptor no tiene ya
+int
+RunSyncFile(const std::string& path, const std::string& address) {
+    NetworkHelper network;
+    CryptoHelper crypto;
+    if (!network.ConnectToServer(address) || !network.ClientHandshake(crypto)
+        || !network.RequestKernelTls(network.GetSocket(), crypto)
+        || !network.SyncFile(network.GetSocket(), crypto, path)) {
+        return 1;
+    }
+    std::cout << "File synchronized, "
+              << Metrics::Snapshot().Get(MetricCounter::BytesDeduplicated) << " bytes already at the receiver"
+              << std::endl;
+    return 0;
+}
+
+// Escribe el archivo que envie el siguiente emisor
+int
+RunReceiveFile(const std::string& path, const std::string& address) {
+    Server server(address);
+    if (!server.Start()) {
+        return 1;
+    }
+    if (!server.ReceiveFile(path)) {
+        return 1;
+    }
+    std::cout << "File received" << std::endl;
+    return 0;
+}
+
+// Actualiza path con la version que envie el siguiente cliente de sync-file
+int
+RunReceiveSync(const std::string& path, const std::string& address) {
+    Server server(address);
+    if (!server.Start() || !server.ReceiveSync(path)) {
+        return 1;
+    }
+    std::cout << "File synchronized" << std::endl;
+    return 0;
+}
+
+int
+RunServer(const std::string& address) {
+    Server server(address);
+    if (!server.Start()) {
+        return 1;
+    }
+    server.Run();
+    return 0;
+}
+}
+
+int
+main(int argc, char** argv)
 {
     std::cout << "OpenSSL version: " << OpenSSL_version(OPENSSL_VERSION) << std::endl;
-    return 0;
+
+    std::string mode = argc > 1 ? argv[1] : "";
+    std::string target = argc > 2 ? argv[2] : "";
+    // Un numero solo es un puerto TCP; "ip puerto" se acepta como antes
+    bool portOnly = !target.empty() && target.find_first_not_of("0123456789") == std::string::npos;
+    if (mode == "server") {
+        return RunServer(target.empty() ? "*:27015" : portOnly ? "*:" + target : target);
+    }
+    if (mode == "client") {
+        if (target.empty() || portOnly) {
+            target = "127.0.0.1:" + (portOnly ? target : std::string("27015"));
+        } else if (target.find(':') == std::string::npos) {
+            target += ":" + std::string(argc > 3 ? argv[3] : "27015");
+        }
+        return RunClient(target);
+    }
+    if ((mode == "send-file" || mode == "recv-file") && !target.empty()) {
+        std::string address = argc > 3 ? argv[3] : "";
+        if (mode == "send-file") {
+            int streams = argc > 4 ? std::atoi(argv[4]) : DEFAULT_FILE_STREAMS;
+            return RunSendFile(target, address.empty() ? "127.0.0.1:27015" : address, streams);
+        }
+        return RunReceiveFile(target, address.empty() ? "*:27015" : address);
+    }
+    if ((mode == "sync-file" || mode == "recv-sync") && !target.empty()) {
+        std::string address = argc > 3 ? argv[3] : "";
+        if (mode == "sync-file") {
+            return RunSyncFile(target, address.empty() ? "127.0.0.1:27015" : address);
+        }
+        return RunReceiveSync(target, address.empty() ? "*:27015" : address);
+    }
+    std::cout << "Usage: E2EE server [port | address]" << std::endl
+              << "       E2EE client [ip] [port] | client address" << std::endl
+              << "       E2EE send-file path [address [streams]] | recv-file path [address]" << std::endl
+              << "       E2EE sync-file path [address] | recv-sync path [address]" << std::endl
+              << "Addresses: tcp://host:port, unix:/path, unix+seqpacket:/path" << std::endl;
+    return mode.empty() ? 0 : 1;
 }
@@ -0,0 +1,218 @@
+#include "Endpoint.h"
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+namespace {
+const std::string TCP_SCHEME = "tcp://";
+const std::string UNIX_SCHEME = "unix:";
+const std::string SEQPACKET_SCHEME = "unix+seqpacket:";
+const std::string INPROC_SCHEME = "inproc:";
+const std::string INPROC_ABSTRACT_PREFIX = "e2ee-inproc-";
+
+bool
+StartsWith(const std::string& text, const std::string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Nombres InProc -> direccion real del socket que escucha
+struct InProcRegistry {
+    std::mutex mutex;
+    std::map<std::string, SocketAddress> listeners;
+};
+
+InProcRegistry&
+Registry() {
+    static InProcRegistry registry;
+    return registry;
+}
+
+bool
+ResolveTcp(const Endpoint& endpoint, bool listening, SocketAddress& address) {
+    sockaddr_in tcpAddress{};
+    tcpAddress.sin_family = AF_INET;
+    tcpAddress.sin_port = htons(static_cast<unsigned short>(endpoint.port));
+    if (endpoint.host.empty() || endpoint.host == "*") {
+        if (!listening) {
+            std::cerr << "Missing host in address: " << FormatEndpoint(endpoint) << std::endl;
+            return false;
+        }
+        tcpAddress.sin_addr.s_addr = INADDR_ANY;
+    } else {
+        const char* host = endpoint.host == "localhost" ? "127.0.0.1" : endpoint.host.c_str();
+        if (inet_pton(AF_INET, host, &tcpAddress.sin_addr) != 1) {
+            std::cerr << "Invalid IPv4 address: " << endpoint.host << std::endl;
+            return false;
+        }
+    }
+    std::memcpy(&address.storage, &tcpAddress, sizeof(tcpAddress));
+    address.length = sizeof(tcpAddress);
+    address.family = AF_INET;
+    address.type = SOCK_STREAM;
+    address.protocol = IPPROTO_TCP;
+    return true;
+}
+
+bool
+ResolveUnix(const std::string& path, bool abstract, int type, SocketAddress& address) {
+    sockaddr_un unixAddress{};
+    unixAddress.sun_family = AF_UNIX;
+    // Los nombres abstractos (Linux) empiezan con '\0' y no tienen terminador
+    size_t offset = abstract ? 1 : 0;
+    if (path.empty() || offset + path.size() >= sizeof(unixAddress.sun_path)) {
+        std::cerr << "Invalid Unix socket path: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(unixAddress.sun_path + offset, path.data(), path.size());
+    std::memcpy(&address.storage, &unixAddress, sizeof(unixAddress));
+    address.length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + offset + path.size() + (abstract ? 0 : 1));
+    address.family = AF_UNIX;
+    address.type = type;
+    address.protocol = 0;
+    return true;
+}
+}
+
+bool
+ParseEndpoint(const std::string& address, Endpoint& endpoint) {
+    endpoint = Endpoint{};
+    if (StartsWith(address, SEQPACKET_SCHEME)) {
+#ifdef _WIN32
+        std::cerr << "SOCK_SEQPACKET is not supported on Windows: " << address << std::endl;
+        return false;
+#else
+        endpoint.transport = Transport::UnixSeqPacket;
+        endpoint.path = address.substr(SEQPACKET_SCHEME.size());
+#endif
+    } else if (StartsWith(address, UNIX_SCHEME)) {
+        endpoint.transport = Transport::Unix;
+        endpoint.path = address.substr(UNIX_SCHEME.size());
+    } else if (StartsWith(address, INPROC_SCHEME)) {
+        endpoint.transport = Transport::InProc;
+        endpoint.path = address.substr(INPROC_SCHEME.size());
+    } else {
+        std::string hostPort = StartsWith(address, TCP_SCHEME) ? address.substr(TCP_SCHEME.size()) : address;
+        size_t colon = hostPort.rfind(':');
+        if (colon == std::string::npos) {
+            std::cerr << "Missing port in address: " << address << std::endl;
+            return false;
+        }
+        const char* first = hostPort.data() + colon + 1;
+        const char* last = hostPort.data() + hostPort.size();
+        auto [end, error] = std::from_chars(first, last, endpoint.port);
+        if (first == last || error != std::errc() || end != last || endpoint.port < 0 || endpoint.port > 65535) {
+            std::cerr << "Invalid port in address: " << address << std::endl;
+            return false;
+        }
+        endpoint.host = hostPort.substr(0, colon);
+        return true;
+    }
+    if (endpoint.path.empty()) {
+        std::cerr << "Missing path in address: " << address << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string
+FormatEndpoint(const Endpoint& endpoint) {
+    switch (endpoint.transport) {
+    case Transport::Unix:
+        return UNIX_SCHEME + endpoint.path;
+    case Transport::UnixSeqPacket:
+        return SEQPACKET_SCHEME + endpoint.path;
+    case Transport::InProc:
+        return INPROC_SCHEME + endpoint.path;
+    default:
+        return TCP_SCHEME + (endpoint.host.empty() ? "*" : endpoint.host) + ":" + std::to_string(endpoint.port);
+    }
+}
+
+bool
+ResolveEndpoint(const Endpoint& endpoint, bool listening, SocketAddress& address) {
+    address = SocketAddress{};
+    switch (endpoint.transport) {
+    case Transport::Unix:
+        return ResolveUnix(endpoint.path, false, SOCK_STREAM, address);
+    case Transport::UnixSeqPacket:
+#ifdef _WIN32
+        std::cerr << "SOCK_SEQPACKET is not supported on Windows" << std::endl;
+        return false;
+#else
+        return ResolveUnix(endpoint.path, false, SOCK_SEQPACKET, address);
+#endif
+    case Transport::InProc:
+        if (listening) {
+            // El nombre real se puede adivinar: CheckInProcPeer rechaza al aceptar
+            // a quien no sea este proceso
+#ifdef __linux__
+            static std::atomic<uint64_t> counter{0};
+            return ResolveUnix(INPROC_ABSTRACT_PREFIX + std::to_string(getpid()) + "-" + std::to_string(counter++),
+                               true, SOCK_STREAM, address);
+#else
+            // Sin espacio de nombres abstracto: loopback con puerto efimero,
+            // alcanzable por cualquier usuario local
+            Endpoint loopback;
+            loopback.host = "127.0.0.1";
+            return ResolveTcp(loopback, true, address);
+#endif
+        } else {
+            std::lock_guard<std::mutex> lock(Registry().mutex);
+            auto it = Registry().listeners.find(endpoint.path);
+            if (it == Registry().listeners.end()) {
+                std::cerr << "No in-process listener named " << endpoint.path << std::endl;
+                return false;
+            }
+            address = it->second;
+            return true;
+        }
+    default:
+        return ResolveTcp(endpoint, listening, address);
+    }
+}
+
+bool
+RegisterInProc(const std::string& name, const SocketAddress& address) {
+    std::lock_guard<std::mutex> lock(Registry().mutex);
+    if (!Registry().listeners.emplace(name, address).second) {
+        std::cerr << "In-process name already in use: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void
+UnregisterInProc(const std::string& name) {
+    std::lock_guard<std::mutex> lock(Registry().mutex);
+    Registry().listeners.erase(name);
+}
+
+bool
+CheckInProcPeer(SOCKET listenSocket, SOCKET clientSocket) {
+#ifdef __linux__
+    sockaddr_un local{};
+    socklen_t length = sizeof(local);
+    if (getsockname(listenSocket, reinterpret_cast<sockaddr*>(&local), &length) != 0 || local.sun_family != AF_UNIX) {
+        return true;
+    }
+    size_t nameLength = length > offsetof(sockaddr_un, sun_path) ? length - offsetof(sockaddr_un, sun_path) : 0;
+    if (nameLength <= INPROC_ABSTRACT_PREFIX.size() || local.sun_path[0] != '\0'
+        || INPROC_ABSTRACT_PREFIX.compare(0, INPROC_ABSTRACT_PREFIX.size(), local.sun_path + 1,
+                                          INPROC_ABSTRACT_PREFIX.size()) != 0) {
+        return true;
+    }
+    ucred credentials{};
+    socklen_t size = sizeof(credentials);
+    if (getsockopt(clientSocket, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0 || credentials.pid != getpid()) {
+        std::cerr << "Rejected in-process connection from another process" << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)listenSocket;
+    (void)clientSocket;
+    return true;
+#endif
+}
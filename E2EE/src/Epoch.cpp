@@ -0,0 +1,125 @@
+#include "Epoch.h"
+#include <atomic>
+#include <mutex>
+
+namespace {
+// Una linea de cache por registro: anunciar la epoca no invalida la de otro hilo
+struct alignas(64) ThreadRecord {
+    std::atomic<uint64_t> epoch{0}; // 0 = fuera de todo EpochGuard
+    std::atomic<bool> used{false};
+};
+
+struct Retired {
+    uint64_t epoch;
+    std::function<void()> fn;
+};
+
+ThreadRecord g_records[EPOCH_MAX_THREADS];
+std::atomic<uint64_t> g_epoch{1};
+std::mutex g_retiredMutex;
+std::vector<Retired> g_retired;
+
+struct ThreadSlot {
+    ThreadRecord* record = nullptr;
+    int depth = 0;
+
+    ~ThreadSlot() {
+        if (record) {
+            record->epoch.store(0, std::memory_order_release);
+            record->used.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+ThreadRecord&
+ThreadRecordForThisThread() {
+    if (!t_slot.record) {
+        for (ThreadRecord& record : g_records) {
+            bool expected = false;
+            if (!record.used.load(std::memory_order_relaxed)
+                && record.used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                t_slot.record = &record;
+                break;
+            }
+        }
+        if (!t_slot.record) {
+            throw std::runtime_error("Too many threads inside EpochGuard.");
+        }
+    }
+    return *t_slot.record;
+}
+
+// La global pasa de current a current + 1 si ningun hilo dentro de un
+// EpochGuard sigue en una anterior
+uint64_t
+TryAdvance(uint64_t current) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (const ThreadRecord& record : g_records) {
+        uint64_t epoch = record.epoch.load(std::memory_order_acquire);
+        if (epoch != 0 && epoch != current) {
+            return current;
+        }
+    }
+    g_epoch.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+    return g_epoch.load(std::memory_order_acquire);
+}
+}
+
+EpochGuard::EpochGuard() {
+    ThreadRecord& record = ThreadRecordForThisThread();
+    if (t_slot.depth++ == 0) {
+        record.epoch.store(g_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // El anuncio debe verse antes que cualquier lectura de la estructura
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+EpochGuard::~EpochGuard() {
+    if (--t_slot.depth == 0) {
+        t_slot.record->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void
+EpochRetire(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(g_retiredMutex);
+        g_retired.push_back({g_epoch.load(std::memory_order_acquire), std::move(fn)});
+    }
+    EpochCollect();
+}
+
+void
+EpochCollect() {
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(g_retiredMutex);
+        if (g_retired.empty()) {
+            return;
+        }
+        // Sin lectores dentro, dos avances bastan para liberar lo recien retirado
+        uint64_t epoch = g_epoch.load(std::memory_order_acquire);
+        for (int i = 0; i < 2; ++i) {
+            uint64_t next = TryAdvance(epoch);
+            if (next == epoch) {
+                break;
+            }
+            epoch = next;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < g_retired.size(); ++i) {
+            if (g_retired[i].epoch + 2 <= epoch) {
+                ready.push_back(std::move(g_retired[i].fn));
+            } else if (kept++ != i) {
+                g_retired[kept - 1] = std::move(g_retired[i]);
+            }
+        }
+        g_retired.resize(kept);
+    }
+    // Fuera del cerrojo: fn puede retirar a su vez
+    for (std::function<void()>& fn : ready) {
+        fn();
+    }
+}
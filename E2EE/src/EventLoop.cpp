@@ -0,0 +1,304 @@
+#include "EventLoop.h"
+
+EventLoop::EventLoop() {
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (result != 0) {
+        throw std::runtime_error("WSAStartup failed: " + std::to_string(result));
+    }
+
+    // Socket UDP conectado a si mismo: Post() escribe un byte para despertar a WSAPoll
+    m_wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = 0;
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    socklen_t length = sizeof(address);
+    if (m_wakeSocket == INVALID_SOCKET
+        || bind(m_wakeSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR
+        || getsockname(m_wakeSocket, (sockaddr*)&address, &length) == SOCKET_ERROR
+        || connect(m_wakeSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR) {
+        int error = WSAGetLastError();
+        if (m_wakeSocket != INVALID_SOCKET) {
+            closesocket(m_wakeSocket);
+        }
+        WSACleanup();
+        throw std::runtime_error("Error creating event loop wakeup socket: " + std::to_string(error));
+    }
+    NetworkHelper::SetNonBlocking(m_wakeSocket, true);
+
+#ifdef __linux__
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeSocket;
+    if (m_epoll < 0 || epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeSocket, &event) < 0) {
+        int error = errno;
+        if (m_epoll >= 0) {
+            close(m_epoll);
+        }
+        closesocket(m_wakeSocket);
+        throw std::runtime_error("Error creating epoll instance: " + std::to_string(error));
+    }
+    m_events.resize(256);
+#else
+    m_pollSet.push_back(WSAPOLLFD{m_wakeSocket, POLLIN, 0});
+#endif
+}
+
+EventLoop::~EventLoop() {
+#ifdef __linux__
+    close(m_epoll);
+#endif
+    closesocket(m_wakeSocket);
+    // Las corrutinas que siguen suspendidas no se reanudan: sus dueños las destruyen
+    WSACleanup();
+}
+
+void
+EventLoop::Stop() {
+    Post([this] { m_stopping = true; });
+}
+
+void
+EventLoop::Post(std::function<void()> fn) {
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        wasEmpty = m_posted.empty();
+        m_posted.push_back(std::move(fn));
+    }
+    // Basta un byte por tanda: el bucle vacia la cola completa al despertar
+    if (wasEmpty) {
+        Wake();
+    }
+}
+
+void
+EventLoop::Wake() {
+    char byte = 1;
+    send(m_wakeSocket, &byte, 1, 0);
+}
+
+void
+EventLoop::DrainWakeups() {
+    char buffer[64];
+    while (recv(m_wakeSocket, buffer, sizeof(buffer), 0) > 0) {
+    }
+}
+
+void
+EventLoop::WaitReadable(SOCKET socket, std::coroutine_handle<> handle) {
+    AddWaiter(socket, false, handle);
+}
+
+void
+EventLoop::WaitWritable(SOCKET socket, std::coroutine_handle<> handle) {
+    AddWaiter(socket, true, handle);
+}
+
+void
+EventLoop::Cancel(SOCKET socket) {
+    auto it = m_watchIndex.find(socket);
+    if (it == m_watchIndex.end()) {
+        return;
+    }
+    size_t index = it->second;
+    Watch& watch = m_watches[index];
+    m_cancelled.insert(m_cancelled.end(), watch.readers.begin(), watch.readers.end());
+    m_cancelled.insert(m_cancelled.end(), watch.writers.begin(), watch.writers.end());
+    RemoveWatch(index);
+}
+
+void
+EventLoop::AddWaiter(SOCKET socket, bool write, std::coroutine_handle<> handle) {
+    auto [it, added] = m_watchIndex.try_emplace(socket, m_watches.size());
+    if (added) {
+        m_watches.push_back(Watch{socket, 0, {}, {}});
+#ifndef __linux__
+        m_pollSet.push_back(WSAPOLLFD{socket, 0, 0});
+#endif
+    }
+    Watch& watch = m_watches[it->second];
+    (write ? watch.writers : watch.readers).push_back(handle);
+    UpdateInterest(it->second, added);
+}
+
+void
+EventLoop::UpdateInterest(size_t index, bool added) {
+    Watch& watch = m_watches[index];
+    short events = static_cast<short>((watch.readers.empty() ? 0 : POLLIN)
+                                      | (watch.writers.empty() ? 0 : POLLOUT));
+    if (!added && events == watch.events) {
+        return;
+    }
+    watch.events = events;
+#ifdef __linux__
+    epoll_event event{};
+    event.events = (events & POLLIN ? EPOLLIN : 0) | (events & POLLOUT ? EPOLLOUT : 0);
+    event.data.fd = watch.socket;
+    if (epoll_ctl(m_epoll, added ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, watch.socket, &event) < 0) {
+        // Igual que POLLNVAL con WSAPoll: se reanudan y la operacion informa del error
+        m_cancelled.insert(m_cancelled.end(), watch.readers.begin(), watch.readers.end());
+        m_cancelled.insert(m_cancelled.end(), watch.writers.begin(), watch.writers.end());
+        RemoveWatch(index);
+    }
+#else
+    m_pollSet[index + 1].events = events;
+#endif
+}
+
+void
+EventLoop::TakeReady(size_t index, short revents, std::vector<std::coroutine_handle<>>& ready) {
+    Watch& watch = m_watches[index];
+    // Un error o cierre despierta a ambos lados
+    bool failed = (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+    if (failed || (revents & POLLIN)) {
+        ready.insert(ready.end(), watch.readers.begin(), watch.readers.end());
+        watch.readers.clear();
+    }
+    if (failed || (revents & POLLOUT)) {
+        ready.insert(ready.end(), watch.writers.begin(), watch.writers.end());
+        watch.writers.clear();
+    }
+    if (watch.readers.empty() && watch.writers.empty()) {
+        RemoveWatch(index);
+    } else {
+        UpdateInterest(index, false);
+    }
+}
+
+void
+EventLoop::RemoveWatch(size_t index) {
+    SOCKET socket = m_watches[index].socket;
+#ifdef __linux__
+    // Puede fallar si el socket ya se cerro; el kernel ya lo habra quitado
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, socket, nullptr);
+#endif
+    m_watchIndex.erase(socket);
+    size_t last = m_watches.size() - 1;
+    if (index != last) {
+        m_watches[index] = std::move(m_watches[last]);
+        m_watchIndex[m_watches[index].socket] = index;
+#ifndef __linux__
+        m_pollSet[index + 1] = m_pollSet[last + 1];
+#endif
+    }
+    m_watches.pop_back();
+#ifndef __linux__
+    m_pollSet.pop_back();
+#endif
+}
+
+void
+EventLoop::ResumeAt(Clock::time_point deadline, std::coroutine_handle<> handle) {
+    m_timers.Add(deadline, [handle] { handle.resume(); });
+}
+
+EventLoop::TimerId
+EventLoop::AddTimer(Clock::time_point deadline, std::function<void()> fn) {
+    return m_timers.Add(deadline, std::move(fn));
+}
+
+bool
+EventLoop::CancelTimer(TimerId id) {
+    return m_timers.Cancel(id);
+}
+
+int
+EventLoop::PollTimeoutMs() const {
+    if (!m_cancelled.empty()) {
+        return 0;
+    }
+    Clock::time_point wakeup = m_timers.NextWakeup();
+    if (wakeup == Clock::time_point::max()) {
+        return -1;
+    }
+    Clock::time_point now = Clock::now();
+    if (wakeup <= now) {
+        return 0;
+    }
+    auto remaining = wakeup - now;
+    // Redondeo hacia arriba para no despertar antes de tiempo
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+    return ms > INT32_MAX ? INT32_MAX : static_cast<int>(ms);
+}
+
+void
+EventLoop::Run() {
+    std::vector<std::function<void()>> posted;
+    std::vector<std::coroutine_handle<>> ready;
+    std::function<void()> expired;
+    m_stopping = false;
+
+    while (!m_stopping) {
+        // Se separan los listos antes de reanudar: una corrutina reanudada
+        // puede registrar nuevas esperas y modificar m_watches
+#ifdef __linux__
+        int count = epoll_wait(m_epoll, m_events.data(), static_cast<int>(m_events.size()), PollTimeoutMs());
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait failed: " << errno << std::endl;
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            const epoll_event& event = m_events[i];
+            if (event.data.fd == m_wakeSocket) {
+                DrainWakeups();
+                continue;
+            }
+            auto it = m_watchIndex.find(event.data.fd);
+            if (it == m_watchIndex.end()) {
+                continue;
+            }
+            short revents = static_cast<short>((event.events & EPOLLIN ? POLLIN : 0)
+                                               | (event.events & EPOLLOUT ? POLLOUT : 0)
+                                               | (event.events & EPOLLERR ? POLLERR : 0)
+                                               | (event.events & EPOLLHUP ? POLLHUP : 0));
+            TakeReady(it->second, revents, ready);
+        }
+#else
+        int count = WSAPoll(m_pollSet.data(), static_cast<ULONG>(m_pollSet.size()), PollTimeoutMs());
+        if (count == SOCKET_ERROR) {
+            std::cerr << "WSAPoll failed: " << WSAGetLastError() << std::endl;
+            return;
+        }
+
+        if (m_pollSet[0].revents) {
+            DrainWakeups();
+        }
+
+        // De atras hacia delante: RemoveWatch mueve el ultimo, ya revisado, al hueco
+        for (size_t i = m_watches.size(); i > 0; --i) {
+            short revents = m_pollSet[i].revents;
+            if (revents) {
+                TakeReady(i - 1, revents, ready);
+            }
+        }
+#endif
+
+        ready.insert(ready.end(), m_cancelled.begin(), m_cancelled.end());
+        m_cancelled.clear();
+        for (std::coroutine_handle<> handle : ready) {
+            handle.resume();
+        }
+        ready.clear();
+
+        // De uno en uno: un temporizador puede cancelar otro vencido a la vez
+        m_timers.Advance(Clock::now());
+        while (m_timers.PopExpired(expired)) {
+            expired();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_postMutex);
+            posted.swap(m_posted);
+        }
+        for (auto& fn : posted) {
+            fn();
+        }
+        posted.clear();
+    }
+}
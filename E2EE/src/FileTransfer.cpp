@@ -0,0 +1,596 @@
+#include "FileTransfer.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <exception>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// [tipo u8][id u64][offset u64]
+constexpr size_t FILE_AAD_SIZE = 17;
+
+// Estado de reanudacion: [magic][id u64][tamano u64][tamano de bloque u32][mapa]
+constexpr char STATE_MAGIC[8] = {'E', '2', 'E', 'E', 'R', 'S', 'M', '1'};
+constexpr size_t STATE_HEADER_SIZE = 28;
+
+void
+WriteStateHeader(unsigned char* out, const FileInfo& info) {
+    std::memcpy(out, STATE_MAGIC, sizeof(STATE_MAGIC));
+    WriteU64(out + 8, info.transferId);
+    WriteU64(out + 16, info.size);
+    WriteU32(out + 24, info.chunkSize);
+}
+
+// Reparte los indices [0, count) entre los nucleos; la primera excepcion de
+// un hilo se relanza al terminar todos
+template <typename Work>
+void
+ParallelFor(uint64_t count, Work work) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t threads = std::min<uint64_t>(cores, count);
+    std::atomic<uint64_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto run = [&] {
+        try {
+            for (uint64_t index; (index = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+                work(index);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            next.store(count, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (uint64_t i = 1; i < threads; ++i) {
+        workers.emplace_back(run);
+    }
+    run();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// HMAC-SHA256 de [FileInfo][raiz] con una clave derivada de la de sesion
+void
+ManifestMac(const CryptoHelper& crypto, const FileInfo& info, const MerkleHash& root, unsigned char* out) {
+    unsigned char key[32];
+    crypto.DeriveKeyMaterial("e2ee file manifest", key, sizeof(key));
+    unsigned char message[FileInfo::ENCODED_SIZE + MERKLE_HASH_SIZE];
+    info.Encode(message);
+    std::memcpy(message + FileInfo::ENCODED_SIZE, root.data(), root.size());
+    unsigned int length = 0;
+    bool computed = HMAC(EVP_sha256(), key, sizeof(key), message, sizeof(message), out, &length) != nullptr
+                   && length == MERKLE_HASH_SIZE;
+    OPENSSL_cleanse(key, sizeof(key));
+    if (!computed) {
+        throw std::runtime_error("HMAC failed.");
+    }
+}
+
+void
+BuildAad(unsigned char* aad, FrameType type, uint64_t transferId, const unsigned char* offset) {
+    aad[0] = static_cast<unsigned char>(type);
+    WriteU64(aad + 1, transferId);
+    std::memcpy(aad + 9, offset, FILE_RECORD_HEADER_SIZE);
+}
+
+}
+
+#ifndef _WIN32
+bool
+WriteAt(int descriptor, const unsigned char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(descriptor, data, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+#endif
+
+uint64_t
+FileFingerprint(int descriptor, uint32_t salt) {
+#ifndef _WIN32
+    struct stat info;
+    if (fstat(descriptor, &info) != 0) {
+        return 0;
+    }
+    unsigned char fields[48];
+    WriteU64(fields, static_cast<uint64_t>(info.st_dev));
+    WriteU64(fields + 8, static_cast<uint64_t>(info.st_ino));
+    WriteU64(fields + 16, static_cast<uint64_t>(info.st_size));
+    WriteU64(fields + 24, static_cast<uint64_t>(info.st_mtim.tv_sec));
+    WriteU64(fields + 32, static_cast<uint64_t>(info.st_mtim.tv_nsec));
+    WriteU64(fields + 40, salt);
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_Digest(fields, sizeof(fields), digest, &length, EVP_sha256(), nullptr);
+    return ReadU64(digest);
+#else
+    (void)descriptor;
+    (void)salt;
+    return 0;
+#endif
+}
+
+uint64_t
+FileInfo::ChunkCount() const {
+    return (size + chunkSize - 1) / chunkSize;
+}
+
+void
+FileInfo::Encode(unsigned char* out) const {
+    WriteU64(out, transferId);
+    WriteU64(out + 8, size);
+    WriteU32(out + 16, chunkSize);
+    out[20] = static_cast<unsigned char>(streams >> 8);
+    out[21] = static_cast<unsigned char>(streams);
+}
+
+bool
+FileInfo::Decode(const unsigned char* in, size_t length) {
+    if (length != ENCODED_SIZE) {
+        return false;
+    }
+    transferId = ReadU64(in);
+    size = ReadU64(in + 8);
+    chunkSize = ReadU32(in + 16);
+    streams = static_cast<uint16_t>((in[20] << 8) | in[21]);
+    return chunkSize > 0 && chunkSize <= MAX_FRAME_SIZE - FILE_RECORD_OVERHEAD && streams > 0
+           && streams <= MAX_FILE_STREAMS;
+}
+
+std::vector<unsigned char>
+EncodeFileManifest(const CryptoHelper& crypto, const FileInfo& info, const MerkleTree& tree) {
+    const std::vector<MerkleHash>& leaves = tree.Leaves();
+    std::vector<unsigned char> out(2 * MERKLE_HASH_SIZE + leaves.size() * MERKLE_HASH_SIZE);
+    std::memcpy(out.data(), tree.Root().data(), MERKLE_HASH_SIZE);
+    ManifestMac(crypto, info, tree.Root(), out.data() + MERKLE_HASH_SIZE);
+    unsigned char* leaf = out.data() + 2 * MERKLE_HASH_SIZE;
+    for (const MerkleHash& hash : leaves) {
+        std::memcpy(leaf, hash.data(), MERKLE_HASH_SIZE);
+        leaf += MERKLE_HASH_SIZE;
+    }
+    return out;
+}
+
+bool
+DecodeFileManifest(const CryptoHelper& crypto, const FileInfo& info, const unsigned char* in, size_t size,
+                   MerkleTree& tree) {
+    if (size != 2 * MERKLE_HASH_SIZE + info.ChunkCount() * MERKLE_HASH_SIZE) {
+        return false;
+    }
+    MerkleHash root;
+    std::memcpy(root.data(), in, MERKLE_HASH_SIZE);
+    unsigned char mac[MERKLE_HASH_SIZE];
+    ManifestMac(crypto, info, root, mac);
+    if (CRYPTO_memcmp(mac, in + MERKLE_HASH_SIZE, sizeof(mac)) != 0) {
+        return false;
+    }
+    std::vector<MerkleHash> leaves(info.ChunkCount());
+    const unsigned char* leaf = in + 2 * MERKLE_HASH_SIZE;
+    for (MerkleHash& hash : leaves) {
+        std::memcpy(hash.data(), leaf, MERKLE_HASH_SIZE);
+        leaf += MERKLE_HASH_SIZE;
+    }
+    tree = MerkleTree(std::move(leaves));
+    return CRYPTO_memcmp(tree.Root().data(), root.data(), MERKLE_HASH_SIZE) == 0;
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    if (m_descriptor >= 0) {
+        ::close(m_descriptor);
+    }
+#endif
+}
+
+bool
+MappedFile::Open(const std::string& path) {
+#ifndef _WIN32
+    m_descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (m_descriptor < 0 || fstat(m_descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    m_size = static_cast<uint64_t>(info.st_size);
+    if (m_size == 0) {
+        return true; // mmap de cero bytes no es valido
+    }
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_descriptor, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "Error mapping file: " << path << std::endl;
+        return false;
+    }
+    m_data = static_cast<unsigned char*>(data);
+    // Se lee una vez de principio a fin: lectura anticipada agresiva
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+    return true;
+#else
+    std::cerr << "File transfer is not supported on this platform" << std::endl;
+    return false;
+#endif
+}
+
+const unsigned char*
+MappedFile::Data() const {
+    return m_data;
+}
+
+uint64_t
+MappedFile::Size() const {
+    return m_size;
+}
+
+int
+MappedFile::Descriptor() const {
+    return m_descriptor;
+}
+
+void
+MappedFile::Release(uint64_t offset, size_t size) {
+#ifndef _WIN32
+    if (!m_data || offset >= m_size) {
+        return;
+    }
+    uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t begin = offset / page * page;
+    uint64_t end = std::min<uint64_t>(offset + size, m_size);
+    madvise(m_data + begin, end - begin, MADV_DONTNEED);
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
+
+void
+SealFileRecord(CryptoHelper& crypto, FrameType type, uint64_t transferId, uint64_t offset,
+               const unsigned char* data, size_t size, unsigned char* out) {
+    WriteU64(out, offset);
+    unsigned char* nonce = out + FILE_RECORD_HEADER_SIZE;
+    if (RAND_bytes(nonce, CryptoHelper::AEAD_NONCE_SIZE) != 1) {
+        throw std::runtime_error("Failed to generate nonce.");
+    }
+    unsigned char aad[FILE_AAD_SIZE];
+    BuildAad(aad, type, transferId, out);
+    unsigned char* ciphertext = nonce + CryptoHelper::AEAD_NONCE_SIZE;
+    crypto.AEADEncrypt(nonce, aad, sizeof(aad), data, size, ciphertext, ciphertext + size);
+}
+
+bool
+OpenFileRecord(CryptoHelper& crypto, FrameType type, uint64_t transferId, unsigned char* record, size_t size,
+               uint64_t& offset, unsigned char*& data, size_t& length) {
+    if (size < FILE_RECORD_OVERHEAD) {
+        return false;
+    }
+    offset = ReadU64(record);
+    unsigned char aad[FILE_AAD_SIZE];
+    BuildAad(aad, type, transferId, record);
+    const unsigned char* nonce = record + FILE_RECORD_HEADER_SIZE;
+    data = record + FILE_RECORD_HEADER_SIZE + CryptoHelper::AEAD_NONCE_SIZE;
+    length = size - FILE_RECORD_OVERHEAD;
+    return crypto.AEADDecrypt(nonce, aad, sizeof(aad), data, length, data + length, data);
+}
+
+bool
+FileSource::Open(const std::string& path, size_t chunkSize, int streams) {
+    if (!m_file.Open(path)) {
+        return false;
+    }
+    m_info.size = m_file.Size();
+    m_info.chunkSize = static_cast<uint32_t>(chunkSize);
+    m_info.streams = static_cast<uint16_t>(streams);
+    m_info.transferId = FileFingerprint(m_file.Descriptor(), m_info.chunkSize);
+    m_held.assign((m_info.ChunkCount() + 7) / 8, 0);
+    std::vector<MerkleHash> leaves(m_info.ChunkCount());
+    try {
+        ParallelFor(leaves.size(), [this, &leaves](uint64_t index) {
+            uint64_t offset = index * m_info.chunkSize;
+            size_t size = static_cast<size_t>(std::min<uint64_t>(m_info.chunkSize, m_info.size - offset));
+            leaves[index] = MerkleLeaf(m_file.Data() + offset, size);
+            m_file.Release(offset, size);
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error hashing file: " << e.what() << std::endl;
+        return false;
+    }
+    m_manifest = MerkleTree(std::move(leaves));
+    return true;
+}
+
+const FileInfo&
+FileSource::Info() const {
+    return m_info;
+}
+
+const MerkleTree&
+FileSource::Manifest() const {
+    return m_manifest;
+}
+
+MappedFile&
+FileSource::File() {
+    return m_file;
+}
+
+bool
+FileSource::SkipHeld(const unsigned char* bitmap, size_t size) {
+    if (size != m_held.size()) {
+        return false;
+    }
+    if (size) {
+        std::memcpy(m_held.data(), bitmap, size);
+    }
+    return true;
+}
+
+bool
+FileSource::Next(uint64_t& offset, size_t& size) {
+    uint64_t count = m_info.ChunkCount();
+    for (;;) {
+        uint64_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= count) {
+            return false;
+        }
+        if (m_held[index / 8] & (1 << (index % 8))) {
+            continue;
+        }
+        offset = index * m_info.chunkSize;
+        size = static_cast<size_t>(std::min<uint64_t>(m_info.chunkSize, m_info.size - offset));
+        return true;
+    }
+}
+
+FileSink::~FileSink() {
+#ifndef _WIN32
+    if (m_descriptor >= 0) {
+        ::close(m_descriptor);
+    }
+    if (m_stateDescriptor >= 0) {
+        ::close(m_stateDescriptor);
+    }
+#endif
+}
+
+bool
+FileSink::Open(const std::string& path, const FileInfo& info) {
+#ifndef _WIN32
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_info = info;
+    m_statePath = path + ".resume";
+    unsigned char header[STATE_HEADER_SIZE];
+    WriteStateHeader(header, info);
+    m_bitmap.assign((info.ChunkCount() + 7) / 8, 0);
+
+    // Se retoma solo si el estado guardado es de este mismo archivo
+    m_stateDescriptor = ::open(m_statePath.c_str(), O_RDWR | O_CLOEXEC);
+    if (m_stateDescriptor >= 0) {
+        std::vector<unsigned char> stored(STATE_HEADER_SIZE + m_bitmap.size());
+        bool matches = pread(m_stateDescriptor, stored.data(), stored.size(), 0) == static_cast<ssize_t>(stored.size())
+                       && std::memcmp(stored.data(), header, STATE_HEADER_SIZE) == 0;
+        if (matches) {
+            m_descriptor = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        }
+        if (m_descriptor >= 0) {
+            std::copy(stored.begin() + STATE_HEADER_SIZE, stored.end(), m_bitmap.begin());
+        } else {
+            ::close(m_stateDescriptor);
+            m_stateDescriptor = -1;
+        }
+    }
+    if (m_stateDescriptor < 0) {
+        m_stateDescriptor = ::open(m_statePath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        m_descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        std::vector<unsigned char> state(header, header + STATE_HEADER_SIZE);
+        state.resize(STATE_HEADER_SIZE + m_bitmap.size());
+        if (m_stateDescriptor < 0 || m_descriptor < 0 || !WriteAt(m_stateDescriptor, state.data(), state.size(), 0)) {
+            std::cerr << "Error creating file: " << path << std::endl;
+            return false;
+        }
+    }
+    // Tamano final desde el principio: cada bloque va a su sitio
+    if (ftruncate(m_descriptor, static_cast<off_t>(info.size)) != 0) {
+        std::cerr << "Error creating file: " << path << std::endl;
+        return false;
+    }
+    uint64_t held = 0;
+    for (unsigned char byte : m_bitmap) {
+        held += std::popcount(byte);
+    }
+    m_missing = info.ChunkCount() - held;
+    return true;
+#else
+    (void)path;
+    (void)info;
+    std::cerr << "File transfer is not supported on this platform" << std::endl;
+    return false;
+#endif
+}
+
+bool
+FileSink::IsOpen() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_descriptor >= 0;
+}
+
+const FileInfo&
+FileSink::Info() const {
+    return m_info;
+}
+
+bool
+FileSink::SetManifest(MerkleTree manifest) {
+#ifndef _WIN32
+    m_manifest = std::move(manifest);
+    std::vector<uint64_t> held;
+    for (uint64_t index = 0; index < m_info.ChunkCount(); ++index) {
+        if (m_bitmap[index / 8] & (1 << (index % 8))) {
+            held.push_back(index);
+        }
+    }
+    if (held.empty()) {
+        return true;
+    }
+    // Lo escrito antes del corte pudo danarse o quedar a medias en disco
+    std::vector<char> corrupt(held.size(), 0);
+    try {
+        ParallelFor(held.size(), [this, &held, &corrupt](uint64_t i) {
+            uint64_t offset = held[i] * m_info.chunkSize;
+            size_t size = static_cast<size_t>(std::min<uint64_t>(m_info.chunkSize, m_info.size - offset));
+            std::vector<unsigned char> chunk(size);
+            corrupt[i] = pread(m_descriptor, chunk.data(), size, static_cast<off_t>(offset))
+                             != static_cast<ssize_t>(size)
+                         || !Matches(offset, chunk.data(), size);
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error verifying file: " << e.what() << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < held.size(); ++i) {
+        if (corrupt[i]) {
+            m_bitmap[held[i] / 8] &= static_cast<unsigned char>(~(1 << (held[i] % 8)));
+            ++dropped;
+        }
+    }
+    if (dropped == 0) {
+        return true;
+    }
+    std::cerr << "Discarding " << dropped << " stored chunks that do not match the manifest" << std::endl;
+    m_missing += dropped;
+    return WriteAt(m_stateDescriptor, m_bitmap.data(), m_bitmap.size(), STATE_HEADER_SIZE);
+#else
+    m_manifest = std::move(manifest);
+    return false;
+#endif
+}
+
+const MerkleTree&
+FileSink::Manifest() const {
+    return m_manifest;
+}
+
+bool
+FileSink::Matches(uint64_t offset, const unsigned char* data, size_t size) const {
+    if (offset % m_info.chunkSize != 0 || offset / m_info.chunkSize >= m_manifest.Leaves().size()) {
+        return false;
+    }
+    try {
+        MerkleHash leaf = MerkleLeaf(data, size);
+        return CRYPTO_memcmp(leaf.data(), m_manifest.Leaves()[offset / m_info.chunkSize].data(), leaf.size()) == 0;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+std::vector<unsigned char>
+FileSink::Bitmap() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bitmap;
+}
+
+bool
+FileSink::Write(uint64_t offset, const unsigned char* data, size_t size) {
+#ifndef _WIN32
+    if (offset % m_info.chunkSize != 0 || offset >= m_info.size
+        || size != std::min<uint64_t>(m_info.chunkSize, m_info.size - offset)) {
+        return false;
+    }
+    // pwrite no necesita el mutex: cada bloque va a su propio rango
+    if (!WriteAt(m_descriptor, data, size, offset)) {
+        return false;
+    }
+    uint64_t index = offset / m_info.chunkSize;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unsigned char& byte = m_bitmap[index / 8];
+    unsigned char mask = static_cast<unsigned char>(1 << (index % 8));
+    if (byte & mask) {
+        return true;
+    }
+    byte |= mask;
+    // El bit se guarda despues de los datos: un corte nunca marca un bloque sin escribir
+    if (!WriteAt(m_stateDescriptor, &byte, 1, STATE_HEADER_SIZE + index / 8)) {
+        return false;
+    }
+    if (--m_missing == 0) {
+        m_changed.notify_all();
+    }
+    return true;
+#else
+    (void)offset;
+    (void)data;
+    (void)size;
+    return false;
+#endif
+}
+
+void
+FileSink::AddStream() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_streams;
+}
+
+void
+FileSink::EndStream() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_streams;
+    m_changed.notify_all();
+}
+
+bool
+FileSink::WaitComplete() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] { return m_missing == 0 || m_streams == 0; });
+    return m_missing == 0;
+}
+
+bool
+FileSink::Finish() {
+#ifndef _WIN32
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool complete = m_descriptor >= 0 && m_missing == 0;
+    if (m_descriptor >= 0) {
+        complete = ::close(m_descriptor) == 0 && complete;
+        m_descriptor = -1;
+    }
+    if (m_stateDescriptor >= 0) {
+        ::close(m_stateDescriptor);
+        m_stateDescriptor = -1;
+    }
+    if (complete) {
+        ::unlink(m_statePath.c_str());
+    }
+    return complete;
+#else
+    return false;
+#endif
+}
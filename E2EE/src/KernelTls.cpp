@@ -0,0 +1,63 @@
+#include "KernelTls.h"
+#include "Metrics.h"
+#include <cstring>
+#ifdef __linux__
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#endif
+
+namespace {
+#ifdef __linux__
+// direction: TLS_TX o TLS_RX; label identifica al lado que envia
+bool
+SetDirection(SOCKET socket, const CryptoHelper& crypto, int direction, const char* label) {
+    tls12_crypto_info_aes_gcm_256 info = {};
+    info.info.version = TLS_1_3_VERSION;
+    info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+    // rec_seq queda a cero: los dos lados empiezan a contar en la activacion
+    unsigned char material[sizeof(info.key) + sizeof(info.salt) + sizeof(info.iv)];
+    crypto.DeriveKeyMaterial(label, material, sizeof(material));
+    std::memcpy(info.key, material, sizeof(info.key));
+    std::memcpy(info.salt, material + sizeof(info.key), sizeof(info.salt));
+    std::memcpy(info.iv, material + sizeof(info.key) + sizeof(info.salt), sizeof(info.iv));
+    int result = setsockopt(socket, SOL_TLS, direction, &info, sizeof(info));
+    OPENSSL_cleanse(material, sizeof(material));
+    OPENSSL_cleanse(&info, sizeof(info));
+    return result == 0;
+}
+#endif
+}
+
+bool
+AttachKernelTls(SOCKET socket) {
+#ifdef __linux__
+    return setsockopt(socket, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+bool
+EnableKernelTls(SOCKET socket, const CryptoHelper& crypto, HandshakeRole role) {
+#ifdef __linux__
+    const char* own = role == HandshakeRole::Client ? "e2ee ktls client" : "e2ee ktls server";
+    const char* peer = role == HandshakeRole::Client ? "e2ee ktls server" : "e2ee ktls client";
+    try {
+        if (!SetDirection(socket, crypto, TLS_TX, own) || !SetDirection(socket, crypto, TLS_RX, peer)) {
+            std::cerr << "Error enabling kernel TLS: " << WSAGetLastError() << std::endl;
+            return false;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error enabling kernel TLS: " << e.what() << std::endl;
+        return false;
+    }
+    Metrics::Add(MetricCounter::KernelTlsSessions);
+    return true;
+#else
+    (void)socket;
+    (void)crypto;
+    (void)role;
+    return false;
+#endif
+}
@@ -0,0 +1,64 @@
+#include "Merkle.h"
+#include <openssl/evp.h>
+
+namespace {
+constexpr unsigned char LEAF_PREFIX = 0x00;
+constexpr unsigned char NODE_PREFIX = 0x01;
+
+MerkleHash
+Digest(unsigned char prefix, const unsigned char* first, size_t firstSize, const unsigned char* second,
+       size_t secondSize) {
+    MerkleHash hash{};
+    EVP_MD_CTX* context = EVP_MD_CTX_new();
+    bool hashed = context && EVP_DigestInit_ex(context, EVP_sha256(), nullptr) == 1
+                  && EVP_DigestUpdate(context, &prefix, 1) == 1
+                  && EVP_DigestUpdate(context, first, firstSize) == 1
+                  && EVP_DigestUpdate(context, second, secondSize) == 1
+                  && EVP_DigestFinal_ex(context, hash.data(), nullptr) == 1;
+    EVP_MD_CTX_free(context);
+    if (!hashed) {
+        throw std::runtime_error("SHA-256 failed.");
+    }
+    return hash;
+}
+}
+
+MerkleHash
+MerkleLeaf(const unsigned char* data, size_t size) {
+    return Digest(LEAF_PREFIX, data, size, nullptr, 0);
+}
+
+MerkleHash
+MerkleNode(const MerkleHash& left, const MerkleHash& right) {
+    return Digest(NODE_PREFIX, left.data(), left.size(), right.data(), right.size());
+}
+
+MerkleTree::MerkleTree() : MerkleTree(std::vector<MerkleHash>()) {}
+
+MerkleTree::MerkleTree(std::vector<MerkleHash> leaves) : m_leaves(std::move(leaves)) {
+    if (m_leaves.empty()) {
+        EVP_Digest(nullptr, 0, m_root.data(), nullptr, EVP_sha256(), nullptr);
+        return;
+    }
+    // Solo hace falta la raiz: cada nivel sustituye al anterior
+    std::vector<MerkleHash> level = m_leaves;
+    while (level.size() > 1) {
+        std::vector<MerkleHash> parent;
+        parent.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i < level.size(); i += 2) {
+            parent.push_back(i + 1 < level.size() ? MerkleNode(level[i], level[i + 1]) : level[i]);
+        }
+        level = std::move(parent);
+    }
+    m_root = level[0];
+}
+
+const MerkleHash&
+MerkleTree::Root() const {
+    return m_root;
+}
+
+const std::vector<MerkleHash>&
+MerkleTree::Leaves() const {
+    return m_leaves;
+}
@@ -0,0 +1,229 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace {
+// Bloque de un hilo: un solo escritor, por eso basta load + store relajados
+struct ThreadBlock {
+    struct Histogram {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+        std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKET_COUNT> buckets{};
+    };
+
+    std::atomic<bool> owned{true};
+    std::array<std::atomic<uint64_t>, METRIC_COUNTER_COUNT> counters{};
+    std::array<Histogram, METRIC_STAGE_COUNT> stages;
+};
+
+void
+Increment(std::atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+class
+    Registry {
+public:
+    static Registry&
+    Instance() {
+        // Nunca se destruye: los hilos pueden registrar metricas durante la salida
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    ThreadBlock*
+    Acquire() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const std::unique_ptr<ThreadBlock>& block : m_blocks) {
+            if (!block->owned.load(std::memory_order_relaxed)) {
+                block->owned.store(true, std::memory_order_relaxed);
+                return block.get();
+            }
+        }
+        m_blocks.push_back(std::make_unique<ThreadBlock>());
+        return m_blocks.back().get();
+    }
+
+    void
+    Release(ThreadBlock* block) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        block->owned.store(false, std::memory_order_relaxed);
+    }
+
+    MetricsSnapshot
+    Merge() {
+        MetricsSnapshot snapshot;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const std::unique_ptr<ThreadBlock>& block : m_blocks) {
+            for (size_t i = 0; i < METRIC_COUNTER_COUNT; ++i) {
+                snapshot.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < METRIC_STAGE_COUNT; ++i) {
+                const ThreadBlock::Histogram& source = block->stages[i];
+                HistogramSnapshot& target = snapshot.stages[i];
+                target.count += source.count.load(std::memory_order_relaxed);
+                target.sum += source.sum.load(std::memory_order_relaxed);
+                target.max = std::max(target.max, source.max.load(std::memory_order_relaxed));
+                for (size_t b = 0; b < HistogramSnapshot::BUCKET_COUNT; ++b) {
+                    target.buckets[b] += source.buckets[b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        return snapshot;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadBlock>> m_blocks;
+};
+
+// Devuelve el bloque al registro cuando el hilo termina
+struct ThreadBlockOwner {
+    ThreadBlock* block = Registry::Instance().Acquire();
+
+    ~ThreadBlockOwner() {
+        Registry::Instance().Release(block);
+    }
+};
+
+ThreadBlock&
+LocalBlock() {
+    thread_local ThreadBlockOwner owner;
+    return *owner.block;
+}
+
+int
+HighestBit(uint64_t value) {
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+const char* const STAGE_NAMES[METRIC_STAGE_COUNT] = {
+    "send", "receive", "encrypt", "decrypt", "key_generation", "key_load", "key_wrap", "key_unwrap", "handshake"};
+
+const char* const COUNTER_NAMES[METRIC_COUNTER_COUNT] = {
+    "bytes_sent", "bytes_received", "messages_sent", "messages_received", "send_errors", "receive_errors",
+    "bytes_encrypted", "bytes_decrypted", "crypto_errors", "handshakes", "handshake_errors",
+    "datagrams_dropped", "bytes_zero_copied", "kernel_tls_sessions",
+    "bytes_deduplicated", "bytes_saved_by_compression", "messages_coalesced",
+    "connections_timed_out"};
+}
+
+size_t
+HistogramSnapshot::BucketFor(uint64_t value) {
+    constexpr uint64_t subBuckets = uint64_t(1) << SUB_BUCKET_BITS;
+    if (value < subBuckets) {
+        return static_cast<size_t>(value);
+    }
+    int highest = HighestBit(value);
+    if (highest >= MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    // Los SUB_BUCKET_BITS bits bajo el bit mas alto eligen la sub-cubeta
+    int shift = highest - SUB_BUCKET_BITS;
+    uint64_t top = value >> shift; // en [16, 32)
+    return static_cast<size_t>((shift + 1) << SUB_BUCKET_BITS) + static_cast<size_t>(top - subBuckets);
+}
+
+uint64_t
+HistogramSnapshot::BucketUpperBound(size_t bucket) {
+    constexpr uint64_t subBuckets = uint64_t(1) << SUB_BUCKET_BITS;
+    if (bucket < subBuckets) {
+        return bucket;
+    }
+    int shift = static_cast<int>(bucket >> SUB_BUCKET_BITS) - 1;
+    uint64_t top = subBuckets + (bucket & (subBuckets - 1));
+    return ((top + 1) << shift) - 1;
+}
+
+uint64_t
+HistogramSnapshot::Percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * count + 0.5);
+    rank = std::min<uint64_t>(std::max<uint64_t>(rank, 1), count);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return std::min(BucketUpperBound(bucket), max);
+        }
+    }
+    return max;
+}
+
+double
+HistogramSnapshot::Mean() const {
+    return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+void
+Metrics::Record(MetricStage stage, uint64_t nanoseconds) {
+    ThreadBlock::Histogram& histogram = LocalBlock().stages[static_cast<size_t>(stage)];
+    Increment(histogram.buckets[HistogramSnapshot::BucketFor(nanoseconds)], 1);
+    Increment(histogram.count, 1);
+    Increment(histogram.sum, nanoseconds);
+    if (nanoseconds > histogram.max.load(std::memory_order_relaxed)) {
+        histogram.max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void
+Metrics::Add(MetricCounter counter, uint64_t value) {
+    Increment(LocalBlock().counters[static_cast<size_t>(counter)], value);
+}
+
+MetricsSnapshot
+Metrics::Snapshot() {
+    return Registry::Instance().Merge();
+}
+
+void
+Metrics::WriteExposition(std::ostream& out) {
+    MetricsSnapshot snapshot = Snapshot();
+
+    for (size_t i = 0; i < METRIC_COUNTER_COUNT; ++i) {
+        out << "# TYPE e2ee_" << COUNTER_NAMES[i] << "_total counter\n"
+            << "e2ee_" << COUNTER_NAMES[i] << "_total " << snapshot.counters[i] << "\n";
+    }
+
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    out << "# TYPE e2ee_stage_latency_ns summary\n";
+    for (size_t i = 0; i < METRIC_STAGE_COUNT; ++i) {
+        const HistogramSnapshot& histogram = snapshot.stages[i];
+        for (double quantile : quantiles) {
+            out << "e2ee_stage_latency_ns{stage=\"" << STAGE_NAMES[i] << "\",quantile=\"" << quantile << "\"} "
+                << histogram.Percentile(quantile) << "\n";
+        }
+        out << "e2ee_stage_latency_ns_sum{stage=\"" << STAGE_NAMES[i] << "\"} " << histogram.sum << "\n"
+            << "e2ee_stage_latency_ns_count{stage=\"" << STAGE_NAMES[i] << "\"} " << histogram.count << "\n";
+    }
+    out << "# TYPE e2ee_stage_latency_ns_max gauge\n";
+    for (size_t i = 0; i < METRIC_STAGE_COUNT; ++i) {
+        out << "e2ee_stage_latency_ns_max{stage=\"" << STAGE_NAMES[i] << "\"} " << snapshot.stages[i].max << "\n";
+    }
+}
+
+std::string
+Metrics::Exposition() {
+    std::ostringstream out;
+    WriteExposition(out);
+    return out.str();
+}
+
+const char*
+Metrics::Name(MetricStage stage) {
+    return STAGE_NAMES[static_cast<size_t>(stage)];
+}
+
+const char*
+Metrics::Name(MetricCounter counter) {
+    return COUNTER_NAMES[static_cast<size_t>(counter)];
+}
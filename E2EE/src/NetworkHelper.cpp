@@ -1,4 +1,20 @@
 #include "NetworkHelper.h"
+#include "Compression.h"
+#include "Dedup.h"
+#include "KernelTls.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
+#endif
 
 NetworkHelper::NetworkHelper() :
     m_serverSocket(INVALID_SOCKET), m_initialized(false) {
@@ -13,7 +29,16 @@ NetworkHelper::NetworkHelper() :
 
 NetworkHelper::~NetworkHelper() {
     if (m_serverSocket != INVALID_SOCKET) {
-        closesocket(m_serverSocket);
+        close(m_serverSocket);
+    }
+    if (m_datagramSocket != INVALID_SOCKET) {
+        closesocket(m_datagramSocket);
+    }
+    if (!m_unixPath.empty()) {
+        ::remove(m_unixPath.c_str());
+    }
+    if (!m_inprocName.empty()) {
+        UnregisterInProc(m_inprocName);
     }
 
     if (m_initialized) {
@@ -23,26 +48,56 @@ NetworkHelper::~NetworkHelper() {
 
 bool
 NetworkHelper::StartSever(int port) {
-    // Crea el socket TCP
-    m_serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    Endpoint endpoint;
+    endpoint.port = port;
+    return Listen(endpoint);
+}
+
+bool
+NetworkHelper::StartSever(const std::string& address) {
+    Endpoint endpoint;
+    return ParseEndpoint(address, endpoint) && Listen(endpoint);
+}
+
+bool
+NetworkHelper::Listen(const Endpoint& endpoint) {
+    SocketAddress address;
+    if (!ResolveEndpoint(endpoint, true, address)) {
+        return false;
+    }
+
+    // Crea el socket (TCP, o AF_UNIX de flujo o de registros)
+    m_serverSocket = socket(address.family, address.type, address.protocol);
     if (m_serverSocket == INVALID_SOCKET) {
         std::cerr << "Error creating socket: " << WSAGetLastError() << std::endl;
         return false;
     }
 
-    // Configura la dirección del servidor (IPv4, cualquier IP local, puerto dado)
-    sockaddr_in serverAddress{};
-    serverAddress.sin_family = AF_INET;
-    serverAddress.sin_port = htons(port);
-    serverAddress.sin_addr.s_addr = INADDR_ANY;
+#ifndef _WIN32
+    if (address.family == AF_INET) {
+        // Permite reiniciar el servidor aunque queden conexiones en TIME_WAIT
+        int reuse = 1;
+        setsockopt(m_serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    } else if (endpoint.transport != Transport::InProc) {
+        // Un socket Unix de una ejecucion anterior impide el bind; solo se
+        // borra si de verdad es un socket
+        struct stat info;
+        if (lstat(endpoint.path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+            ::unlink(endpoint.path.c_str());
+        }
+    }
+#endif
 
-    // Asocia el socket con la dirección y puerto
-    if (bind(m_serverSocket, (sockaddr*)&serverAddress, sizeof(serverAddress)) == SOCKET_ERROR) {
+    // Asocia el socket con la dirección
+    if (bind(m_serverSocket, reinterpret_cast<const sockaddr*>(&address.storage), address.length) == SOCKET_ERROR) {
         std::cerr << "Bind failed: " << WSAGetLastError() << std::endl;
         closesocket(m_serverSocket);
         m_serverSocket = INVALID_SOCKET;
         return false;
     }
+    if (address.family == AF_UNIX && endpoint.transport != Transport::InProc) {
+        m_unixPath = endpoint.path;
+    }
 
     // Escucha conexiones entrantes
     if (listen(m_serverSocket, SOMAXCONN) == SOCKET_ERROR) {
@@ -52,16 +107,40 @@ NetworkHelper::StartSever(int port) {
         return false;
     }
 
-    std::cout << "Server started on port " << port << std::endl;
+    if (endpoint.transport == Transport::InProc) {
+        // Se publica la direccion real (p. ej. el puerto efimero) bajo el nombre pedido
+        address.length = sizeof(address.storage);
+        getsockname(m_serverSocket, reinterpret_cast<sockaddr*>(&address.storage), &address.length);
+        if (!RegisterInProc(endpoint.path, address)) {
+            closesocket(m_serverSocket);
+            m_serverSocket = INVALID_SOCKET;
+            return false;
+        }
+        m_inprocName = endpoint.path;
+    }
+    m_transport = endpoint.transport;
+
+    if (endpoint.transport == Transport::Tcp) {
+        std::cout << "Server started on port " << endpoint.port << std::endl;
+    } else {
+        std::cout << "Server started on " << FormatEndpoint(endpoint) << std::endl;
+    }
     return true;
 }
 
 SOCKET
 NetworkHelper::AcceptClient() {
-    SOCKET clientSocket = accept(m_serverSocket, nullptr, nullptr);
-    if (clientSocket == INVALID_SOCKET) {
-        std::cerr << "Error accepting client: " << WSAGetLastError() << std::endl;
-        return INVALID_SOCKET;
+    SOCKET clientSocket;
+    for (;;) {
+        clientSocket = accept(m_serverSocket, nullptr, nullptr);
+        if (clientSocket == INVALID_SOCKET) {
+            std::cerr << "Error accepting client: " << WSAGetLastError() << std::endl;
+            return INVALID_SOCKET;
+        }
+        if (CheckInProcPeer(m_serverSocket, clientSocket)) {
+            break;
+        }
+        closesocket(clientSocket);
     }
 
     std::cout << "Client connected" << std::endl;
@@ -70,44 +149,194 @@ NetworkHelper::AcceptClient() {
 
 bool
 NetworkHelper::ConnectToServer(const std::string& ip, int port) {
-    // Crea el socket  TCP
-    m_serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    Endpoint endpoint;
+    endpoint.host = ip;
+    endpoint.port = port;
+    return Connect(endpoint);
+}
+
+bool
+NetworkHelper::ConnectToServer(const std::string& address) {
+    Endpoint endpoint;
+    return ParseEndpoint(address, endpoint) && Connect(endpoint);
+}
+
+bool
+NetworkHelper::Connect(const Endpoint& endpoint) {
+    SocketAddress address;
+    if (!ResolveEndpoint(endpoint, false, address)) {
+        return false;
+    }
+
+    m_serverSocket = socket(address.family, address.type, address.protocol);
     if (m_serverSocket == INVALID_SOCKET) {
         std::cerr << "Error creating socket: " << WSAGetLastError() << std::endl;
         return false;
     }
 
-    // Configurar la dirección del servidor
-    sockaddr_in serverAddress{};
-    serverAddress.sin_family = AF_INET;
-    serverAddress.sin_port = htons(port);
-    inet_pton(AF_INET, ip.c_str(), &serverAddress.sin_addr);
-
     // Conectar al servidor
-    if (connect(m_serverSocket, (sockaddr*)&serverAddress, sizeof(serverAddress)) == SOCKET_ERROR) {
+    if (connect(m_serverSocket, reinterpret_cast<const sockaddr*>(&address.storage), address.length) == SOCKET_ERROR) {
         std::cerr << "Error connecting to server: " << WSAGetLastError() << std::endl;
         closesocket(m_serverSocket);
         m_serverSocket = INVALID_SOCKET;
         return false;
     }
-    std::cout << "Connected to server at " << ip << ":" << port << std::endl;
+    m_transport = endpoint.transport;
+
+    if (endpoint.transport == Transport::Tcp) {
+        std::cout << "Connected to server at " << endpoint.host << ":" << endpoint.port << std::endl;
+    } else {
+        std::cout << "Connected to server at " << FormatEndpoint(endpoint) << std::endl;
+    }
+    return true;
+}
+
+namespace {
+// Registros por llamada a sendmmsg/recvmmsg
+constexpr size_t DATAGRAM_BATCH = 32;
+
+// Bloques de archivo que el kernel puede retener con zero-copy antes de esperar
+constexpr size_t FILE_MAX_PENDING_CHUNKS = 16;
+
+bool
+SendAll(SOCKET socket, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        int sent = send(socket, reinterpret_cast<const char*>(data), static_cast<int>(std::min<size_t>(size, 1 << 30)), MSG_NOSIGNAL);
+        if (sent == SOCKET_ERROR || sent == 0) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool
+ReceiveAll(SOCKET socket, unsigned char* data, size_t size) {
+    while (size > 0) {
+        int received = recv(socket, reinterpret_cast<char*>(data), static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+        if (received == SOCKET_ERROR || received == 0) {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+// Bloque de archivo con kTLS: cabecera y offset por send, los datos con sendfile
+bool
+SendFileRange(SOCKET socket, int descriptor, uint64_t offset, size_t size) {
+#ifdef __linux__
+    unsigned char header[FRAME_HEADER_SIZE + FILE_RECORD_HEADER_SIZE];
+    WriteFrameHeader(header, FrameType::FileChunk, static_cast<uint32_t>(FILE_RECORD_HEADER_SIZE + size));
+    WriteU64(header + FRAME_HEADER_SIZE, offset);
+    if (!SendAll(socket, header, sizeof(header))) {
+        return false;
+    }
+    off_t position = static_cast<off_t>(offset);
+    while (size > 0) {
+        ssize_t sent = sendfile(socket, descriptor, &position, size);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        size -= sent;
+    }
+    return true;
+#else
+    (void)socket;
+    (void)descriptor;
+    (void)offset;
+    (void)size;
+    return false;
+#endif
+}
+
+// SOCK_SEQPACKET: un registro por send; el primero lleva la cabecera
+bool
+SendRecords(SOCKET socket, const unsigned char* header, const unsigned char* payload, size_t size) {
+    size_t first = std::min(size, SEQPACKET_RECORD_SIZE - FRAME_HEADER_SIZE);
+    std::vector<unsigned char> record(FRAME_HEADER_SIZE + first);
+    std::memcpy(record.data(), header, FRAME_HEADER_SIZE);
+    if (first) {
+        std::memcpy(record.data() + FRAME_HEADER_SIZE, payload, first);
+    }
+    if (send(socket, reinterpret_cast<const char*>(record.data()), static_cast<int>(record.size()), MSG_NOSIGNAL)
+        != static_cast<int>(record.size())) {
+        return false;
+    }
+    for (size_t offset = first; offset < size; offset += SEQPACKET_RECORD_SIZE) {
+        int chunk = static_cast<int>(std::min(size - offset, SEQPACKET_RECORD_SIZE));
+        if (send(socket, reinterpret_cast<const char*>(payload + offset), chunk, MSG_NOSIGNAL) != chunk) {
+            return false;
+        }
+    }
     return true;
 }
 
+// Cada recv devuelve un registro completo; un tamano inesperado es un error.
+// La cabecera ya se leyo con MSG_PEEK y sigue al principio del primer registro.
+bool
+ReceiveRecords(SOCKET socket, size_t size, Frame& frame) {
+    size_t first = std::min<size_t>(size, SEQPACKET_RECORD_SIZE - FRAME_HEADER_SIZE);
+    std::vector<unsigned char> record(FRAME_HEADER_SIZE + first);
+    if (recv(socket, reinterpret_cast<char*>(record.data()), static_cast<int>(record.size()), 0)
+        != static_cast<int>(record.size())) {
+        return false;
+    }
+    frame.payload.assign(record.begin() + FRAME_HEADER_SIZE, record.end());
+    frame.payload.resize(size);
+    for (size_t offset = first; offset < size; offset += SEQPACKET_RECORD_SIZE) {
+        int chunk = static_cast<int>(std::min<size_t>(size - offset, SEQPACKET_RECORD_SIZE));
+        if (recv(socket, reinterpret_cast<char*>(frame.payload.data() + offset), chunk, 0) != chunk) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+RecordSend(int result) {
+    if (result == SOCKET_ERROR) {
+        Metrics::Add(MetricCounter::SendErrors);
+        return false;
+    }
+    Metrics::Add(MetricCounter::BytesSent, result);
+    Metrics::Add(MetricCounter::MessagesSent);
+    return true;
+}
+
+void
+RecordReceive(int result) {
+    if (result == SOCKET_ERROR) {
+        Metrics::Add(MetricCounter::ReceiveErrors);
+    } else if (result > 0) {
+        Metrics::Add(MetricCounter::BytesReceived, result);
+        Metrics::Add(MetricCounter::MessagesReceived);
+    }
+}
+}
+
 bool
 NetworkHelper::SendData(SOCKET socket, const std::string& data) {
-    return send(socket, data.c_str(), static_cast<int>(data.size()), 0) != SOCKET_ERROR;
+    LatencyTimer timer(MetricStage::Send);
+    return RecordSend(send(socket, data.c_str(), static_cast<int>(data.size()), MSG_NOSIGNAL));
 }
 
 bool
 NetworkHelper::SendData(SOCKET socket, const std::vector<unsigned char>& data) {
-    return send(socket, reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size()), 0) != SOCKET_ERROR;
+    LatencyTimer timer(MetricStage::Send);
+    return RecordSend(send(socket, reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size()), MSG_NOSIGNAL));
 }
 
 std::string
 NetworkHelper::ReceiveData(SOCKET socket) {
     char buffer[4096] = {};
     int len = recv(socket, buffer, sizeof(buffer) - 1, 0);
+    RecordReceive(len);
 
     return std::string(buffer, len);
 }
@@ -116,12 +345,1061 @@ std::vector<unsigned char>
 NetworkHelper::ReceiveData(SOCKET socket, int size) {
     std::vector<unsigned char> buffer(size);
     int len = recv(socket, reinterpret_cast<char*>(buffer.data()), size, 0);
+    RecordReceive(len);
     return buffer;
 }
 
+bool
+NetworkHelper::SendFrame(SOCKET socket, FrameType type, const unsigned char* payload, size_t size) {
+    if (size > MAX_FRAME_SIZE) {
+        return false;
+    }
+    LatencyTimer timer(MetricStage::Send);
+    unsigned char header[FRAME_HEADER_SIZE];
+    WriteFrameHeader(header, type, static_cast<uint32_t>(size));
+    bool sent = IsMessageOriented(m_transport)
+                    ? SendRecords(socket, header, payload, size)
+                    : SendAll(socket, header, FRAME_HEADER_SIZE) && SendAll(socket, payload, size);
+    if (!sent) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::SendErrors);
+        return false;
+    }
+    Metrics::Add(MetricCounter::BytesSent, FRAME_HEADER_SIZE + size);
+    Metrics::Add(MetricCounter::MessagesSent);
+    return true;
+}
+
+bool
+NetworkHelper::SendFrame(SOCKET socket, FrameType type, const PooledBuffer& buffer, size_t size) {
+    if (size > MAX_FRAME_SIZE || buffer->size() < FRAME_HEADER_SIZE + size) {
+        return false;
+    }
+    if (IsMessageOriented(m_transport)) {
+        return SendFrame(socket, type, buffer->data() + FRAME_HEADER_SIZE, size);
+    }
+    WriteFrameHeader(buffer->data(), type, static_cast<uint32_t>(size));
+    return SendData(socket, buffer, FRAME_HEADER_SIZE + size);
+}
+
+bool
+NetworkHelper::ReceiveFrame(SOCKET socket, Frame& frame) {
+    if (IsMessageOriented(m_transport)) {
+        unsigned char header[FRAME_HEADER_SIZE];
+        uint32_t size;
+        if (recv(socket, reinterpret_cast<char*>(header), FRAME_HEADER_SIZE, MSG_PEEK) != FRAME_HEADER_SIZE
+            || !ReadFrameHeader(header, frame.type, size)) {
+            Metrics::Add(MetricCounter::ReceiveErrors);
+            return false;
+        }
+        LatencyTimer timer(MetricStage::Receive);
+        if (!ReceiveRecords(socket, size, frame)) {
+            timer.Cancel();
+            Metrics::Add(MetricCounter::ReceiveErrors);
+            return false;
+        }
+        Metrics::Add(MetricCounter::BytesReceived, FRAME_HEADER_SIZE + size);
+        Metrics::Add(MetricCounter::MessagesReceived);
+        return true;
+    }
+    unsigned char header[FRAME_HEADER_SIZE];
+    uint32_t size;
+    if (!ReceiveAll(socket, header, FRAME_HEADER_SIZE) || !ReadFrameHeader(header, frame.type, size)) {
+        Metrics::Add(MetricCounter::ReceiveErrors);
+        return false;
+    }
+    // Se mide desde la cabecera: la espera previa es inactividad del peer
+    LatencyTimer timer(MetricStage::Receive);
+    frame.payload.resize(size);
+    if (!ReceiveAll(socket, frame.payload.data(), size)) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::ReceiveErrors);
+        return false;
+    }
+    Metrics::Add(MetricCounter::BytesReceived, FRAME_HEADER_SIZE + size);
+    Metrics::Add(MetricCounter::MessagesReceived);
+    return true;
+}
+
+bool
+NetworkHelper::SendEncrypted(SOCKET socket, CryptoHelper& crypto, const std::string& plaintext) {
+    FrameType type = FrameType::Data;
+    const std::string* message = &plaintext;
+    std::optional<std::string> compressed;
+    if (CompressionEnabled(socket) && (compressed = CompressMessage(plaintext))) {
+        type = FrameType::CompressedData;
+        message = &*compressed;
+    }
+    if (KernelTlsActive(socket)) {
+        return SendFrame(socket, type, reinterpret_cast<const unsigned char*>(message->data()), message->size());
+    }
+    std::vector<unsigned char> payload = SealDataPayload(crypto, *message);
+    return SendFrame(socket, type, payload.data(), payload.size());
+}
+
+std::optional<std::string>
+NetworkHelper::ReceiveEncrypted(SOCKET socket, CryptoHelper& crypto) {
+    {
+        std::lock_guard<std::mutex> lock(m_socketOptionsMutex);
+        auto pending = m_received.find(socket);
+        if (pending != m_received.end()) {
+            std::string message = std::move(pending->second.front());
+            pending->second.pop_front();
+            if (pending->second.empty()) {
+                m_received.erase(pending);
+            }
+            return message;
+        }
+    }
+    Frame frame;
+    while (ReceiveFrame(socket, frame)) {
+        if (frame.type == FrameType::KernelTls) {
+            if (!AnswerKernelTls(socket, crypto)) {
+                return std::nullopt;
+            }
+            continue;
+        }
+        bool batch = frame.type == FrameType::MessageBatch || frame.type == FrameType::CompressedBatch;
+        bool compressed = frame.type == FrameType::CompressedData || frame.type == FrameType::CompressedBatch;
+        if (frame.type != FrameType::Data && !batch && !compressed) {
+            continue;
+        }
+        std::optional<std::string> message;
+        if (KernelTlsActive(socket)) {
+            message = std::string(frame.payload.begin(), frame.payload.end());
+        } else if (!(message = OpenDataPayload(crypto, frame.payload))) {
+            std::cerr << "Malformed encrypted message" << std::endl;
+            return std::nullopt;
+        }
+        if (compressed && !(message = DecompressMessage(*message))) {
+            std::cerr << "Malformed compressed message" << std::endl;
+            return std::nullopt;
+        }
+        if (!batch) {
+            return message;
+        }
+        std::deque<std::string> messages;
+        if (!SplitBatch(*message, messages)) {
+            std::cerr << "Malformed message batch" << std::endl;
+            return std::nullopt;
+        }
+        message = std::move(messages.front());
+        messages.pop_front();
+        if (!messages.empty()) {
+            std::lock_guard<std::mutex> lock(m_socketOptionsMutex);
+            m_received[socket] = std::move(messages);
+        }
+        return message;
+    }
+    return std::nullopt;
+}
+
+bool
+NetworkHelper::RequestKernelTls(SOCKET socket, CryptoHelper& crypto) {
+    if (KernelTlsActive(socket) || !AttachKernelTls(socket)) {
+        return true; // sin kTLS local no hace falta preguntar
+    }
+    Frame frame;
+    if (!SendFrame(socket, FrameType::KernelTls, nullptr, 0)) {
+        return false;
+    }
+    do {
+        if (!ReceiveFrame(socket, frame)) {
+            return false;
+        }
+    } while (frame.type == FrameType::Heartbeat);
+    if (frame.type != FrameType::KernelTls || frame.payload.size() != 1) {
+        return false;
+    }
+    if (frame.payload[0] == 1) {
+        if (!EnableKernelTls(socket, crypto, HandshakeRole::Client)) {
+            return false;
+        }
+        MarkKernelTls(socket);
+    }
+    return true;
+}
+
+bool
+NetworkHelper::AnswerKernelTls(SOCKET socket, CryptoHelper& crypto) {
+    unsigned char accepted = !KernelTlsActive(socket) && AttachKernelTls(socket) ? 1 : 0;
+    if (!SendFrame(socket, FrameType::KernelTls, &accepted, 1)) {
+        return false;
+    }
+    // Con 1, lo siguiente que llegue del cliente ya viene en registros TLS
+    if (accepted) {
+        if (!EnableKernelTls(socket, crypto, HandshakeRole::Server)) {
+            return false;
+        }
+        MarkKernelTls(socket);
+    }
+    return true;
+}
+
+void
+NetworkHelper::MarkKernelTls(SOCKET socket) {
+    {
+        std::lock_guard<std::mutex> lock(m_socketOptionsMutex);
+        m_kernelTls.insert(socket);
+    }
+    auto state = m_zeroCopy.find(socket);
+    if (state != m_zeroCopy.end()) {
+        state->second.copied = true; // las confirmaciones pendientes se siguen procesando
+    }
+}
+
+bool
+NetworkHelper::KernelTlsActive(SOCKET socket) const {
+    std::lock_guard<std::mutex> lock(m_socketOptionsMutex);
+    return m_kernelTls.count(socket) != 0;
+}
+
+void
+NetworkHelper::EnableCompression(SOCKET socket) {
+    std::lock_guard<std::mutex> lock(m_socketOptionsMutex);
+    m_compression.insert(socket);
+}
+
+bool
+NetworkHelper::CompressionEnabled(SOCKET socket) const {
+    std::lock_guard<std::mutex> lock(m_socketOptionsMutex);
+    return m_compression.count(socket) != 0;
+}
+
+bool
+NetworkHelper::ClientHandshake(CryptoHelper& crypto) {
+    LatencyTimer timer(MetricStage::Handshake);
+    TraceSpan span("ClientHandshake", crypto.TraceId());
+    Frame frame;
+    bool established = false;
+    if (!ReceiveFrame(m_serverSocket, frame) || frame.type != FrameType::PublicKey) {
+        std::cerr << "Handshake failed" << std::endl;
+    } else {
+        try {
+            crypto.LoadPeerPublicKey(std::string(frame.payload.begin(), frame.payload.end()));
+            crypto.GenerateAESKey();
+            std::vector<unsigned char> encryptedKey = crypto.EncryptAESKeyWithPeer();
+            established = SendFrame(m_serverSocket, FrameType::SessionKey, encryptedKey.data(), encryptedKey.size());
+            if (!established) {
+                std::cerr << "Handshake failed" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Handshake failed: " << e.what() << std::endl;
+        }
+    }
+    if (!established) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::HandshakeErrors);
+        return false;
+    }
+    Metrics::Add(MetricCounter::Handshakes);
+    return true;
+}
+
+bool
+NetworkHelper::ServerHandshake(SOCKET socket, CryptoHelper& crypto) {
+    LatencyTimer timer(MetricStage::Handshake);
+    TraceSpan span("ServerHandshake", crypto.TraceId());
+    std::shared_ptr<const std::string> publicKey = crypto.GetPublicKeyBuffer();
+    bool sent;
+    {
+        TraceSpan sendSpan("SendPublicKey", crypto.TraceId());
+        sent = SendFrame(socket, FrameType::PublicKey, reinterpret_cast<const unsigned char*>(publicKey->data()),
+                         publicKey->size());
+    }
+    Frame frame;
+    bool received = false;
+    if (sent) {
+        TraceSpan receiveSpan("RecvSessionKey", crypto.TraceId());
+        received = ReceiveFrame(socket, frame);
+    }
+    bool established = false;
+    if (!received || frame.type != FrameType::SessionKey) {
+        std::cerr << "Handshake failed" << std::endl;
+    } else {
+        try {
+            crypto.DecryptAESKey(frame.payload);
+            established = true;
+        } catch (const std::exception& e) {
+            std::cerr << "Handshake failed: " << e.what() << std::endl;
+        }
+    }
+    if (!established) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::HandshakeErrors);
+        return false;
+    }
+    Metrics::Add(MetricCounter::Handshakes);
+    return true;
+}
+
+bool
+NetworkHelper::SendFile(SOCKET socket, CryptoHelper& crypto, const std::string& path, size_t chunkSize) {
+    if (chunkSize == 0 || chunkSize > MAX_FRAME_SIZE - FILE_RECORD_OVERHEAD) {
+        return false;
+    }
+    FileSource source;
+    return source.Open(path, chunkSize, 1) && StartFileStream(socket, crypto, source)
+           && SendFileStream(socket, crypto, source);
+}
+
+bool
+NetworkHelper::SendFileParallel(const std::string& address, const std::string& path, int streams, size_t chunkSize) {
+    if (chunkSize == 0 || chunkSize > MAX_FRAME_SIZE - FILE_RECORD_OVERHEAD) {
+        return false;
+    }
+    FileSource source;
+    if (!source.Open(path, chunkSize, std::clamp(streams, 1, MAX_FILE_STREAMS))) {
+        return false;
+    }
+    // Conexiones una a una, todas antes de enviar: el receptor las acepta en orden
+    struct Stream {
+        NetworkHelper network;
+        CryptoHelper crypto;
+        bool sent = false;
+    };
+    std::vector<std::unique_ptr<Stream>> connections;
+    for (int i = 0; i < source.Info().streams; ++i) {
+        auto stream = std::make_unique<Stream>();
+        NetworkHelper& network = stream->network;
+        if (!network.ConnectToServer(address) || !network.ClientHandshake(stream->crypto)
+            || !network.RequestKernelTls(network.GetSocket(), stream->crypto)
+            || !network.StartFileStream(network.GetSocket(), stream->crypto, source)) {
+            break; // los bloques se reparten entre las conexiones que haya
+        }
+        connections.push_back(std::move(stream));
+    }
+    if (connections.empty()) {
+        return false;
+    }
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<Stream>& connection : connections) {
+        threads.emplace_back([&source, stream = connection.get()] {
+            stream->sent = stream->network.SendFileStream(stream->network.GetSocket(), stream->crypto, source);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return std::all_of(connections.begin(), connections.end(),
+                       [](const std::unique_ptr<Stream>& stream) { return stream->sent; });
+}
+
+bool
+NetworkHelper::StartFileStream(SOCKET socket, CryptoHelper& crypto, FileSource& source) {
+    unsigned char encoded[FileInfo::ENCODED_SIZE];
+    source.Info().Encode(encoded);
+    // El id va dentro del registro: FileStart se autentica con id 0
+    if (!SendFileRecord(socket, crypto, FrameType::FileStart, 0, 0, encoded, sizeof(encoded))) {
+        return false;
+    }
+    std::vector<unsigned char> manifest;
+    try {
+        manifest = EncodeFileManifest(crypto, source.Info(), source.Manifest());
+    } catch (const std::exception& e) {
+        std::cerr << "File transfer failed: " << e.what() << std::endl;
+        return false;
+    }
+    if (manifest.size() > MAX_FRAME_SIZE - FILE_RECORD_OVERHEAD) {
+        std::cerr << "File has too many chunks for one manifest" << std::endl;
+        return false;
+    }
+    if (!SendFileRecord(socket, crypto, FrameType::FileManifest, source.Info().transferId, 0, manifest.data(),
+                        manifest.size())) {
+        return false;
+    }
+    Frame frame;
+    uint64_t offset = 0;
+    unsigned char* data = nullptr;
+    size_t length = 0;
+    if (!ReceiveFileRecord(socket, crypto, frame, source.Info().transferId, offset, data, length)
+        || frame.type != FrameType::FileResume) {
+        return false;
+    }
+    return source.SkipHeld(data, length);
+}
+
+bool
+NetworkHelper::SendFileStream(SOCKET socket, CryptoHelper& crypto, FileSource& source) {
+    const FileInfo& info = source.Info();
+    bool kernelTls = KernelTlsActive(socket);
+    uint64_t offset = 0;
+    size_t size = 0;
+    try {
+        while (source.Next(offset, size)) {
+            if (kernelTls) {
+                LatencyTimer timer(MetricStage::Send);
+                if (!SendFileRange(socket, source.File().Descriptor(), offset, size)) {
+                    timer.Cancel();
+                    Metrics::Add(MetricCounter::SendErrors);
+                    return false;
+                }
+                Metrics::Add(MetricCounter::BytesSent, FRAME_HEADER_SIZE + FILE_RECORD_HEADER_SIZE + size);
+                Metrics::Add(MetricCounter::MessagesSent);
+                continue;
+            }
+            PooledBuffer buffer = BufferPool::Instance().Acquire(FRAME_HEADER_SIZE + FILE_RECORD_OVERHEAD + size);
+            SealFileRecord(crypto, FrameType::FileChunk, info.transferId, offset, source.File().Data() + offset, size,
+                           buffer->data() + FRAME_HEADER_SIZE);
+            source.File().Release(offset, size);
+            if (!SendFrame(socket, FrameType::FileChunk, buffer, FILE_RECORD_OVERHEAD + size)) {
+                return false;
+            }
+            // Los bloques retenidos por zero-copy son la unica memoria que crece
+            if (ReapZeroCopy(socket) >= FILE_MAX_PENDING_CHUNKS) {
+                FlushZeroCopy(socket, 1000);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "File transfer failed: " << e.what() << std::endl;
+        return false;
+    }
+    if (!SendFileRecord(socket, crypto, FrameType::FileEnd, info.transferId, info.size, nullptr, 0)) {
+        return false;
+    }
+    Frame frame;
+    unsigned char* data = nullptr;
+    size_t length = 0;
+    return ReceiveFileRecord(socket, crypto, frame, info.transferId, offset, data, length)
+           && frame.type == FrameType::FileEnd;
+}
+
+bool
+NetworkHelper::ReceiveFile(SOCKET socket, CryptoHelper& crypto, const std::string& path) {
+    FileSink sink;
+    bool received = AcceptFileStream(socket, crypto, sink, path) && ReceiveFileStream(socket, crypto, sink);
+    return sink.Finish() && received;
+}
+
+bool
+NetworkHelper::AcceptFileStream(SOCKET socket, CryptoHelper& crypto, FileSink& sink, const std::string& path) {
+    Frame frame;
+    uint64_t offset = 0;
+    unsigned char* data = nullptr;
+    size_t length = 0;
+    FileInfo info;
+    if (!ReceiveFileRecord(socket, crypto, frame, 0, offset, data, length) || frame.type != FrameType::FileStart
+        || !info.Decode(data, length)) {
+        return false;
+    }
+    MerkleTree manifest;
+    if (!ReceiveFileRecord(socket, crypto, frame, info.transferId, offset, data, length)
+        || frame.type != FrameType::FileManifest) {
+        return false;
+    }
+    bool authentic = false;
+    try {
+        authentic = DecodeFileManifest(crypto, info, data, length, manifest);
+    } catch (const std::exception& e) {
+        std::cerr << "File transfer failed: " << e.what() << std::endl;
+        return false;
+    }
+    if (!authentic) {
+        std::cerr << "Invalid file manifest" << std::endl;
+        return false;
+    }
+    if (!sink.IsOpen()) {
+        if (!sink.Open(path, info) || !sink.SetManifest(std::move(manifest))) {
+            return false;
+        }
+    } else if (!(info == sink.Info()) || manifest.Root() != sink.Manifest().Root()) {
+        std::cerr << "File stream does not belong to this transfer" << std::endl;
+        return false;
+    }
+    sink.AddStream();
+    std::vector<unsigned char> bitmap = sink.Bitmap();
+    if (!SendFileRecord(socket, crypto, FrameType::FileResume, info.transferId, 0, bitmap.data(), bitmap.size())) {
+        sink.EndStream();
+        return false;
+    }
+    return true;
+}
+
+bool
+NetworkHelper::ReceiveFileStream(SOCKET socket, CryptoHelper& crypto, FileSink& sink) {
+    const FileInfo& info = sink.Info();
+    Frame frame;
+    uint64_t offset = 0;
+    unsigned char* data = nullptr;
+    size_t length = 0;
+    bool ended = false;
+    while (ReceiveFileRecord(socket, crypto, frame, info.transferId, offset, data, length)) {
+        if (frame.type == FrameType::FileEnd) {
+            ended = true;
+            break;
+        }
+        if (frame.type != FrameType::FileChunk) {
+            std::cerr << "Invalid file chunk at offset " << offset << std::endl;
+            break;
+        }
+        // Un bloque que no coincide con el manifiesto sigue faltando: se pide
+        // otra vez al reintentar, sin cortar el resto de la transferencia
+        if (!sink.Matches(offset, data, length)) {
+            std::cerr << "File chunk at offset " << offset << " does not match the manifest" << std::endl;
+            continue;
+        }
+        if (!sink.Write(offset, data, length)) {
+            std::cerr << "Invalid file chunk at offset " << offset << std::endl;
+            break;
+        }
+    }
+    sink.EndStream();
+    // El archivo puede terminar de completarse con bloques de otros streams
+    if (!ended || !sink.WaitComplete()) {
+        return false;
+    }
+    return SendFileRecord(socket, crypto, FrameType::FileEnd, info.transferId, info.size, nullptr, 0);
+}
+
+bool
+NetworkHelper::SyncFile(SOCKET socket, CryptoHelper& crypto, const std::string& path) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        return false;
+    }
+    std::vector<ContentChunk> chunks;
+    try {
+        chunks = ChunkFile(file);
+    } catch (const std::exception& e) {
+        std::cerr << "Error indexing file: " << e.what() << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> manifest = EncodeSyncManifest(file.Size(), chunks);
+    if (manifest.size() > MAX_FRAME_SIZE - FILE_RECORD_OVERHEAD) {
+        std::cerr << "File has too many chunks for one manifest" << std::endl;
+        return false;
+    }
+    if (!SendFileRecord(socket, crypto, FrameType::SyncManifest, 0, 0, manifest.data(), manifest.size())) {
+        return false;
+    }
+    Frame frame;
+    uint64_t offset = 0;
+    unsigned char* need = nullptr;
+    size_t length = 0;
+    if (!ReceiveFileRecord(socket, crypto, frame, 0, offset, need, length) || frame.type != FrameType::SyncNeed
+        || length != (chunks.size() + 7) / 8) {
+        return false;
+    }
+    try {
+        ConvergentCipher cipher(crypto);
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            const ContentChunk& chunk = chunks[i];
+            if (!(need[i / 8] & (1 << (i % 8)))) {
+                Metrics::Add(MetricCounter::BytesDeduplicated, chunk.size);
+                continue;
+            }
+            size_t size = SYNC_CHUNK_HEADER_SIZE + chunk.size + CryptoHelper::AEAD_TAG_SIZE;
+            PooledBuffer buffer = BufferPool::Instance().Acquire(FRAME_HEADER_SIZE + size);
+            unsigned char* payload = buffer->data() + FRAME_HEADER_SIZE;
+            WriteU32(payload, static_cast<uint32_t>(i));
+            cipher.Seal(chunk.hash, file.Data() + chunk.offset, chunk.size, payload + SYNC_CHUNK_HEADER_SIZE);
+            file.Release(chunk.offset, chunk.size);
+            if (!SendFrame(socket, FrameType::SyncChunk, buffer, size)) {
+                return false;
+            }
+            if (ReapZeroCopy(socket) >= FILE_MAX_PENDING_CHUNKS) {
+                FlushZeroCopy(socket, 1000);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "File sync failed: " << e.what() << std::endl;
+        return false;
+    }
+    return ReceiveFileRecord(socket, crypto, frame, 0, offset, need, length) && frame.type == FrameType::SyncEnd;
+}
+
+bool
+NetworkHelper::ReceiveSync(SOCKET socket, CryptoHelper& crypto, const std::string& path) {
+    Frame frame;
+    uint64_t offset = 0;
+    unsigned char* data = nullptr;
+    size_t length = 0;
+    std::vector<ContentChunk> chunks;
+    if (!ReceiveFileRecord(socket, crypto, frame, 0, offset, data, length) || frame.type != FrameType::SyncManifest
+        || !DecodeSyncManifest(data, length, chunks)) {
+        return false;
+    }
+    SyncSink sink;
+    if (!sink.Open(path, std::move(chunks))
+        || !SendFileRecord(socket, crypto, FrameType::SyncNeed, 0, 0, sink.Need().data(), sink.Need().size())) {
+        return false;
+    }
+    try {
+        ConvergentCipher cipher(crypto);
+        for (size_t i = 0; i < sink.Chunks().size(); ++i) {
+            if (!sink.Needs(i)) {
+                if (!sink.Write(i, nullptr)) {
+                    return false;
+                }
+                continue;
+            }
+            uint32_t size = sink.Chunks()[i].size;
+            if (!ReceiveFileFrame(socket, crypto, frame) || frame.type != FrameType::SyncChunk
+                || frame.payload.size() != SYNC_CHUNK_HEADER_SIZE + size + CryptoHelper::AEAD_TAG_SIZE
+                || ReadU32(frame.payload.data()) != i
+                || !cipher.Open(sink.Chunks()[i].hash, frame.payload.data() + SYNC_CHUNK_HEADER_SIZE, size)) {
+                std::cerr << "Invalid sync chunk " << i << std::endl;
+                return false;
+            }
+            if (!sink.Write(i, frame.payload.data() + SYNC_CHUNK_HEADER_SIZE)) {
+                return false;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "File sync failed: " << e.what() << std::endl;
+        return false;
+    }
+    return sink.Commit() && SendFileRecord(socket, crypto, FrameType::SyncEnd, 0, 0, nullptr, 0);
+}
+
+bool
+NetworkHelper::SendFileRecord(SOCKET socket, CryptoHelper& crypto, FrameType type, uint64_t transferId,
+                              uint64_t offset, const unsigned char* data, size_t size) {
+    if (KernelTlsActive(socket)) {
+        std::vector<unsigned char> payload(FILE_RECORD_HEADER_SIZE + size);
+        WriteU64(payload.data(), offset);
+        if (size) {
+            std::memcpy(payload.data() + FILE_RECORD_HEADER_SIZE, data, size);
+        }
+        return SendFrame(socket, type, payload.data(), payload.size());
+    }
+    std::vector<unsigned char> record(FILE_RECORD_OVERHEAD + size);
+    try {
+        SealFileRecord(crypto, type, transferId, offset, data, size, record.data());
+    } catch (const std::exception& e) {
+        std::cerr << "File transfer failed: " << e.what() << std::endl;
+        return false;
+    }
+    return SendFrame(socket, type, record.data(), record.size());
+}
+
+bool
+NetworkHelper::ReceiveFileFrame(SOCKET socket, CryptoHelper& crypto, Frame& frame) {
+    for (;;) {
+        if (!ReceiveFrame(socket, frame)) {
+            return false;
+        }
+        if (frame.type != FrameType::KernelTls) {
+            return true;
+        }
+        if (!AnswerKernelTls(socket, crypto)) {
+            return false;
+        }
+    }
+}
+
+bool
+NetworkHelper::ReceiveFileRecord(SOCKET socket, CryptoHelper& crypto, Frame& frame, uint64_t transferId,
+                                 uint64_t& offset, unsigned char*& data, size_t& length) {
+    if (!ReceiveFileFrame(socket, crypto, frame)) {
+        return false;
+    }
+    if (KernelTlsActive(socket)) {
+        if (frame.payload.size() < FILE_RECORD_HEADER_SIZE) {
+            return false;
+        }
+        offset = ReadU64(frame.payload.data());
+        data = frame.payload.data() + FILE_RECORD_HEADER_SIZE;
+        length = frame.payload.size() - FILE_RECORD_HEADER_SIZE;
+        return true;
+    }
+    // El tipo de la trama forma parte de los datos asociados
+    if (!OpenFileRecord(crypto, frame.type, transferId, frame.payload.data(), frame.payload.size(), offset, data,
+                        length)) {
+        std::cerr << "Malformed file record" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool
+NetworkHelper::OpenDatagram(int port) {
+    Endpoint endpoint;
+    endpoint.port = port;
+    return OpenDatagram(endpoint, true);
+}
+
+bool
+NetworkHelper::OpenDatagram(const std::string& ip, int port) {
+    Endpoint endpoint;
+    endpoint.host = ip;
+    endpoint.port = port;
+    return OpenDatagram(endpoint, false);
+}
+
+bool
+NetworkHelper::OpenDatagram(const Endpoint& endpoint, bool listening) {
+    SocketAddress address;
+    if (!ResolveEndpoint(endpoint, listening, address)) {
+        return false;
+    }
+    m_datagramSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_datagramSocket == INVALID_SOCKET) {
+        std::cerr << "Error creating socket: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+    // El servidor escucha en el puerto; el cliente conecta para filtrar otros origenes
+    const sockaddr* target = reinterpret_cast<const sockaddr*>(&address.storage);
+    int result = listening ? bind(m_datagramSocket, target, address.length) : connect(m_datagramSocket, target, address.length);
+    if (result == SOCKET_ERROR) {
+        std::cerr << (listening ? "Bind failed: " : "Error connecting to server: ") << WSAGetLastError() << std::endl;
+        closesocket(m_datagramSocket);
+        m_datagramSocket = INVALID_SOCKET;
+        return false;
+    }
+    m_datagramConnected = !listening;
+    m_datagramBuffer.resize(DATAGRAM_BATCH * DatagramSession::MAX_RECORD_SIZE);
+    return true;
+}
+
+size_t
+NetworkHelper::SendDatagrams(DatagramSession& session, const std::vector<std::string>& messages) {
+    if (m_datagramSocket == INVALID_SOCKET || (!m_datagramConnected && !session.HasPeer())) {
+        std::cerr << "Datagram peer unknown" << std::endl;
+        return 0;
+    }
+    const SocketAddress& peer = session.Peer();
+    size_t sent = 0;
+    while (sent < messages.size()) {
+        size_t sizes[DATAGRAM_BATCH];
+        size_t count = 0;
+        for (; count < DATAGRAM_BATCH && sent + count < messages.size(); ++count) {
+            const std::string& message = messages[sent + count];
+            if (message.size() > DatagramSession::MAX_PLAINTEXT_SIZE) {
+                std::cerr << "Datagram too large: " << message.size() << std::endl;
+                break;
+            }
+            sizes[count] = session.Seal(reinterpret_cast<const unsigned char*>(message.data()), message.size(),
+                                        m_datagramBuffer.data() + count * DatagramSession::MAX_RECORD_SIZE);
+        }
+        if (count == 0) {
+            break;
+        }
+
+        int result;
+#ifdef __linux__
+        mmsghdr headers[DATAGRAM_BATCH] = {};
+        iovec vectors[DATAGRAM_BATCH];
+        for (size_t i = 0; i < count; ++i) {
+            vectors[i] = {m_datagramBuffer.data() + i * DatagramSession::MAX_RECORD_SIZE, sizes[i]};
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            if (!m_datagramConnected) {
+                headers[i].msg_hdr.msg_name = const_cast<sockaddr_storage*>(&peer.storage);
+                headers[i].msg_hdr.msg_namelen = peer.length;
+            }
+        }
+        result = sendmmsg(m_datagramSocket, headers, static_cast<unsigned int>(count), 0);
+#else
+        for (result = 0; result < static_cast<int>(count); ++result) {
+            const char* record = reinterpret_cast<const char*>(m_datagramBuffer.data() + result * DatagramSession::MAX_RECORD_SIZE);
+            const sockaddr* target = m_datagramConnected ? nullptr : reinterpret_cast<const sockaddr*>(&peer.storage);
+            if (sendto(m_datagramSocket, record, static_cast<int>(sizes[result]), 0, target,
+                       m_datagramConnected ? 0 : peer.length) == SOCKET_ERROR) {
+                break;
+            }
+        }
+        if (result == 0) {
+            result = SOCKET_ERROR;
+        }
+#endif
+        if (result == SOCKET_ERROR) {
+            Metrics::Add(MetricCounter::SendErrors);
+            break;
+        }
+        for (int i = 0; i < result; ++i) {
+            Metrics::Add(MetricCounter::BytesSent, sizes[i]);
+        }
+        Metrics::Add(MetricCounter::MessagesSent, result);
+        sent += result;
+        // El socket no acepto el lote entero; un mensaje demasiado grande corta el siguiente lote
+        if (static_cast<size_t>(result) < count) {
+            break;
+        }
+    }
+    return sent;
+}
+
+size_t
+NetworkHelper::ReceiveDatagrams(DatagramSession& session, std::vector<std::string>& messages, size_t maxMessages,
+                                int timeoutMs) {
+    messages.clear();
+    if (m_datagramSocket == INVALID_SOCKET) {
+        return 0;
+    }
+    WSAPOLLFD wait{};
+    wait.fd = m_datagramSocket;
+    wait.events = POLLIN;
+    if (WSAPoll(&wait, 1, timeoutMs) <= 0) {
+        return 0;
+    }
+
+    size_t count = std::min<size_t>(std::max<size_t>(maxMessages, 1), DATAGRAM_BATCH);
+    sockaddr_storage sources[DATAGRAM_BATCH];
+    socklen_t sourceLengths[DATAGRAM_BATCH];
+    size_t sizes[DATAGRAM_BATCH];
+    int received;
+#ifdef __linux__
+    mmsghdr headers[DATAGRAM_BATCH] = {};
+    iovec vectors[DATAGRAM_BATCH];
+    for (size_t i = 0; i < count; ++i) {
+        vectors[i] = {m_datagramBuffer.data() + i * DatagramSession::MAX_RECORD_SIZE, DatagramSession::MAX_RECORD_SIZE};
+        headers[i].msg_hdr.msg_iov = &vectors[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+        headers[i].msg_hdr.msg_name = &sources[i];
+        headers[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+    }
+    received = recvmmsg(m_datagramSocket, headers, static_cast<unsigned int>(count), MSG_DONTWAIT, nullptr);
+    for (int i = 0; i < received; ++i) {
+        // Un registro truncado no autenticaria: se marca como vacio para descartarlo
+        sizes[i] = (headers[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : headers[i].msg_len;
+        sourceLengths[i] = headers[i].msg_hdr.msg_namelen;
+    }
+#else
+    for (received = 0; received < static_cast<int>(count); ++received) {
+        if (received > 0 && WSAPoll(&wait, 1, 0) <= 0) {
+            break;
+        }
+        sourceLengths[received] = sizeof(sources[received]);
+        int length = recvfrom(m_datagramSocket,
+                              reinterpret_cast<char*>(m_datagramBuffer.data() + received * DatagramSession::MAX_RECORD_SIZE),
+                              static_cast<int>(DatagramSession::MAX_RECORD_SIZE), 0,
+                              reinterpret_cast<sockaddr*>(&sources[received]), &sourceLengths[received]);
+        if (length == SOCKET_ERROR) {
+            break;
+        }
+        sizes[received] = length;
+    }
+    if (received == 0) {
+        received = SOCKET_ERROR;
+    }
+#endif
+    if (received == SOCKET_ERROR) {
+        Metrics::Add(MetricCounter::ReceiveErrors);
+        return 0;
+    }
+
+    for (int i = 0; i < received; ++i) {
+        Metrics::Add(MetricCounter::BytesReceived, sizes[i]);
+        Metrics::Add(MetricCounter::MessagesReceived);
+        std::optional<std::string> message =
+            session.Open(m_datagramBuffer.data() + i * DatagramSession::MAX_RECORD_SIZE, sizes[i]);
+        if (!message) {
+            continue;
+        }
+        if (!m_datagramConnected) {
+            SocketAddress& peer = session.Peer();
+            std::memcpy(&peer.storage, &sources[i], sourceLengths[i]);
+            peer.length = sourceLengths[i];
+            peer.family = sources[i].ss_family;
+            peer.type = SOCK_DGRAM;
+            peer.protocol = IPPROTO_UDP;
+        }
+        messages.push_back(std::move(*message));
+    }
+    return messages.size();
+}
+
+SOCKET
+NetworkHelper::GetDatagramSocket() const {
+    return m_datagramSocket;
+}
+
 void
 NetworkHelper::close(SOCKET socket) {
-    closesocket(socket);    
+    // El kernel puede seguir leyendo buffers zero-copy despues de cerrar: no
+    // se devuelven al pool hasta que los confirma
+    auto state = m_zeroCopy.find(socket);
+    if (state != m_zeroCopy.end()) {
+        FlushZeroCopy(socket, 1000);
+        m_zeroCopy.erase(state);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_socketOptionsMutex);
+        m_kernelTls.erase(socket);
+        m_compression.erase(socket);
+        m_received.erase(socket);
+    }
+    closesocket(socket);
+}
+
+bool
+NetworkHelper::EnableZeroCopy(SOCKET socket) {
+#if defined(__linux__) && defined(SO_ZEROCOPY)
+    if (KernelTlsActive(socket)) {
+        return false;
+    }
+    int enabled = 1;
+    if (setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &enabled, sizeof(enabled)) == 0) {
+        m_zeroCopy.try_emplace(socket);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool
+NetworkHelper::SendData(SOCKET socket, const PooledBuffer& buffer, size_t size) {
+    LatencyTimer timer(MetricStage::Send);
+    auto state = m_zeroCopy.find(socket);
+    bool sent = state != m_zeroCopy.end() && size >= ZEROCOPY_THRESHOLD && !state->second.copied
+                    ? SendZeroCopy(socket, state->second, buffer, size)
+                    : SendAll(socket, buffer->data(), size);
+    if (!sent) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::SendErrors);
+        return false;
+    }
+    Metrics::Add(MetricCounter::BytesSent, size);
+    Metrics::Add(MetricCounter::MessagesSent);
+    return true;
+}
+
+bool
+NetworkHelper::SendZeroCopy(SOCKET socket, ZeroCopyState& state, const PooledBuffer& buffer, size_t size) {
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+    const unsigned char* data = buffer->data();
+    size_t offset = 0;
+    bool issued = false;
+    while (offset < size) {
+        ssize_t sent = send(socket, data + offset, size - offset, MSG_ZEROCOPY | MSG_NOSIGNAL);
+        if (sent > 0) {
+            offset += sent;
+            ++state.nextId;
+            issued = true;
+            continue;
+        }
+        if (sent == -1 && errno == ENOBUFS) {
+            // Limite de memoria de confirmaciones (optmem): si se libero alguna, reintentar
+            size_t before = state.pending.size();
+            if (before > 0 && ReapZeroCopy(socket) < before) {
+                continue;
+            }
+            // Sin confirmaciones que recoger: el resto se envia copiando
+            Metrics::Add(MetricCounter::BytesZeroCopied, offset);
+            if (issued) {
+                state.pending.emplace_back(state.nextId - 1, buffer);
+            }
+            return SendAll(socket, data + offset, size - offset);
+        }
+        if (issued) {
+            state.pending.emplace_back(state.nextId - 1, buffer);
+        }
+        return false;
+    }
+    state.pending.emplace_back(state.nextId - 1, buffer);
+    Metrics::Add(MetricCounter::BytesZeroCopied, size);
+    ReapZeroCopy(socket);
+    return true;
+#else
+    (void)state;
+    return SendAll(socket, buffer->data(), size);
+#endif
 }
 
+size_t
+NetworkHelper::ReapZeroCopy(SOCKET socket) {
+    auto found = m_zeroCopy.find(socket);
+    if (found == m_zeroCopy.end()) {
+        return 0;
+    }
+    ZeroCopyState& state = found->second;
+#if defined(__linux__) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    for (;;) {
+        alignas(cmsghdr) char control[128];
+        msghdr message{};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(socket, &message, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            break;
+        }
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            bool recvErr = (header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR)
+                           || (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR);
+            if (!recvErr) {
+                continue;
+            }
+            sock_extended_err error;
+            std::memcpy(&error, CMSG_DATA(header), sizeof(error));
+            if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || error.ee_errno != 0) {
+                continue;
+            }
+            // El kernel tuvo que copiar (p. ej. loopback): los siguientes envios copian directamente
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                state.copied = true;
+            }
+            // Rango [ee_info, ee_data] de llamadas confirmadas
+            if (error.ee_info == state.completedBelow) {
+                state.completedBelow = error.ee_data + 1;
+            } else {
+                for (uint32_t id = error.ee_info; id != error.ee_data + 1; ++id) {
+                    state.completedAbove.insert(id);
+                }
+            }
+            while (!state.completedAbove.empty() && *state.completedAbove.begin() <= state.completedBelow) {
+                if (*state.completedAbove.begin() == state.completedBelow) {
+                    ++state.completedBelow;
+                }
+                state.completedAbove.erase(state.completedAbove.begin());
+            }
+        }
+    }
+#endif
+    // Un buffer vuelve al pool cuando se confirmo su ultima llamada
+    while (!state.pending.empty() && state.pending.front().first < state.completedBelow) {
+        state.pending.pop_front();
+    }
+    return state.pending.size();
+}
 
+bool
+NetworkHelper::FlushZeroCopy(SOCKET socket, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (ReapZeroCopy(socket) > 0) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+        // Las confirmaciones despiertan como POLLERR, que no hace falta pedir
+        WSAPOLLFD wait{};
+        wait.fd = socket;
+        WSAPoll(&wait, 1, static_cast<int>(remaining.count()));
+    }
+    return true;
+}
+
+SOCKET
+NetworkHelper::GetSocket() const {
+    return m_serverSocket;
+}
+
+Transport
+NetworkHelper::GetTransport() const {
+    return m_transport;
+}
+
+bool
+NetworkHelper::SetNonBlocking(SOCKET socket, bool enabled) {
+#ifdef _WIN32
+    u_long mode = enabled ? 1 : 0;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+    return fcntl(socket, F_SETFL, enabled ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) == 0;
+#endif
+}
+
+bool
+NetworkHelper::SetReceiveTimeout(SOCKET socket, std::chrono::milliseconds timeout) {
+#ifdef _WIN32
+    DWORD value = static_cast<DWORD>(timeout.count());
+#else
+    timeval value{};
+    value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    value.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+#endif
+    return setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&value, sizeof(value)) == 0;
+}
@@ -0,0 +1,128 @@
+#include "PeerKeyCache.h"
+#include "openssl/evp.h"
+#include "openssl/pem.h"
+
+PeerKeyCache::PeerKeyCache(size_t capacity, size_t shardCount) {
+    if (shardCount == 0) {
+        shardCount = 1;
+    }
+    m_shardCapacity = (capacity + shardCount - 1) / shardCount;
+    if (m_shardCapacity == 0) {
+        m_shardCapacity = 1;
+    }
+    m_shards.reserve(shardCount);
+    for (size_t i = 0; i < shardCount; ++i) {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+PeerKeyCache::~PeerKeyCache() {
+    Clear();
+}
+
+PeerKeyCache&
+PeerKeyCache::Instance() {
+    static PeerKeyCache cache;
+    return cache;
+}
+
+std::string
+PeerKeyCache::Fingerprint(const std::string& pemKey) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    if (!EVP_Digest(pemKey.data(), pemKey.size(), digest, &length, EVP_sha256(), nullptr)) {
+        throw std::runtime_error("Failed to hash peer public key.");
+    }
+    return std::string(reinterpret_cast<char*>(digest), length);
+}
+
+PeerKeyCache::Shard&
+PeerKeyCache::ShardFor(const std::string& fingerprint) {
+    // La huella ya es uniforme: basta con sus primeros bytes
+    size_t value = static_cast<unsigned char>(fingerprint[0])
+                   | (static_cast<size_t>(static_cast<unsigned char>(fingerprint[1])) << 8);
+    return *m_shards[value % m_shards.size()];
+}
+
+RSA*
+PeerKeyCache::Acquire(const std::string& pemKey) {
+    std::string fingerprint = Fingerprint(pemKey);
+    Shard& shard = ShardFor(fingerprint);
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(fingerprint);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            RSA_up_ref(it->second->key);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second->key;
+        }
+    }
+
+    // El parseo se hace fuera del candado; otro hilo puede ganar la carrera
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    BIO* bio = BIO_new_mem_buf(pemKey.data(), static_cast<int>(pemKey.size()));
+    RSA* parsed = PEM_read_bio_RSAPublicKey(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    if (!parsed) {
+        return nullptr;
+    }
+
+    RSA* evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(fingerprint);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            RSA_up_ref(it->second->key);
+            RSA* existing = it->second->key;
+            RSA_free(parsed);
+            return existing;
+        }
+
+        if (shard.lru.size() >= m_shardCapacity) {
+            Entry& oldest = shard.lru.back();
+            evicted = oldest.key;
+            shard.index.erase(oldest.fingerprint);
+            shard.lru.pop_back();
+            m_evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Una referencia para la cache y otra para el llamador
+        RSA_up_ref(parsed);
+        shard.lru.push_front(Entry{fingerprint, parsed});
+        shard.index.emplace(std::move(fingerprint), shard.lru.begin());
+    }
+
+    if (evicted) {
+        RSA_free(evicted);
+    }
+    return parsed;
+}
+
+void
+PeerKeyCache::Clear() {
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        for (Entry& entry : shard->lru) {
+            RSA_free(entry.key);
+        }
+        shard->lru.clear();
+        shard->index.clear();
+    }
+}
+
+PeerKeyCache::Stats
+PeerKeyCache::GetStats() const {
+    Stats stats{};
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    stats.evictions = m_evictions.load(std::memory_order_relaxed);
+    stats.capacity = m_shardCapacity * m_shards.size();
+    for (const auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.size += shard->lru.size();
+    }
+    return stats;
+}
@@ -0,0 +1,108 @@
+#include "Protocol.h"
+#include <cstring>
+
+void
+WriteU32(unsigned char* out, uint32_t value) {
+    out[0] = static_cast<unsigned char>(value >> 24);
+    out[1] = static_cast<unsigned char>(value >> 16);
+    out[2] = static_cast<unsigned char>(value >> 8);
+    out[3] = static_cast<unsigned char>(value);
+}
+
+uint32_t
+ReadU32(const unsigned char* in) {
+    return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16)
+           | (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+}
+
+void
+WriteU64(unsigned char* out, uint64_t value) {
+    WriteU32(out, static_cast<uint32_t>(value >> 32));
+    WriteU32(out + 4, static_cast<uint32_t>(value));
+}
+
+uint64_t
+ReadU64(const unsigned char* in) {
+    return (static_cast<uint64_t>(ReadU32(in)) << 32) | ReadU32(in + 4);
+}
+
+void
+WriteFrameHeader(unsigned char* out, FrameType type, uint32_t size) {
+    WriteU32(out, size);
+    out[4] = static_cast<unsigned char>(type);
+}
+
+bool
+ReadFrameHeader(const unsigned char* in, FrameType& type, uint32_t& size) {
+    size = ReadU32(in);
+    type = static_cast<FrameType>(in[4]);
+    return size <= MAX_FRAME_SIZE;
+}
+
+std::vector<unsigned char>
+SealDataPayload(CryptoHelper& crypto, const std::string& plaintext) {
+    std::vector<unsigned char> payload(DataPayloadSize(plaintext.size()));
+    SealDataPayload(crypto, reinterpret_cast<const unsigned char*>(plaintext.data()), plaintext.size(), payload.data());
+    return payload;
+}
+
+void
+SealDataPayload(CryptoHelper& crypto, const unsigned char* plaintext, size_t size, unsigned char* out) {
+    WriteU32(out, static_cast<uint32_t>(size));
+    crypto.AESEncrypt(plaintext, size, out + 4, out + 4 + AES_BLOCK_SIZE);
+}
+
+std::optional<std::string>
+OpenDataPayload(CryptoHelper& crypto, const std::vector<unsigned char>& payload) {
+    return OpenDataPayload(crypto, payload.data(), payload.size());
+}
+
+std::optional<std::string>
+OpenDataPayload(CryptoHelper& crypto, const unsigned char* payload, size_t size) {
+    if (size < 4 + AES_BLOCK_SIZE) {
+        return std::nullopt;
+    }
+    uint32_t length = ReadU32(payload);
+    size_t ciphertextSize = size - 4 - AES_BLOCK_SIZE;
+    // SealDataPayload manda siempre length + AES_BLOCK_SIZE bytes: los bloques
+    // CBC que cubren el texto y ceros. Solo se descifran bloques completos;
+    // AES_cbc_encrypt leeria un bloque entero aunque quedaran menos bytes.
+    if (ciphertextSize != static_cast<size_t>(length) + AES_BLOCK_SIZE) {
+        return std::nullopt;
+    }
+    size_t blocks = (static_cast<size_t>(length) + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
+    std::string plaintext(blocks, '\0');
+    if (blocks) {
+        crypto.AESDescrypt(payload + 4 + AES_BLOCK_SIZE, blocks, payload + 4,
+                           reinterpret_cast<unsigned char*>(plaintext.data()));
+    }
+    plaintext.resize(length);
+    return plaintext;
+}
+
+void
+AppendBatchMessage(std::string& batch, const std::string& message) {
+    unsigned char header[BATCH_MESSAGE_HEADER_SIZE];
+    WriteU32(header, static_cast<uint32_t>(message.size()));
+    batch.append(reinterpret_cast<const char*>(header), sizeof(header));
+    batch.append(message);
+}
+
+bool
+SplitBatch(const std::string& batch, std::deque<std::string>& messages) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(batch.data());
+    size_t offset = 0;
+    size_t queued = messages.size();
+    while (offset < batch.size()) {
+        size_t left = batch.size() - offset;
+        if (left < BATCH_MESSAGE_HEADER_SIZE || ReadU32(in + offset) > left - BATCH_MESSAGE_HEADER_SIZE) {
+            messages.resize(queued);
+            return false;
+        }
+        size_t length = ReadU32(in + offset);
+        offset += BATCH_MESSAGE_HEADER_SIZE;
+        messages.emplace_back(batch, offset, length);
+        offset += length;
+    }
+    return messages.size() > queued;
+}
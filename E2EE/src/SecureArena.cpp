@@ -0,0 +1,194 @@
+#include "SecureArena.h"
+#include "openssl/crypto.h"
+#include <cstdlib>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+size_t
+QueryPageSize() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwPageSize);
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? static_cast<size_t>(size) : 4096;
+#endif
+}
+}
+
+SecureArena::SecureArena(size_t slotsPerRegion, size_t slotSize) :
+    m_slotsPerRegion(slotsPerRegion ? slotsPerRegion : 1), m_slotSize(slotSize ? slotSize : SLOT_SIZE),
+    m_pageSize(QueryPageSize()) {
+}
+
+SecureArena::~SecureArena() {
+    for (Region& region : m_regions) {
+        OPENSSL_cleanse(region.slots, region.slotBytes);
+#ifdef _WIN32
+        if (region.locked) {
+            VirtualUnlock(region.slots, region.slotBytes);
+        }
+        VirtualFree(region.base, 0, MEM_RELEASE);
+#else
+        if (region.locked) {
+            munlock(region.slots, region.slotBytes);
+        }
+        munmap(region.base, region.mapSize);
+#endif
+    }
+}
+
+SecureArena&
+SecureArena::Instance() {
+    static SecureArena arena;
+    return arena;
+}
+
+bool
+SecureArena::AddRegion() {
+    // [guarda][slots ...][guarda]: un solo bloqueo por region, no por sesion
+    size_t slotBytes = m_slotsPerRegion * m_slotSize;
+    slotBytes = (slotBytes + m_pageSize - 1) / m_pageSize * m_pageSize;
+    size_t mapSize = slotBytes + 2 * m_pageSize;
+
+    Region region{};
+    region.mapSize = mapSize;
+    region.slotBytes = slotBytes;
+
+#ifdef _WIN32
+    void* base = VirtualAlloc(nullptr, mapSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!base) {
+        return false;
+    }
+    region.base = static_cast<unsigned char*>(base);
+    region.slots = region.base + m_pageSize;
+    DWORD oldProtect;
+    VirtualProtect(region.base, m_pageSize, PAGE_NOACCESS, &oldProtect);
+    VirtualProtect(region.slots + slotBytes, m_pageSize, PAGE_NOACCESS, &oldProtect);
+    region.locked = VirtualLock(region.slots, slotBytes) != 0;
+#else
+    void* base = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    region.base = static_cast<unsigned char*>(base);
+    region.slots = region.base + m_pageSize;
+    mprotect(region.base, m_pageSize, PROT_NONE);
+    mprotect(region.slots + slotBytes, m_pageSize, PROT_NONE);
+    region.locked = mlock(region.slots, slotBytes) == 0;
+#ifdef MADV_DONTDUMP
+    // Las claves no deben aparecer en core dumps
+    madvise(region.slots, slotBytes, MADV_DONTDUMP);
+#endif
+#endif
+
+    if (!region.locked) {
+        std::cerr << "SecureArena: could not lock key memory, pages may be swapped" << std::endl;
+    }
+
+    size_t slotCount = slotBytes / m_slotSize;
+    region.inUse.assign(slotCount, false);
+    m_freeList.reserve(m_freeList.size() + slotCount);
+    // Orden inverso para que Allocate entregue las direcciones mas bajas primero
+    for (size_t i = slotCount; i > 0; --i) {
+        m_freeList.push_back(region.slots + (i - 1) * m_slotSize);
+    }
+    m_regions.push_back(std::move(region));
+    return true;
+}
+
+SecureArena::Region*
+SecureArena::Locate(const unsigned char* slot, size_t& index) {
+    for (Region& region : m_regions) {
+        if (slot >= region.slots && slot < region.slots + region.slotBytes) {
+            size_t offset = static_cast<size_t>(slot - region.slots);
+            if (offset % m_slotSize != 0) {
+                return nullptr;
+            }
+            index = offset / m_slotSize;
+            return &region;
+        }
+    }
+    return nullptr;
+}
+
+unsigned char*
+SecureArena::Allocate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_freeList.empty() && !AddRegion()) {
+        throw std::runtime_error("SecureArena: failed to map key memory region");
+    }
+    unsigned char* slot = m_freeList.back();
+    m_freeList.pop_back();
+    size_t index = 0;
+    Locate(slot, index)->inUse[index] = true;
+    return slot;
+}
+
+void
+SecureArena::Free(unsigned char* slot) noexcept {
+    if (!slot) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t index = 0;
+    Region* region = Locate(slot, index);
+    // Seguir seria peor que parar: la lista libre acabaria repartiendo memoria
+    // ajena o el mismo slot a dos sesiones
+    if (!region) {
+        std::cerr << "SecureArena: pointer does not belong to the arena" << std::endl;
+        std::abort();
+    }
+    if (!region->inUse[index]) {
+        std::cerr << "SecureArena: slot is not in use (double free)" << std::endl;
+        std::abort();
+    }
+    region->inUse[index] = false;
+    OPENSSL_cleanse(slot, m_slotSize);
+    m_freeList.push_back(slot);
+}
+
+size_t
+SecureArena::SlotSize() const {
+    return m_slotSize;
+}
+
+size_t
+SecureArena::Capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t total = 0;
+    for (const Region& region : m_regions) {
+        total += region.slotBytes / m_slotSize;
+    }
+    return total;
+}
+
+size_t
+SecureArena::InUse() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t total = 0;
+    for (const Region& region : m_regions) {
+        total += region.slotBytes / m_slotSize;
+    }
+    return total - m_freeList.size();
+}
+
+bool
+SecureArena::IsLocked() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Region& region : m_regions) {
+        if (!region.locked) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,306 @@
+#include "Server.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+// "ip:puerto" del cliente, "unix" en sockets locales (tambien inproc)
+std::string
+PeerName(SOCKET socket) {
+    sockaddr_storage address{};
+    socklen_t length = sizeof(address);
+    if (getpeername(socket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        return std::string();
+    }
+    char host[INET6_ADDRSTRLEN] = {};
+    if (address.ss_family == AF_INET) {
+        const sockaddr_in* in = reinterpret_cast<const sockaddr_in*>(&address);
+        inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+        std::string name(host);
+        name += ':';
+        name += std::to_string(ntohs(in->sin_port));
+        return name;
+    }
+    if (address.ss_family == AF_INET6) {
+        const sockaddr_in6* in6 = reinterpret_cast<const sockaddr_in6*>(&address);
+        inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+        std::string name = "[";
+        name += host;
+        name += "]:";
+        name += std::to_string(ntohs(in6->sin6_port));
+        return name;
+    }
+    return "unix";
+}
+}
+
+Server::Server(int port) :
+    m_port(port) {
+}
+
+Server::Server(const std::string& address) :
+    m_address(address) {
+}
+
+Server::~Server() {
+    if (m_clientSocket != INVALID_SOCKET) {
+        m_networkHelper.close(m_clientSocket);
+    }
+}
+
+bool
+Server::Start() {
+    // Identidad de largo plazo: todas las sesiones comparten este par de claves
+    m_cryptoHelper.GenerateRSAKeys();
+    bool started = m_address.empty() ? m_networkHelper.StartSever(m_port) : m_networkHelper.StartSever(m_address);
+    if (!started) {
+        return false;
+    }
+    m_loop = std::make_unique<EventLoop>();
+    m_cryptoService = std::make_unique<CryptoService>();
+    return true;
+}
+
+void
+Server::WaitForClient() {
+    m_clientSocket = m_networkHelper.AcceptClient();
+    if (m_clientSocket == INVALID_SOCKET) {
+        return;
+    }
+
+    // Handshake: clave publica -> clave AES cifrada
+    NetworkHelper::SetReceiveTimeout(m_clientSocket, m_handshakeTimeout);
+    if (!m_networkHelper.ServerHandshake(m_clientSocket, m_cryptoHelper)) {
+        m_networkHelper.close(m_clientSocket);
+        m_clientSocket = INVALID_SOCKET;
+        return;
+    }
+    NetworkHelper::SetReceiveTimeout(m_clientSocket, m_idleTimeout);
+    std::cout << "Secure session established" << std::endl;
+}
+
+void
+Server::ReceiveEncryptedData() {
+    while (m_clientSocket != INVALID_SOCKET) {
+        std::optional<std::string> message = m_networkHelper.ReceiveEncrypted(m_clientSocket, m_cryptoHelper);
+        if (!message) {
+            break;
+        }
+        std::cout << "Client: " << *message << std::endl;
+    }
+    std::cout << "Client disconnected" << std::endl;
+}
+
+bool
+Server::ReceiveFile(const std::string& path) {
+    struct Stream {
+        SOCKET socket = INVALID_SOCKET;
+        CryptoHelper crypto;
+        bool received = false;
+    };
+    FileSink sink;
+    std::vector<std::unique_ptr<Stream>> streams;
+    std::vector<std::thread> threads;
+    // El primer stream dice cuantos hay; cada uno recibe en su hilo en cuanto
+    // se acepta. Un stream que no llega no bloquea: sus bloques los llevan los demas.
+    int expected = 1;
+    for (int attempt = 0; attempt < expected; ++attempt) {
+        if (attempt > 0) {
+            WSAPOLLFD wait{};
+            wait.fd = m_networkHelper.GetSocket();
+            wait.events = POLLIN;
+            if (WSAPoll(&wait, 1, FILE_STREAM_ACCEPT_TIMEOUT_MS) <= 0) {
+                break;
+            }
+        }
+        auto stream = std::make_unique<Stream>();
+        stream->socket = m_networkHelper.AcceptClient();
+        if (stream->socket == INVALID_SOCKET) {
+            break;
+        }
+        stream->crypto.ShareRSAKeys(m_cryptoHelper);
+        NetworkHelper::SetReceiveTimeout(stream->socket, m_handshakeTimeout);
+        if (!m_networkHelper.ServerHandshake(stream->socket, stream->crypto)
+            || !m_networkHelper.AcceptFileStream(stream->socket, stream->crypto, sink, path)) {
+            m_networkHelper.close(stream->socket);
+            continue;
+        }
+        NetworkHelper::SetReceiveTimeout(stream->socket, m_idleTimeout);
+        expected = sink.Info().streams;
+        threads.emplace_back([this, &sink, session = stream.get()] {
+            session->received = m_networkHelper.ReceiveFileStream(session->socket, session->crypto, sink);
+        });
+        streams.push_back(std::move(stream));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (std::unique_ptr<Stream>& stream : streams) {
+        m_networkHelper.close(stream->socket);
+    }
+    return sink.Finish();
+}
+
+bool
+Server::ReceiveSync(const std::string& path) {
+    WaitForClient();
+    if (m_clientSocket == INVALID_SOCKET) {
+        return false;
+    }
+    return m_networkHelper.ReceiveSync(m_clientSocket, m_cryptoHelper, path);
+}
+
+void
+Server::Run() {
+    if (!m_loop) {
+        std::cerr << "Server not started" << std::endl;
+        return;
+    }
+    m_listener = std::make_unique<AsyncListener>(*m_loop, m_networkHelper.GetSocket());
+    m_accepting = true;
+    Spawn(AcceptLoop());
+    m_loop->Run();
+}
+
+void
+Server::Stop() {
+    if (!m_loop) {
+        return;
+    }
+    m_loop->Post([this] {
+        m_stopping = true;
+        if (m_listener) {
+            m_listener->Close();
+        }
+        // El peer ve EOF y cada ServeClient termina por su cuenta
+        m_sessions.ForEach([](Session& session) { shutdown(session.socket, SD_BOTH); });
+        StopIfIdle();
+    });
+}
+
+void
+Server::SetCompression(bool enabled) {
+    m_compression = enabled;
+}
+
+void
+Server::SetBatching(size_t maxBytes, std::chrono::microseconds delay) {
+    m_batchMaxBytes = maxBytes;
+    m_batchDelay = delay;
+}
+
+void
+Server::SetTimeouts(std::chrono::milliseconds handshake, std::chrono::milliseconds idle,
+                    std::chrono::milliseconds heartbeat) {
+    m_handshakeTimeout = handshake;
+    m_idleTimeout = idle;
+    m_heartbeatInterval = heartbeat;
+}
+
+size_t
+Server::SessionCount() const {
+    return m_sessions.Size();
+}
+
+bool
+Server::VisitSession(uint64_t id, const std::function<void(const Session&)>& fn) const {
+    EpochGuard guard;
+    Session* session = m_sessions.Find(id, guard);
+    if (!session) {
+        return false;
+    }
+    fn(*session);
+    return true;
+}
+
+void
+Server::ForEachSession(const std::function<void(const Session&)>& fn) const {
+    m_sessions.ForEach([&fn](const Session& session) { fn(session); });
+}
+
+bool
+Server::Disconnect(uint64_t id) {
+    EventLoop* loop = nullptr;
+    {
+        EpochGuard guard;
+        if (Session* session = m_sessions.Find(id, guard)) {
+            loop = session->loop;
+        }
+    }
+    if (!loop) {
+        return false;
+    }
+    // El socket solo es valido en el hilo del bucle mientras la sesion siga
+    // en la tabla: desde otro hilo podria estar ya cerrado y reutilizado
+    loop->Post([this, id] {
+        EpochGuard guard;
+        if (Session* session = m_sessions.Find(id, guard)) {
+            shutdown(session->socket, SD_BOTH);
+        }
+    });
+    return true;
+}
+
+void
+Server::StopIfIdle() {
+    if (m_stopping && !m_accepting && m_sessions.Size() == 0) {
+        m_loop->Stop();
+    }
+}
+
+Task<void>
+Server::AcceptLoop() {
+    while (!m_stopping) {
+        SOCKET clientSocket = co_await m_listener->Accept();
+        if (clientSocket == INVALID_SOCKET) {
+            // Error transitorio (p. ej. sin descriptores): no girar en vacio
+            if (!m_stopping) {
+                co_await m_loop->SleepFor(std::chrono::milliseconds(10));
+            }
+            continue;
+        }
+        Spawn(ServeClient(clientSocket));
+    }
+    m_accepting = false;
+    StopIfIdle();
+}
+
+Task<void>
+Server::ServeClient(SOCKET socket) {
+    AsyncConnection connection(*m_loop, socket, m_networkHelper.GetTransport());
+    auto entry = std::make_unique<Session>();
+    entry->id = ++m_nextSessionId;
+    entry->socket = socket;
+    entry->peer = PeerName(socket);
+    entry->loop = m_loop.get();
+    entry->connected = std::chrono::steady_clock::now();
+    // Solo este hilo la borra: el puntero vale hasta el Erase del final
+    Session* session = entry.get();
+    m_sessions.Insert(std::move(entry));
+    connection.Crypto().ShareRSAKeys(m_cryptoHelper);
+    connection.Crypto().UseScheduleArena(m_scheduleArena);
+    connection.SetHandshakeTimeout(m_handshakeTimeout);
+    connection.SetIdleTimeout(m_idleTimeout);
+
+    if (co_await connection.Handshake(HandshakeRole::Server, m_cryptoService.get())) {
+        connection.SetHeartbeat(m_heartbeatInterval);
+        if (m_compression) {
+            connection.EnableCompression();
+        }
+        if (m_batchMaxBytes > 0) {
+            connection.EnableBatching(m_batchMaxBytes, m_batchDelay);
+        }
+        while (std::optional<std::string> message = co_await connection.RecvEncrypted()) {
+            session->messagesReceived.fetch_add(1, std::memory_order_relaxed);
+            session->bytesReceived.fetch_add(message->size(), std::memory_order_relaxed);
+            if (!co_await connection.SendEncrypted(*message)) {
+                break;
+            }
+        }
+        co_await connection.Flush();
+    }
+
+    m_sessions.Erase(session->id);
+    StopIfIdle();
+}
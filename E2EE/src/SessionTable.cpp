@@ -0,0 +1,125 @@
+#include "SessionTable.h"
+#include <algorithm>
+#include <bit>
+
+SessionTable::SessionTable(size_t capacity) :
+    m_table(NewTable(capacity)) {
+}
+
+SessionTable::~SessionTable() {
+    // Sin lectores: se libera todo directamente
+    Table* table = m_table.load(std::memory_order_acquire);
+    for (size_t i = 0; i <= table->mask; ++i) {
+        delete table->slots[i].value.load(std::memory_order_relaxed);
+    }
+    delete table;
+}
+
+SessionTable::Table*
+SessionTable::NewTable(size_t capacity) {
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 16));
+    return new Table{capacity - 1, std::make_unique<Slot[]>(capacity)};
+}
+
+size_t
+SessionTable::Home(uint64_t id, size_t mask) {
+    // Los id son consecutivos: Fibonacci los reparte por toda la tabla
+    return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+bool
+SessionTable::Insert(std::unique_ptr<Session> session) {
+    uint64_t id = session->id;
+    if (id == EMPTY || id == ERASED) {
+        throw std::invalid_argument("Invalid session id.");
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    Reserve();
+    Table* table = m_table.load(std::memory_order_relaxed);
+    for (size_t i = Home(id, table->mask);; i = (i + 1) & table->mask) {
+        Slot& slot = table->slots[i];
+        uint64_t key = slot.key.load(std::memory_order_relaxed);
+        if (key == id && slot.value.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (key == EMPTY) {
+            // El valor antes que la clave: quien vea la clave ve la sesion entera
+            slot.value.store(session.release(), std::memory_order_release);
+            slot.key.store(id, std::memory_order_release);
+            ++m_used;
+            m_size.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+bool
+SessionTable::Erase(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    Table* table = m_table.load(std::memory_order_relaxed);
+    for (size_t i = Home(id, table->mask);; i = (i + 1) & table->mask) {
+        Slot& slot = table->slots[i];
+        uint64_t key = slot.key.load(std::memory_order_relaxed);
+        if (key == EMPTY) {
+            return false;
+        }
+        if (key == id) {
+            Session* session = slot.value.exchange(nullptr, std::memory_order_acq_rel);
+            slot.key.store(ERASED, std::memory_order_release);
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+            EpochRetire([session] { delete session; });
+            return true;
+        }
+    }
+}
+
+Session*
+SessionTable::Find(uint64_t id, const EpochGuard&) const {
+    const Table* table = m_table.load(std::memory_order_acquire);
+    for (size_t i = Home(id, table->mask);; i = (i + 1) & table->mask) {
+        const Slot& slot = table->slots[i];
+        uint64_t key = slot.key.load(std::memory_order_acquire);
+        if (key == id) {
+            // nullptr si se acaba de borrar
+            return slot.value.load(std::memory_order_acquire);
+        }
+        if (key == EMPTY) {
+            return nullptr;
+        }
+    }
+}
+
+size_t
+SessionTable::Size() const {
+    return m_size.load(std::memory_order_relaxed);
+}
+
+void
+SessionTable::Reserve() {
+    Table* table = m_table.load(std::memory_order_relaxed);
+    size_t capacity = table->mask + 1;
+    if ((m_used + 1) * 10 <= capacity * 7) {
+        return;
+    }
+    // Si lo que sobra son borradas basta con limpiarlas sin crecer
+    size_t live = m_size.load(std::memory_order_relaxed);
+    Table* next = NewTable((live + 1) * 10 > capacity * 7 / 2 ? capacity * 2 : capacity);
+    for (size_t i = 0; i <= table->mask; ++i) {
+        Session* session = table->slots[i].value.load(std::memory_order_relaxed);
+        if (!session) {
+            continue;
+        }
+        for (size_t j = Home(session->id, next->mask);; j = (j + 1) & next->mask) {
+            Slot& slot = next->slots[j];
+            if (slot.key.load(std::memory_order_relaxed) == EMPTY) {
+                slot.value.store(session, std::memory_order_relaxed);
+                slot.key.store(session->id, std::memory_order_relaxed);
+                break;
+            }
+        }
+    }
+    m_used = live;
+    // La tabla nueva se publica ya completa; la vieja puede seguir leyendose
+    m_table.store(next, std::memory_order_release);
+    EpochRetire([table] { delete table; });
+}
@@ -0,0 +1,539 @@
+#include "ShmChannel.h"
+#include "Metrics.h"
+#include <atomic>
+#include <new>
+#include <thread>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+constexpr uint32_t SHM_MAGIC = 0x45324553; // "E2ES"
+constexpr uint32_t PADDING_RECORD = 0xFFFFFFFF;
+// Registro en el anillo: [longitud u32][tipo u32][payload], alineado a 8 bytes
+constexpr size_t RECORD_HEADER_SIZE = 8;
+constexpr size_t CACHE_LINE = 64;
+constexpr size_t PAGE_SIZE = 4096;
+
+size_t
+Align(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// Con un solo nucleo el peer no avanza mientras se gira: dormir de inmediato
+int
+SpinIterations() {
+    static const int iterations = std::thread::hardware_concurrency() > 1 ? 4096 : 0;
+    return iterations;
+}
+
+void
+CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+struct alignas(CACHE_LINE) SharedCounter {
+    std::atomic<uint64_t> value;
+};
+
+struct alignas(CACHE_LINE) SharedFlag {
+    std::atomic<uint32_t> value;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ShmChannel needs lock-free 64-bit atomics");
+}
+
+// Cabecera de la region. El anillo i lo escribe el lado i: head[i] es del
+// productor, tail[i] del consumidor y cada uno ocupa su propia linea de cache.
+struct ShmChannel::Region {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t ringSize;
+    SharedCounter head[2];
+    SharedCounter tail[2];
+    SharedFlag sleeping[2]; // el lado i va a dormir en su eventfd
+    SharedFlag closed[2];
+};
+
+#ifdef __linux__
+ShmChannel::ShmChannel(int memory, int wakeZero, int wakeOne, int side) :
+    m_memory(memory), m_wake{wakeZero, wakeOne}, m_side(side) {
+}
+
+ShmChannel::~ShmChannel() {
+    if (m_region) {
+        Close();
+        munmap(m_region, m_regionSize);
+    }
+    ::close(m_memory);
+    ::close(m_wake[0]);
+    ::close(m_wake[1]);
+}
+
+std::unique_ptr<ShmChannel>
+ShmChannel::Create(size_t ringSize) {
+    size_t size = PAGE_SIZE;
+    while (size < ringSize) {
+        size <<= 1;
+    }
+    size_t regionSize = Align(sizeof(Region), PAGE_SIZE) + 2 * size;
+
+    int memory = memfd_create("e2ee-shm", MFD_CLOEXEC);
+    if (memory == -1 || ftruncate(memory, static_cast<off_t>(regionSize)) == -1) {
+        std::cerr << "Error creating shared memory: " << errno << std::endl;
+        if (memory != -1) {
+            ::close(memory);
+        }
+        return nullptr;
+    }
+    int wakeZero = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    int wakeOne = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    std::unique_ptr<ShmChannel> channel(new ShmChannel(memory, wakeZero, wakeOne, 0));
+    if (wakeZero == -1 || wakeOne == -1) {
+        std::cerr << "Error creating eventfd: " << errno << std::endl;
+        return nullptr;
+    }
+
+    void* base = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+    if (base == MAP_FAILED) {
+        std::cerr << "Error mapping shared memory: " << errno << std::endl;
+        return nullptr;
+    }
+    // ftruncate deja la region a cero: contadores y banderas ya valen 0
+    Region* region = new (base) Region;
+    region->ringSize = size;
+    region->magic = SHM_MAGIC;
+    munmap(base, regionSize);
+
+    if (!channel->Map()) {
+        return nullptr;
+    }
+    return channel;
+}
+
+bool
+ShmChannel::Map() {
+    struct stat info;
+    if (fstat(m_memory, &info) == -1 || static_cast<size_t>(info.st_size) < sizeof(Region)) {
+        std::cerr << "Invalid shared memory region" << std::endl;
+        return false;
+    }
+    void* base = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_memory, 0);
+    if (base == MAP_FAILED) {
+        std::cerr << "Error mapping shared memory: " << errno << std::endl;
+        return false;
+    }
+    Region* region = static_cast<Region*>(base);
+    size_t ringOffset = Align(sizeof(Region), PAGE_SIZE);
+    // La region puede venir de otro proceso: el enmascarado de posiciones
+    // necesita una potencia de dos de al menos una pagina
+    uint64_t ringSize = region->ringSize;
+    size_t mapped = static_cast<size_t>(info.st_size);
+    if (region->magic != SHM_MAGIC || ringSize < PAGE_SIZE || (ringSize & (ringSize - 1)) != 0
+        || mapped < ringOffset || ringSize > (mapped - ringOffset) / 2 || ringOffset + 2 * ringSize != mapped) {
+        std::cerr << "Invalid shared memory region" << std::endl;
+        munmap(base, info.st_size);
+        return false;
+    }
+    m_region = region;
+    m_regionSize = info.st_size;
+    m_ringSize = static_cast<size_t>(ringSize);
+    m_rings[0] = static_cast<unsigned char*>(base) + ringOffset;
+    m_rings[1] = m_rings[0] + m_ringSize;
+    return true;
+}
+
+std::unique_ptr<ShmChannel>
+ShmChannel::OpenPeer() const {
+    std::unique_ptr<ShmChannel> peer(new ShmChannel(dup(m_memory), dup(m_wake[0]), dup(m_wake[1]), 1 - m_side));
+    if (!peer->Map()) {
+        return nullptr;
+    }
+    return peer;
+}
+
+bool
+ShmChannel::SendTo(SOCKET unixSocket) const {
+    int descriptors[3] = {m_memory, m_wake[0], m_wake[1]};
+    unsigned char side = static_cast<unsigned char>(1 - m_side);
+    iovec data{&side, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(descriptors))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(descriptors));
+    std::memcpy(CMSG_DATA(header), descriptors, sizeof(descriptors));
+    if (sendmsg(unixSocket, &message, MSG_NOSIGNAL) != 1) {
+        std::cerr << "Error sending shared memory descriptors: " << errno << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<ShmChannel>
+ShmChannel::ReceiveFrom(SOCKET unixSocket) {
+    int descriptors[3];
+    unsigned char side = 0;
+    iovec data{&side, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(descriptors))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(unixSocket, &message, MSG_CMSG_CLOEXEC) != 1) {
+        std::cerr << "Error receiving shared memory descriptors: " << errno << std::endl;
+        return nullptr;
+    }
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+        || header->cmsg_len != CMSG_LEN(sizeof(descriptors)) || side > 1) {
+        std::cerr << "Invalid shared memory handoff" << std::endl;
+        return nullptr;
+    }
+    std::memcpy(descriptors, CMSG_DATA(header), sizeof(descriptors));
+    std::unique_ptr<ShmChannel> channel(new ShmChannel(descriptors[0], descriptors[1], descriptors[2], side));
+    if (!channel->Map()) {
+        return nullptr;
+    }
+    return channel;
+}
+
+template <typename Ready>
+bool
+ShmChannel::Wait(Ready ready) {
+    for (int i = 0; i < SpinIterations(); ++i) {
+        if (ready()) {
+            return true;
+        }
+        CpuRelax();
+    }
+    std::atomic<uint32_t>& sleeping = m_region->sleeping[m_side].value;
+    for (;;) {
+        // Anunciar el sueno y volver a mirar: el peer publica y luego lee la
+        // bandera, asi que uno de los dos ve al otro (barreras seq_cst)
+        sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ready()) {
+            sleeping.store(0, std::memory_order_relaxed);
+            return true;
+        }
+        pollfd wake{m_wake[m_side], POLLIN, 0};
+        if (::poll(&wake, 1, -1) == -1 && errno != EINTR) {
+            sleeping.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        uint64_t count;
+        while (::read(m_wake[m_side], &count, sizeof(count)) == -1 && errno == EINTR) {
+        }
+        sleeping.store(0, std::memory_order_relaxed);
+        if (ready()) {
+            return true;
+        }
+    }
+}
+
+void
+ShmChannel::Notify() {
+    int peer = 1 - m_side;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_region->sleeping[peer].value.load(std::memory_order_relaxed)) {
+        uint64_t one = 1;
+        while (::write(m_wake[peer], &one, sizeof(one)) == -1 && errno == EINTR) {
+        }
+    }
+}
+
+void
+ShmChannel::Close() {
+    if (!m_region->closed[m_side].value.exchange(1, std::memory_order_release)) {
+        Notify();
+    }
+}
+#else
+ShmChannel::ShmChannel(int memory, int wakeZero, int wakeOne, int side) :
+    m_memory(memory), m_wake{wakeZero, wakeOne}, m_side(side) {
+}
+
+ShmChannel::~ShmChannel() = default;
+
+std::unique_ptr<ShmChannel>
+ShmChannel::Create(size_t) {
+    std::cerr << "Shared-memory channels require Linux" << std::endl;
+    return nullptr;
+}
+
+bool
+ShmChannel::Map() {
+    return false;
+}
+
+std::unique_ptr<ShmChannel>
+ShmChannel::OpenPeer() const {
+    return nullptr;
+}
+
+bool
+ShmChannel::SendTo(SOCKET) const {
+    return false;
+}
+
+std::unique_ptr<ShmChannel>
+ShmChannel::ReceiveFrom(SOCKET) {
+    std::cerr << "Shared-memory channels require Linux" << std::endl;
+    return nullptr;
+}
+
+template <typename Ready>
+bool
+ShmChannel::Wait(Ready ready) {
+    return ready();
+}
+
+void
+ShmChannel::Notify() {
+}
+
+void
+ShmChannel::Close() {
+}
+#endif
+
+bool
+ShmChannel::PeerClosed() const {
+    return m_corrupt || m_region->closed[1 - m_side].value.load(std::memory_order_acquire) != 0;
+}
+
+void
+ShmChannel::MarkCorrupt() {
+    if (!m_corrupt) {
+        std::cerr << "Corrupt shared-memory ring, closing channel" << std::endl;
+        m_corrupt = true;
+        Close();
+    }
+}
+
+size_t
+ShmChannel::MaxFrameSize() const {
+    return m_ringSize - RECORD_HEADER_SIZE;
+}
+
+unsigned char*
+ShmChannel::TryReserve(size_t size) {
+    size_t need = Align(RECORD_HEADER_SIZE + size, RECORD_HEADER_SIZE);
+    if (need > m_ringSize || PeerClosed()) {
+        return nullptr;
+    }
+    std::atomic<uint64_t>& head = m_region->head[m_side].value;
+    std::atomic<uint64_t>& tail = m_region->tail[m_side].value;
+    unsigned char* ring = m_rings[m_side];
+    uint64_t position = head.load(std::memory_order_relaxed);
+    for (;;) {
+        // El peer tambien puede escribir en la region: cuenta como corrupto
+        // un tail que no deje un hueco posible o una posicion desalineada
+        uint64_t used = position - tail.load(std::memory_order_acquire);
+        size_t offset = static_cast<size_t>(position & (m_ringSize - 1));
+        if (used > m_ringSize || offset % RECORD_HEADER_SIZE != 0) {
+            MarkCorrupt();
+            return nullptr;
+        }
+        size_t available = m_ringSize - static_cast<size_t>(used);
+        size_t toEnd = m_ringSize - offset;
+        if (need <= toEnd) {
+            if (available < need) {
+                return nullptr;
+            }
+            m_reserved = need;
+            m_reservedPosition = position;
+            return ring + offset + RECORD_HEADER_SIZE;
+        }
+        // No cabe contiguo: se rellena hasta el final y se sigue desde el principio
+        if (available < toEnd) {
+            return nullptr;
+        }
+        uint32_t padding = PADDING_RECORD;
+        std::memcpy(ring + offset, &padding, sizeof(padding));
+        position += toEnd;
+        head.store(position, std::memory_order_release);
+        Notify();
+    }
+}
+
+void
+ShmChannel::Commit(FrameType type, size_t size) {
+    std::atomic<uint64_t>& head = m_region->head[m_side].value;
+    // La posicion de TryReserve, no la de la region: el peer no la mueve
+    uint64_t position = m_reservedPosition;
+    unsigned char* record = m_rings[m_side] + (position & (m_ringSize - 1));
+    uint32_t fields[2] = {static_cast<uint32_t>(size), static_cast<uint32_t>(type)};
+    std::memcpy(record, fields, sizeof(fields));
+    head.store(position + Align(RECORD_HEADER_SIZE + size, RECORD_HEADER_SIZE), std::memory_order_release);
+    m_reserved = 0;
+    Notify();
+}
+
+const unsigned char*
+ShmChannel::TryPeek(FrameType& type, size_t& size) {
+    int peer = 1 - m_side;
+    std::atomic<uint64_t>& head = m_region->head[peer].value;
+    std::atomic<uint64_t>& tail = m_region->tail[peer].value;
+    unsigned char* ring = m_rings[peer];
+    if (m_corrupt) {
+        return nullptr;
+    }
+    uint64_t position = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        uint64_t published = head.load(std::memory_order_acquire);
+        if (position == published) {
+            return nullptr;
+        }
+        // Todo lo que viene del peer se copia y se valida antes de usarlo:
+        // un registro debe caber en lo publicado y no pasar del final del anillo
+        uint64_t pending = published - position;
+        size_t offset = static_cast<size_t>(position & (m_ringSize - 1));
+        if (pending > m_ringSize || offset % RECORD_HEADER_SIZE != 0) {
+            MarkCorrupt();
+            return nullptr;
+        }
+        size_t toEnd = m_ringSize - offset;
+        uint32_t fields[2];
+        std::memcpy(fields, ring + offset, sizeof(fields));
+        if (fields[0] == PADDING_RECORD) {
+            if (toEnd > pending) {
+                MarkCorrupt();
+                return nullptr;
+            }
+            position += toEnd;
+            tail.store(position, std::memory_order_release);
+            Notify();
+            continue;
+        }
+        size_t length = fields[0];
+        size_t record = Align(RECORD_HEADER_SIZE + length, RECORD_HEADER_SIZE);
+        if (RECORD_HEADER_SIZE + length > toEnd || record > pending) {
+            MarkCorrupt();
+            return nullptr;
+        }
+        type = static_cast<FrameType>(fields[1]);
+        size = length;
+        m_peeked = record;
+        return ring + offset + RECORD_HEADER_SIZE;
+    }
+}
+
+void
+ShmChannel::Release() {
+    std::atomic<uint64_t>& tail = m_region->tail[1 - m_side].value;
+    tail.store(tail.load(std::memory_order_relaxed) + m_peeked, std::memory_order_release);
+    m_peeked = 0;
+    Notify();
+}
+
+unsigned char*
+ShmChannel::Reserve(size_t size) {
+    if (size > MaxFrameSize()) {
+        std::cerr << "Frame too large for shared-memory ring: " << size << std::endl;
+        return nullptr;
+    }
+    unsigned char* buffer = nullptr;
+    Wait([&] {
+        buffer = TryReserve(size);
+        return buffer != nullptr || PeerClosed();
+    });
+    return buffer;
+}
+
+const unsigned char*
+ShmChannel::Peek(FrameType& type, size_t& size) {
+    const unsigned char* payload = nullptr;
+    Wait([&] {
+        payload = TryPeek(type, size);
+        return payload != nullptr || PeerClosed();
+    });
+    // Lo publicado antes del cierre sigue siendo legible
+    return payload ? payload : TryPeek(type, size);
+}
+
+bool
+ShmChannel::SendFrame(FrameType type, const unsigned char* payload, size_t size) {
+    LatencyTimer timer(MetricStage::Send);
+    unsigned char* buffer = Reserve(size);
+    if (!buffer) {
+        timer.Cancel();
+        Metrics::Add(MetricCounter::SendErrors);
+        return false;
+    }
+    if (size) {
+        std::memcpy(buffer, payload, size);
+    }
+    Commit(type, size);
+    Metrics::Add(MetricCounter::BytesSent, RECORD_HEADER_SIZE + size);
+    Metrics::Add(MetricCounter::MessagesSent);
+    return true;
+}
+
+bool
+ShmChannel::ReceiveFrame(Frame& frame) {
+    size_t size;
+    const unsigned char* payload = Peek(frame.type, size);
+    if (!payload) {
+        return false;
+    }
+    // Se mide desde que la trama esta disponible, como en NetworkHelper
+    LatencyTimer timer(MetricStage::Receive);
+    frame.payload.assign(payload, payload + size);
+    Release();
+    Metrics::Add(MetricCounter::BytesReceived, RECORD_HEADER_SIZE + size);
+    Metrics::Add(MetricCounter::MessagesReceived);
+    return true;
+}
+
+bool
+ShmChannel::SendEncrypted(CryptoHelper& crypto, const std::string& plaintext) {
+    size_t size = DataPayloadSize(plaintext.size());
+    unsigned char* buffer = Reserve(size);
+    if (!buffer) {
+        Metrics::Add(MetricCounter::SendErrors);
+        return false;
+    }
+    SealDataPayload(crypto, reinterpret_cast<const unsigned char*>(plaintext.data()), plaintext.size(), buffer);
+    Commit(FrameType::Data, size);
+    Metrics::Add(MetricCounter::BytesSent, RECORD_HEADER_SIZE + size);
+    Metrics::Add(MetricCounter::MessagesSent);
+    return true;
+}
+
+std::optional<std::string>
+ShmChannel::ReceiveEncrypted(CryptoHelper& crypto) {
+    for (;;) {
+        FrameType type;
+        size_t size;
+        const unsigned char* payload = Peek(type, size);
+        if (!payload) {
+            return std::nullopt;
+        }
+        Metrics::Add(MetricCounter::BytesReceived, RECORD_HEADER_SIZE + size);
+        Metrics::Add(MetricCounter::MessagesReceived);
+        if (type != FrameType::Data) {
+            Release();
+            continue;
+        }
+        std::optional<std::string> plaintext = OpenDataPayload(crypto, payload, size);
+        Release();
+        return plaintext;
+    }
+}
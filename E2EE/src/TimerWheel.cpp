@@ -0,0 +1,232 @@
+#include "TimerWheel.h"
+#include <algorithm>
+#include <bit>
+
+namespace {
+// Distancia desde from a la primera ranura ocupada, dando la vuelta; -1 si no hay
+int
+NextOccupied(const std::array<uint64_t, 4>& bits, unsigned from) {
+    for (unsigned scanned = 0; scanned < 256 + 64;) {
+        unsigned slot = (from + scanned) & 255;
+        uint64_t word = bits[slot >> 6] >> (slot & 63);
+        if (word) {
+            unsigned distance = scanned + static_cast<unsigned>(std::countr_zero(word));
+            return distance < 256 ? static_cast<int>(distance) : -1;
+        }
+        scanned += 64 - (slot & 63);
+    }
+    return -1;
+}
+}
+
+TimerWheel::TimerWheel() : m_start(Clock::now()) {
+    m_heads.fill(NONE);
+    m_tails.fill(NONE);
+}
+
+TimerWheel::TimerId
+TimerWheel::Add(Clock::time_point deadline, std::function<void()> fn) {
+    uint32_t index = m_heads[FREE_LIST];
+    if (index != NONE) {
+        Unlink(index);
+    } else {
+        if (m_nodes.size() >= NONE) {
+            throw std::runtime_error("Too many timers.");
+        }
+        index = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    Node& node = m_nodes[index];
+    node.fn = std::move(fn);
+    node.expiry = TickFor(deadline, true);
+    Place(index);
+    ++m_size;
+    return (static_cast<uint64_t>(node.generation) << 32) | index;
+}
+
+bool
+TimerWheel::Cancel(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id);
+    if (index >= m_nodes.size() || m_nodes[index].generation != static_cast<uint32_t>(id >> 32)
+        || m_nodes[index].list == FREE_LIST) {
+        return false;
+    }
+    Unlink(index);
+    Release(index);
+    return true;
+}
+
+void
+TimerWheel::Advance(Clock::time_point now) {
+    uint64_t target = TickFor(now, false);
+    while (m_current <= target) {
+        // Se salta de golpe hasta el siguiente tick con trabajo
+        uint64_t distance = m_size ? NextEventDistance() : UINT64_MAX;
+        if (distance > target - m_current) {
+            m_current = target + 1;
+            return;
+        }
+        m_current += distance;
+        ProcessTick();
+        ++m_current;
+    }
+}
+
+bool
+TimerWheel::PopExpired(std::function<void()>& fn) {
+    uint32_t index = m_heads[EXPIRED_LIST];
+    if (index == NONE) {
+        return false;
+    }
+    fn = std::move(m_nodes[index].fn);
+    Unlink(index);
+    Release(index);
+    return true;
+}
+
+TimerWheel::Clock::time_point
+TimerWheel::NextWakeup() const {
+    if (m_heads[EXPIRED_LIST] != NONE) {
+        return Clock::time_point::min();
+    }
+    uint64_t distance = m_size ? NextEventDistance() : UINT64_MAX;
+    if (distance == UINT64_MAX) {
+        return Clock::time_point::max();
+    }
+    return m_start + Clock::duration(TIMER_WHEEL_TICK) * static_cast<Clock::rep>(m_current + distance);
+}
+
+size_t
+TimerWheel::Size() const {
+    return m_size;
+}
+
+uint64_t
+TimerWheel::TickFor(Clock::time_point time, bool roundUp) const {
+    if (time <= m_start) {
+        return 0;
+    }
+    Clock::rep elapsed = (time - m_start).count();
+    Clock::rep tick = Clock::duration(TIMER_WHEEL_TICK).count();
+    return static_cast<uint64_t>(elapsed / tick + (roundUp && elapsed % tick ? 1 : 0));
+}
+
+void
+TimerWheel::Place(uint32_t index) {
+    // Lo ya vencido sale en el siguiente tick; lo que no cabe en la rueda se
+    // coloca al final y se vuelve a colocar al llegar
+    uint64_t expiry = std::max(m_nodes[index].expiry, m_current);
+    uint64_t delta = std::min<uint64_t>(expiry - m_current, (uint64_t(1) << (LEVELS * LEVEL_BITS)) - 1);
+    uint64_t target = m_current + delta;
+    int level = 0;
+    while (level + 1 < LEVELS && delta >= (uint64_t(1) << ((level + 1) * LEVEL_BITS))) {
+        ++level;
+    }
+    Link(index, level * SLOTS + ((target >> (level * LEVEL_BITS)) & (SLOTS - 1)));
+}
+
+void
+TimerWheel::Link(uint32_t index, size_t list) {
+    Node& node = m_nodes[index];
+    node.list = static_cast<uint32_t>(list);
+    node.prev = m_tails[list];
+    node.next = NONE;
+    if (node.prev != NONE) {
+        m_nodes[node.prev].next = index;
+    } else {
+        m_heads[list] = index;
+    }
+    m_tails[list] = index;
+    if (list < EXPIRED_LIST) {
+        m_occupied[list / SLOTS][(list % SLOTS) >> 6] |= uint64_t(1) << (list & 63);
+    }
+}
+
+void
+TimerWheel::Unlink(uint32_t index) {
+    Node& node = m_nodes[index];
+    size_t list = node.list;
+    if (node.prev != NONE) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_heads[list] = node.next;
+    }
+    if (node.next != NONE) {
+        m_nodes[node.next].prev = node.prev;
+    } else {
+        m_tails[list] = node.prev;
+    }
+    node.prev = node.next = NONE;
+    if (list < EXPIRED_LIST && m_heads[list] == NONE) {
+        m_occupied[list / SLOTS][(list % SLOTS) >> 6] &= ~(uint64_t(1) << (list & 63));
+    }
+}
+
+void
+TimerWheel::Release(uint32_t index) {
+    Node& node = m_nodes[index];
+    node.fn = nullptr;
+    if (++node.generation == 0) {
+        node.generation = 1;
+    }
+    Link(index, FREE_LIST);
+    --m_size;
+}
+
+void
+TimerWheel::Cascade(int level) {
+    size_t list = level * SLOTS + ((m_current >> (level * LEVEL_BITS)) & (SLOTS - 1));
+    uint32_t index = m_heads[list];
+    m_heads[list] = m_tails[list] = NONE;
+    m_occupied[level][(list % SLOTS) >> 6] &= ~(uint64_t(1) << (list & 63));
+    while (index != NONE) {
+        uint32_t next = m_nodes[index].next;
+        Place(index);
+        index = next;
+    }
+}
+
+void
+TimerWheel::ProcessTick() {
+    // De arriba abajo: lo que baja de un nivel puede caer en la ranura que
+    // toca repartir en el siguiente
+    for (int level = LEVELS - 1; level > 0; --level) {
+        if ((m_current & ((uint64_t(1) << (level * LEVEL_BITS)) - 1)) == 0) {
+            Cascade(level);
+        }
+    }
+    size_t list = m_current & (SLOTS - 1);
+    uint32_t index = m_heads[list];
+    m_heads[list] = m_tails[list] = NONE;
+    m_occupied[0][list >> 6] &= ~(uint64_t(1) << (list & 63));
+    while (index != NONE) {
+        uint32_t next = m_nodes[index].next;
+        if (m_nodes[index].expiry > m_current) {
+            Place(index);
+        } else {
+            Link(index, EXPIRED_LIST);
+        }
+        index = next;
+    }
+}
+
+uint64_t
+TimerWheel::NextEventDistance() const {
+    uint64_t best = UINT64_MAX;
+    int slot = NextOccupied(m_occupied[0], m_current & (SLOTS - 1));
+    if (slot >= 0) {
+        best = static_cast<uint64_t>(slot);
+    }
+    // En los niveles de arriba, el reparto de la siguiente ranura ocupada
+    // (la actual si m_current cae justo en su frontera)
+    for (int level = 1; level < LEVELS; ++level) {
+        int shift = level * LEVEL_BITS;
+        uint64_t base = m_current >> shift;
+        uint64_t first = (m_current & ((uint64_t(1) << shift) - 1)) == 0 ? 0 : 1;
+        int found = NextOccupied(m_occupied[level], static_cast<unsigned>((base + first) & (SLOTS - 1)));
+        if (found >= 0) {
+            best = std::min(best, ((base + first + found) << shift) - m_current);
+        }
+    }
+    return best;
+}
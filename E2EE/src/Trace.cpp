@@ -0,0 +1,162 @@
+#include "Trace.h"
+#include <memory>
+#include <mutex>
+
+std::atomic<bool> Trace::s_enabled{false};
+
+namespace {
+// Cada ranura lleva un numero de secuencia (seqlock): impar mientras el
+// escritor la rellena, 2 * (indice + 1) cuando esta completa. El lector
+// descarta las ranuras que cambian mientras las copia.
+struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> connection{0};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+struct Ring {
+    std::atomic<bool> owned{true};
+    uint32_t threadId = 0;
+    std::atomic<uint64_t> head{0}; // total de spans escritos
+    std::unique_ptr<Slot[]> slots{new Slot[Trace::RING_CAPACITY]};
+
+    void
+    Push(const char* name, uint64_t connection, uint64_t start, uint64_t end) {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[index % Trace::RING_CAPACITY];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.connection.store(connection, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        head.store(index + 1, std::memory_order_release);
+    }
+};
+
+class
+    Registry {
+public:
+    static Registry&
+    Instance() {
+        // Nunca se destruye: los hilos pueden trazar durante la salida
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    Ring*
+    Acquire() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Se reutiliza el anillo de un hilo terminado (y su tid); sus spans siguen visibles
+        for (const std::unique_ptr<Ring>& ring : m_rings) {
+            if (!ring->owned.load(std::memory_order_relaxed)) {
+                ring->owned.store(true, std::memory_order_relaxed);
+                return ring.get();
+            }
+        }
+        m_rings.push_back(std::make_unique<Ring>());
+        m_rings.back()->threadId = m_nextThreadId++;
+        return m_rings.back().get();
+    }
+
+    void
+    Release(Ring* ring) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ring->owned.store(false, std::memory_order_relaxed);
+    }
+
+    template <typename Fn>
+    void
+    ForEach(Fn fn) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const std::unique_ptr<Ring>& ring : m_rings) {
+            fn(*ring);
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    uint32_t m_nextThreadId = 1;
+};
+
+struct RingOwner {
+    Ring* ring = Registry::Instance().Acquire();
+
+    ~RingOwner() {
+        Registry::Instance().Release(ring);
+    }
+};
+
+Ring&
+LocalRing() {
+    thread_local RingOwner owner;
+    return *owner.ring;
+}
+
+const std::chrono::steady_clock::time_point PROCESS_START = std::chrono::steady_clock::now();
+std::atomic<uint64_t> g_nextConnectionId{1};
+
+void
+WriteMicroseconds(std::ostream& out, uint64_t nanoseconds) {
+    out << nanoseconds / 1000 << '.' << static_cast<char>('0' + nanoseconds / 100 % 10)
+        << static_cast<char>('0' + nanoseconds / 10 % 10) << static_cast<char>('0' + nanoseconds % 10);
+}
+}
+
+void
+Trace::SetEnabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t
+Trace::NewConnectionId() {
+    return g_nextConnectionId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+Trace::Record(const char* name, uint64_t connection, uint64_t startNs, uint64_t endNs) {
+    LocalRing().Push(name, connection, startNs, endNs);
+}
+
+uint64_t
+Trace::Now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - PROCESS_START).count());
+}
+
+void
+Trace::WriteChromeJson(std::ostream& out) {
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    Registry::Instance().ForEach([&](Ring& ring) {
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        uint64_t begin = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+        for (uint64_t index = begin; index < head; ++index) {
+            Slot& slot = ring.slots[index % RING_CAPACITY];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * index + 2) {
+                continue; // sobrescrita o a medio escribir
+            }
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            uint64_t connection = slot.connection.load(std::memory_order_relaxed);
+            uint64_t start = slot.start.load(std::memory_order_relaxed);
+            uint64_t end = slot.end.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence || !name) {
+                continue;
+            }
+
+            out << (first ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"handshake\",\"ph\":\"X\",\"ts\":";
+            WriteMicroseconds(out, start);
+            out << ",\"dur\":";
+            WriteMicroseconds(out, end > start ? end - start : 0);
+            out << ",\"pid\":1,\"tid\":" << ring.threadId << ",\"args\":{\"connection\":" << connection << "}}";
+            first = false;
+        }
+    });
+    out << "\n]}\n";
+}
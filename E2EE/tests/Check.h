@@ -0,0 +1,74 @@
+#pragma once
+// Pruebas sin framework: cada CHECK que falla se informa con su linea y
+// RunTests devuelve 1 si fallo alguno. Un ejecutable por modulo (ctest).
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+inline int g_checkFailures = 0;
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" \
+                      << std::endl;                                                       \
+            ++g_checkFailures;                                                            \
+        }                                                                                 \
+    } while (0)
+
+using Bytes = std::vector<unsigned char>;
+
+// Ruta unica en el directorio temporal. Al salir se borra junto con los
+// archivos que el modulo crea a su lado (path + ".resume", ".chunks"...).
+struct TempPath {
+    std::string path;
+
+    explicit TempPath(const char* name) :
+        path((std::filesystem::temp_directory_path()
+              / ("e2ee-" + std::string(name) + "-" + std::to_string(std::random_device{}()))).string()) {
+    }
+
+    ~TempPath() {
+        std::error_code error;
+        std::filesystem::path base(path);
+        std::string prefix = base.filename().string();
+        for (const auto& entry : std::filesystem::directory_iterator(base.parent_path(), error)) {
+            if (entry.path().filename().string().compare(0, prefix.size(), prefix) == 0) {
+                std::filesystem::remove(entry.path(), error);
+            }
+        }
+    }
+
+    TempPath(const TempPath&) = delete;
+    TempPath& operator=(const TempPath&) = delete;
+};
+
+inline Bytes
+ReadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return Bytes(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+inline void
+WriteFile(const std::string& path, const Bytes& contents) {
+    std::ofstream(path, std::ios::binary)
+        .write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+}
+
+using TestCase = std::pair<const char*, void (*)()>;
+
+template<size_t N>
+int
+RunTests(const TestCase (&tests)[N]) {
+    for (const auto& [name, test] : tests) {
+        int before = g_checkFailures;
+        test();
+        std::cout << (g_checkFailures == before ? "PASS " : "FAIL ") << name << std::endl;
+    }
+    return g_checkFailures == 0 ? 0 : 1;
+}
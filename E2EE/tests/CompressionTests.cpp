@@ -0,0 +1,117 @@
+// Bloques LZ de Compression: ida y vuelta, coincidencias solapadas y
+// bloques mal formados
+#include "Check.h"
+#include "Compression.h"
+#include "Protocol.h"
+
+namespace {
+bool
+Decompress(const Bytes& block, size_t outSize, Bytes& out) {
+    out.assign(outSize, 0);
+    return DecompressBlock(block.data(), block.size(), out.data(), outSize);
+}
+
+void
+TestDecompressRoundTrip() {
+    Bytes input;
+    for (int i = 0; i < 4096; ++i) {
+        input.push_back(static_cast<unsigned char>("abcabcabd"[i % 9] + (i / 1000)));
+    }
+    Bytes block(input.size());
+    size_t size = CompressBlock(input.data(), input.size(), block.data(), block.size());
+    CHECK(size != 0 && size < input.size());
+    block.resize(size);
+    Bytes out;
+    CHECK(Decompress(block, input.size(), out) && out == input);
+    // Un byte de menos o de mas en la salida esperada tambien es un error
+    CHECK(!Decompress(block, input.size() - 1, out));
+    CHECK(!Decompress(block, input.size() + 1, out));
+}
+
+void
+TestDecompressOverlappingMatch() {
+    Bytes out;
+    // "a" y coincidencia de offset 1 y longitud 4 + 6: "a" repetida 11 veces
+    CHECK(Decompress({0x16, 'a', 0x01, 0x00}, 11, out) && out == Bytes(11, 'a'));
+    // "ab" y offset 2, longitud 4 + 15 + 3 (longitud extendida): "ab" * 12
+    Bytes expected;
+    for (int i = 0; i < 24; ++i) {
+        expected.push_back(i % 2 ? 'b' : 'a');
+    }
+    CHECK(Decompress({0x2F, 'a', 'b', 0x02, 0x00, 0x03}, expected.size(), out) && out == expected);
+    // Offset igual a la longitud: copia sin solape
+    CHECK(Decompress({0x40, 'w', 'x', 'y', 'z', 0x04, 0x00}, 8, out) && out == Bytes({'w', 'x', 'y', 'z',
+                                                                                       'w', 'x', 'y', 'z'}));
+}
+
+void
+TestDecompressMalformed() {
+    Bytes out;
+    // Offset 0
+    CHECK(!Decompress({0x10, 'a', 0x00, 0x00}, 5, out));
+    // Offset anterior al principio de la salida
+    CHECK(!Decompress({0x10, 'a', 0x02, 0x00}, 5, out));
+    // Mas literales de los que quedan en la entrada
+    CHECK(!Decompress({0x50, 'a', 'b'}, 5, out));
+    // Literales que no caben en la salida
+    CHECK(!Decompress({0x30, 'a', 'b', 'c'}, 2, out));
+    // Coincidencia que pasa del final de la salida
+    CHECK(!Decompress({0x16, 'a', 0x01, 0x00}, 10, out));
+    // Offset cortado
+    CHECK(!Decompress({0x10, 'a', 0x01}, 5, out));
+    // Longitud extendida de literales sin sus bytes
+    CHECK(!Decompress({0xF0}, 20, out));
+    CHECK(!Decompress({0xF0, 0xFF, 0xFF}, 600, out));
+    // Longitud extendida de la coincidencia sin sus bytes
+    CHECK(!Decompress({0x1F, 'a', 0x01, 0x00}, 30, out));
+    // Bloque valido pero mas corto que la salida esperada
+    CHECK(!Decompress({0x20, 'a', 'b'}, 3, out));
+    // Solo literales, hasta el final: valido
+    CHECK(Decompress({0x20, 'a', 'b'}, 2, out) && out == Bytes({'a', 'b'}));
+}
+
+std::string
+MessageWithLength(uint32_t length, const Bytes& block) {
+    std::string message(COMPRESSION_HEADER_SIZE, '\0');
+    WriteU32(reinterpret_cast<unsigned char*>(message.data()), length);
+    message.append(block.begin(), block.end());
+    return message;
+}
+
+void
+TestDecompressMessageLength() {
+    std::string plaintext;
+    for (int i = 0; i < 20000; ++i) {
+        plaintext += "telemetry sample " + std::to_string(i % 50) + ";";
+    }
+    std::optional<std::string> message = CompressMessage(plaintext);
+    CHECK(message.has_value());
+    CHECK(message && DecompressMessage(*message) == plaintext);
+
+    // Unos bytes que anuncian 64 MiB se rechazan antes de reservar
+    CHECK(!DecompressMessage(MessageWithLength(MAX_FRAME_SIZE, {0x16, 'a', 0x01, 0x00})));
+    CHECK(!DecompressMessage(MessageWithLength(UINT32_MAX, {0x16, 'a', 0x01, 0x00})));
+    CHECK(!DecompressMessage(MessageWithLength(1, {})));
+    CHECK(!DecompressMessage(std::string(3, '\0')));
+
+    // El maximo real: cada byte de longitud extendida da 255 bytes
+    Bytes block = {0x1F, 'a', 0x01, 0x00};
+    block.insert(block.end(), 40, 0xFF);
+    block.push_back(0x00);
+    size_t expanded = 1 + 4 + 15 + 40 * 255;
+    CHECK(expanded <= block.size() * COMPRESSION_MAX_RATIO);
+    std::optional<std::string> decoded = DecompressMessage(MessageWithLength(static_cast<uint32_t>(expanded), block));
+    CHECK(decoded && *decoded == std::string(expanded, 'a'));
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"DecompressRoundTrip", TestDecompressRoundTrip},
+        {"DecompressOverlappingMatch", TestDecompressOverlappingMatch},
+        {"DecompressMalformed", TestDecompressMalformed},
+        {"DecompressMessageLength", TestDecompressMessageLength},
+    };
+    return RunTests(tests);
+}
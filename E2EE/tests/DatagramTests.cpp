@@ -0,0 +1,126 @@
+// Datagram: ventana de repeticiones y numeracion de registros compartida por
+// todos los DatagramSession de una sesion
+#include "Check.h"
+#include "Datagram.h"
+#include <set>
+
+namespace {
+void
+TestReplayWindowShifts() {
+    ReplayWindow window;
+    CHECK(!window.IsFresh(0));
+    CHECK(window.IsFresh(1));
+    window.Mark(1);
+    CHECK(!window.IsFresh(1));
+
+    // Desplazamiento de 63: 1 sigue en el ultimo bit de la ventana
+    window.Mark(64);
+    CHECK(!window.IsFresh(1));
+    CHECK(!window.IsFresh(64));
+    CHECK(window.IsFresh(2) && window.IsFresh(63));
+
+    // Desplazamiento de exactamente 64: todo lo anterior queda fuera
+    window.Mark(128);
+    CHECK(!window.IsFresh(64));
+    CHECK(window.IsFresh(65) && window.IsFresh(127));
+    CHECK(!window.IsFresh(128));
+
+    // Desplazamiento mucho mayor que la ventana
+    window.Mark(1000);
+    CHECK(!window.IsFresh(128) && !window.IsFresh(936));
+    CHECK(window.IsFresh(937) && window.IsFresh(999) && window.IsFresh(1001));
+    CHECK(!window.IsFresh(1000));
+
+    // Fuera de orden dentro de la ventana
+    window.Mark(990);
+    CHECK(!window.IsFresh(990) && window.IsFresh(991));
+    window.Mark(UINT64_MAX - 1);
+    CHECK(!window.IsFresh(1000) && window.IsFresh(UINT64_MAX));
+}
+
+void
+TestReplayWindowStartsAtHighest() {
+    ReplayWindow window(500);
+    CHECK(!window.IsFresh(500) && !window.IsFresh(499) && !window.IsFresh(437) && !window.IsFresh(1));
+    CHECK(window.IsFresh(501));
+    window.Mark(502);
+    CHECK(window.IsFresh(501) && !window.IsFresh(500));
+}
+
+std::string
+Seal(DatagramSession& session, const std::string& message) {
+    std::string record(message.size() + DatagramSession::OVERHEAD, '\0');
+    session.Seal(reinterpret_cast<const unsigned char*>(message.data()), message.size(),
+                 reinterpret_cast<unsigned char*>(record.data()));
+    return record;
+}
+
+std::optional<std::string>
+Open(DatagramSession& session, const std::string& record) {
+    return session.Open(reinterpret_cast<const unsigned char*>(record.data()), record.size());
+}
+
+void
+TestDatagramSessionsNeverReuseNonces() {
+    CryptoHelper crypto;
+    crypto.GenerateAESKey();
+    // El nonce es [sentido][secuencia]: con el mismo sentido basta comparar secuencias
+    std::set<uint64_t> sequences;
+    size_t sealed = 0;
+    for (int instance = 0; instance < 3; ++instance) {
+        DatagramSession session(crypto, HandshakeRole::Client);
+        for (int i = 0; i < 100; ++i) {
+            std::string record = Seal(session, "ping");
+            sequences.insert(ReadU64(reinterpret_cast<const unsigned char*>(record.data()) + 1));
+            ++sealed;
+        }
+    }
+    CHECK(sequences.size() == sealed);
+    CHECK(!sequences.count(0));
+
+    // Dos a la vez sobre la misma sesion tampoco
+    DatagramSession first(crypto, HandshakeRole::Client);
+    DatagramSession second(crypto, HandshakeRole::Client);
+    std::string a = Seal(first, "same");
+    std::string b = Seal(second, "same");
+    CHECK(a.compare(1, 8, b, 1, 8) != 0);
+    CHECK(a != b);
+}
+
+void
+TestDatagramReplayAcrossReopen() {
+    CryptoHelper crypto;
+    crypto.GenerateAESKey();
+    DatagramSession client(crypto, HandshakeRole::Client);
+    std::string early = Seal(client, "early");
+    std::string record = Seal(client, "hello");
+    {
+        DatagramSession server(crypto, HandshakeRole::Server);
+        std::optional<std::string> opened = Open(server, record);
+        CHECK(opened && *opened == "hello");
+        CHECK(!Open(server, record));
+    }
+    // Un DatagramSession nuevo (socket reabierto) no vuelve a aceptar lo ya visto
+    DatagramSession reopened(crypto, HandshakeRole::Server);
+    CHECK(!Open(reopened, record));
+    CHECK(!Open(reopened, early));
+    std::string next = Seal(client, "again");
+    std::optional<std::string> opened = Open(reopened, next);
+    CHECK(opened && *opened == "again");
+
+    // Un registro de un sentido no se abre en el otro
+    DatagramSession otherClient(crypto, HandshakeRole::Client);
+    CHECK(!Open(otherClient, Seal(client, "wrong direction")));
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"ReplayWindowShifts", TestReplayWindowShifts},
+        {"ReplayWindowStartsAtHighest", TestReplayWindowStartsAtHighest},
+        {"DatagramSessionsNeverReuseNonces", TestDatagramSessionsNeverReuseNonces},
+        {"DatagramReplayAcrossReopen", TestDatagramReplayAcrossReopen},
+    };
+    return RunTests(tests);
+}
@@ -0,0 +1,256 @@
+// Dedup: cortes por contenido, manifiesto de SyncFile, cifrado convergente y
+// rearmado del archivo a partir de la version anterior
+#include "Check.h"
+#include "Dedup.h"
+#include <set>
+
+namespace {
+Bytes
+RandomBytes(size_t size, uint32_t seed) {
+    std::mt19937 generator(seed);
+    Bytes data(size);
+    for (unsigned char& byte : data) {
+        byte = static_cast<unsigned char>(generator());
+    }
+    return data;
+}
+
+std::vector<ContentChunk>
+ChunkBuffer(const Bytes& data) {
+    std::vector<ContentChunk> chunks;
+    uint64_t offset = 0;
+    while (offset < data.size()) {
+        ContentChunk chunk;
+        chunk.offset = offset;
+        chunk.size = static_cast<uint32_t>(NextChunkBoundary(data.data() + offset, data.size() - offset));
+        offset += chunk.size;
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+// Contenido de cada bloque, para comparar cortes entre dos versiones
+std::set<Bytes>
+ChunkContents(const Bytes& data) {
+    std::set<Bytes> contents;
+    for (const ContentChunk& chunk : ChunkBuffer(data)) {
+        contents.emplace(data.begin() + chunk.offset, data.begin() + chunk.offset + chunk.size);
+    }
+    return contents;
+}
+
+void
+TestChunkBoundaryLimits() {
+    Bytes data = RandomBytes(4 * CDC_MAX_SIZE, 1);
+    CHECK(NextChunkBoundary(data.data(), 0) == 0);
+    CHECK(NextChunkBoundary(data.data(), 100) == 100);
+    CHECK(NextChunkBoundary(data.data(), CDC_MIN_SIZE) == CDC_MIN_SIZE);
+
+    uint64_t total = 0;
+    std::vector<ContentChunk> chunks = ChunkBuffer(data);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        CHECK(chunks[i].size <= CDC_MAX_SIZE);
+        CHECK(chunks[i].size > CDC_MIN_SIZE || i + 1 == chunks.size());
+        total += chunks[i].size;
+    }
+    CHECK(total == data.size());
+
+    // Sin cortes en el contenido se corta en el maximo
+    Bytes zeros(2 * CDC_MAX_SIZE, 0);
+    CHECK(NextChunkBoundary(zeros.data(), zeros.size()) == CDC_MAX_SIZE);
+}
+
+void
+TestChunkBoundaryResync() {
+    Bytes original = RandomBytes(4 * 1024 * 1024, 2);
+    Bytes edited = original;
+    Bytes inserted = RandomBytes(1000, 3);
+    edited.insert(edited.begin() + 1024 * 1024, inserted.begin(), inserted.end());
+
+    // Insertar bytes solo cambia los bloques de alrededor
+    std::set<Bytes> before = ChunkContents(original);
+    std::set<Bytes> after = ChunkContents(edited);
+    size_t shared = 0;
+    for (const Bytes& chunk : after) {
+        shared += before.count(chunk);
+    }
+    CHECK(after.size() > 8);
+    CHECK(shared + 2 >= after.size());
+}
+
+void
+TestSyncManifest() {
+    Bytes data = RandomBytes(CDC_MAX_SIZE + 1000, 4);
+    std::vector<ContentChunk> chunks = ChunkBuffer(data);
+    for (ContentChunk& chunk : chunks) {
+        chunk.hash[0] = static_cast<unsigned char>(chunk.offset);
+    }
+    Bytes encoded = EncodeSyncManifest(data.size(), chunks);
+    CHECK(encoded.size() == SYNC_MANIFEST_HEADER_SIZE + chunks.size() * SYNC_MANIFEST_ENTRY_SIZE);
+
+    std::vector<ContentChunk> decoded;
+    CHECK(DecodeSyncManifest(encoded.data(), encoded.size(), decoded));
+    CHECK(decoded.size() == chunks.size());
+    for (size_t i = 0; i < decoded.size() && i < chunks.size(); ++i) {
+        CHECK(decoded[i].offset == chunks[i].offset);
+        CHECK(decoded[i].size == chunks[i].size);
+        CHECK(decoded[i].hash == chunks[i].hash);
+    }
+
+    CHECK(!DecodeSyncManifest(encoded.data(), SYNC_MANIFEST_HEADER_SIZE - 1, decoded));
+    CHECK(!DecodeSyncManifest(encoded.data(), encoded.size() - 1, decoded));
+
+    // Los tamanos tienen que sumar el total
+    Bytes wrongTotal = encoded;
+    WriteU64(wrongTotal.data(), data.size() + 1);
+    CHECK(!DecodeSyncManifest(wrongTotal.data(), wrongTotal.size(), decoded));
+
+    // La cuenta de bloques tiene que cuadrar con la longitud
+    Bytes wrongCount = encoded;
+    WriteU32(wrongCount.data() + 8, static_cast<uint32_t>(chunks.size() + 1));
+    CHECK(!DecodeSyncManifest(wrongCount.data(), wrongCount.size(), decoded));
+
+    std::vector<ContentChunk> invalid = {ContentChunk{0, 0, {}}};
+    Bytes empty = EncodeSyncManifest(0, invalid);
+    CHECK(!DecodeSyncManifest(empty.data(), empty.size(), decoded));
+    invalid[0].size = CDC_MAX_SIZE + 1;
+    Bytes oversized = EncodeSyncManifest(CDC_MAX_SIZE + 1, invalid);
+    CHECK(!DecodeSyncManifest(oversized.data(), oversized.size(), decoded));
+
+    // Un archivo vacio no tiene bloques
+    Bytes none = EncodeSyncManifest(0, {});
+    CHECK(DecodeSyncManifest(none.data(), none.size(), decoded));
+    CHECK(decoded.empty());
+}
+
+ChunkHash
+HashOf(const Bytes& data) {
+    ChunkHash hash{};
+    EVP_Digest(data.data(), data.size(), hash.data(), nullptr, EVP_sha256(), nullptr);
+    return hash;
+}
+
+void
+TestConvergentCipher() {
+    CryptoHelper session;
+    session.GenerateAESKey();
+    Bytes data = RandomBytes(5000, 5);
+    ChunkHash hash = HashOf(data);
+
+    ConvergentCipher cipher(session);
+    Bytes first(data.size() + CryptoHelper::AEAD_TAG_SIZE);
+    Bytes second(first.size());
+    cipher.Seal(hash, data.data(), data.size(), first.data());
+    cipher.Seal(hash, data.data(), data.size(), second.data());
+    CHECK(first == second);
+
+    // Otra sesion da otro texto cifrado para el mismo bloque
+    CryptoHelper otherSession;
+    otherSession.GenerateAESKey();
+    ConvergentCipher otherCipher(otherSession);
+    Bytes other(first.size());
+    otherCipher.Seal(hash, data.data(), data.size(), other.data());
+    CHECK(other != first);
+    // Open descifra en el sitio: cada intento sobre su propia copia
+    Bytes foreign = first;
+    CHECK(!otherCipher.Open(hash, foreign.data(), data.size()));
+
+    Bytes opened = first;
+    CHECK(cipher.Open(hash, opened.data(), data.size()));
+    CHECK(Bytes(opened.begin(), opened.begin() + data.size()) == data);
+
+    Bytes tampered = first;
+    tampered[10] ^= 1;
+    CHECK(!cipher.Open(hash, tampered.data(), data.size()));
+
+    // Un hash que no es el del contenido tampoco abre
+    ChunkHash wrongHash = hash;
+    wrongHash[0] ^= 1;
+    Bytes mislabeled(first.size());
+    cipher.Seal(wrongHash, data.data(), data.size(), mislabeled.data());
+    CHECK(!cipher.Open(wrongHash, mislabeled.data(), data.size()));
+}
+
+#ifndef _WIN32
+void
+TestSyncSinkReusesOldVersion() {
+    TempPath target("sync-target");
+    TempPath source("sync-source");
+    Bytes original = RandomBytes(2 * 1024 * 1024, 6);
+    Bytes edited = original;
+    Bytes inserted = RandomBytes(3000, 7);
+    edited.insert(edited.begin() + 700 * 1024, inserted.begin(), inserted.end());
+    WriteFile(target.path, original);
+    WriteFile(source.path, edited);
+
+    MappedFile file;
+    CHECK(file.Open(source.path));
+    std::vector<ContentChunk> chunks = ChunkFile(file);
+    Bytes manifest = EncodeSyncManifest(edited.size(), chunks);
+    std::vector<ContentChunk> received;
+    CHECK(DecodeSyncManifest(manifest.data(), manifest.size(), received));
+
+    SyncSink sink;
+    CHECK(sink.Open(target.path, received));
+    size_t needed = 0;
+    uint64_t neededBytes = 0;
+    for (size_t i = 0; i < sink.Chunks().size(); ++i) {
+        const ContentChunk& chunk = sink.Chunks()[i];
+        if (sink.Needs(i)) {
+            ++needed;
+            neededBytes += chunk.size;
+            CHECK(sink.Write(i, edited.data() + chunk.offset));
+        } else {
+            CHECK(sink.Write(i, nullptr));
+        }
+    }
+    CHECK(needed > 0 && needed <= 3);
+    CHECK(neededBytes < edited.size() / 4);
+    CHECK(sink.Commit());
+    CHECK(ReadFile(target.path) == edited);
+    CHECK(!std::filesystem::exists(target.path + ".sync"));
+
+    // La siguiente sincronizacion del mismo contenido no pide nada
+    SyncSink again;
+    CHECK(again.Open(target.path, received));
+    for (unsigned char byte : again.Need()) {
+        CHECK(byte == 0);
+    }
+}
+
+void
+TestSyncSinkRepeatedChunk() {
+    TempPath target("sync-repeated");
+    Bytes block = RandomBytes(20000, 8);
+    Bytes contents = block;
+    contents.insert(contents.end(), block.begin(), block.end());
+    uint32_t size = static_cast<uint32_t>(block.size());
+    std::vector<ContentChunk> chunks = {ContentChunk{0, size, HashOf(block)}, ContentChunk{size, size, HashOf(block)}};
+
+    // Sin version anterior se pide la primera aparicion y la segunda se copia de ella
+    SyncSink sink;
+    CHECK(sink.Open(target.path, chunks));
+    CHECK(sink.Needs(0));
+    CHECK(!sink.Needs(1));
+    CHECK(sink.Write(0, block.data()));
+    CHECK(sink.Write(1, nullptr));
+    CHECK(sink.Commit());
+    CHECK(ReadFile(target.path) == contents);
+}
+#endif
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"ChunkBoundaryLimits", TestChunkBoundaryLimits},
+        {"ChunkBoundaryResync", TestChunkBoundaryResync},
+        {"SyncManifest", TestSyncManifest},
+        {"ConvergentCipher", TestConvergentCipher},
+#ifndef _WIN32
+        {"SyncSinkReusesOldVersion", TestSyncSinkReusesOldVersion},
+        {"SyncSinkRepeatedChunk", TestSyncSinkRepeatedChunk},
+#endif
+    };
+    return RunTests(tests);
+}
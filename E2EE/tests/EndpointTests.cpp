@@ -0,0 +1,135 @@
+// Endpoint: esquemas de direccion, formato de vuelta y registro InProc
+#include "Check.h"
+#include "Endpoint.h"
+
+namespace {
+void
+TestParseTcp() {
+    Endpoint endpoint;
+    CHECK(ParseEndpoint("tcp://127.0.0.1:27015", endpoint));
+    CHECK(endpoint.transport == Transport::Tcp);
+    CHECK(endpoint.host == "127.0.0.1");
+    CHECK(endpoint.port == 27015);
+
+    // Sin esquema se asume TCP
+    CHECK(ParseEndpoint("localhost:80", endpoint));
+    CHECK(endpoint.transport == Transport::Tcp);
+    CHECK(endpoint.host == "localhost");
+    CHECK(endpoint.port == 80);
+
+    CHECK(ParseEndpoint("*:0", endpoint));
+    CHECK(endpoint.host == "*");
+    CHECK(endpoint.port == 0);
+
+    CHECK(ParseEndpoint(":65535", endpoint));
+    CHECK(endpoint.host.empty());
+    CHECK(endpoint.port == 65535);
+}
+
+void
+TestParsePaths() {
+    Endpoint endpoint;
+    CHECK(ParseEndpoint("unix:/tmp/e2ee.sock", endpoint));
+    CHECK(endpoint.transport == Transport::Unix);
+    CHECK(endpoint.path == "/tmp/e2ee.sock");
+
+    CHECK(ParseEndpoint("inproc:bench", endpoint));
+    CHECK(endpoint.transport == Transport::InProc);
+    CHECK(endpoint.path == "bench");
+
+#ifndef _WIN32
+    // "unix+seqpacket:" no debe confundirse con "unix:"
+    CHECK(ParseEndpoint("unix+seqpacket:/tmp/e2ee.sock", endpoint));
+    CHECK(endpoint.transport == Transport::UnixSeqPacket);
+    CHECK(endpoint.path == "/tmp/e2ee.sock");
+    CHECK(IsMessageOriented(endpoint.transport));
+#endif
+}
+
+void
+TestParseInvalid() {
+    Endpoint endpoint;
+    CHECK(!ParseEndpoint("127.0.0.1", endpoint));
+    CHECK(!ParseEndpoint("127.0.0.1:", endpoint));
+    CHECK(!ParseEndpoint("127.0.0.1:65536", endpoint));
+    CHECK(!ParseEndpoint("127.0.0.1:-1", endpoint));
+    CHECK(!ParseEndpoint("127.0.0.1:80x", endpoint));
+    CHECK(!ParseEndpoint("tcp://host", endpoint));
+    CHECK(!ParseEndpoint("unix:", endpoint));
+    CHECK(!ParseEndpoint("unix+seqpacket:", endpoint));
+    CHECK(!ParseEndpoint("inproc:", endpoint));
+}
+
+void
+TestFormatRoundTrip() {
+    const char* addresses[] = {"tcp://127.0.0.1:27015", "tcp://*:0", "unix:/tmp/e2ee.sock", "inproc:bench",
+#ifndef _WIN32
+                               "unix+seqpacket:/tmp/e2ee.sock"
+#endif
+    };
+    for (const char* address : addresses) {
+        Endpoint endpoint;
+        CHECK(ParseEndpoint(address, endpoint));
+        CHECK(FormatEndpoint(endpoint) == address);
+    }
+
+    // Host vacio se muestra como todas las interfaces
+    Endpoint endpoint;
+    CHECK(ParseEndpoint(":80", endpoint));
+    CHECK(FormatEndpoint(endpoint) == "tcp://*:80");
+    CHECK(ParseEndpoint("localhost:80", endpoint));
+    CHECK(FormatEndpoint(endpoint) == "tcp://localhost:80");
+}
+
+void
+TestResolve() {
+    Endpoint endpoint;
+    SocketAddress address;
+    CHECK(ParseEndpoint("localhost:80", endpoint));
+    CHECK(ResolveEndpoint(endpoint, false, address));
+    CHECK(address.family == AF_INET);
+
+    // Sin host solo se puede escuchar
+    CHECK(ParseEndpoint("*:80", endpoint));
+    CHECK(ResolveEndpoint(endpoint, true, address));
+    CHECK(!ResolveEndpoint(endpoint, false, address));
+
+    CHECK(ParseEndpoint("example.com:80", endpoint));
+    CHECK(!ResolveEndpoint(endpoint, false, address));
+
+    CHECK(ParseEndpoint("unix:" + std::string(200, 'a'), endpoint));
+    CHECK(!ResolveEndpoint(endpoint, true, address));
+}
+
+void
+TestInProcRegistry() {
+    Endpoint endpoint;
+    SocketAddress listening;
+    SocketAddress connecting;
+    CHECK(ParseEndpoint("inproc:registry-test", endpoint));
+    CHECK(!ResolveEndpoint(endpoint, false, connecting));
+
+    CHECK(ResolveEndpoint(endpoint, true, listening));
+    CHECK(RegisterInProc(endpoint.path, listening));
+    CHECK(!RegisterInProc(endpoint.path, listening));
+    CHECK(ResolveEndpoint(endpoint, false, connecting));
+    CHECK(connecting.length == listening.length);
+    CHECK(std::memcmp(&connecting.storage, &listening.storage, listening.length) == 0);
+
+    UnregisterInProc(endpoint.path);
+    CHECK(!ResolveEndpoint(endpoint, false, connecting));
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"ParseTcp", TestParseTcp},
+        {"ParsePaths", TestParsePaths},
+        {"ParseInvalid", TestParseInvalid},
+        {"FormatRoundTrip", TestFormatRoundTrip},
+        {"Resolve", TestResolve},
+        {"InProcRegistry", TestInProcRegistry},
+    };
+    return RunTests(tests);
+}
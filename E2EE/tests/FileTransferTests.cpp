@@ -0,0 +1,318 @@
+// FileTransfer: registros cifrados de bloque, FileInfo, archivo proyectado y
+// reanudacion de transferencias, con los bloques guardados comprobados otra vez
+#include "Check.h"
+#include "FileTransfer.h"
+#include <algorithm>
+
+namespace {
+Bytes
+Pattern(size_t size, unsigned char seed) {
+    Bytes data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<unsigned char>(seed + i * 7);
+    }
+    return data;
+}
+
+#ifndef _WIN32
+// Seis bloques de 4 KiB, el ultimo de 100 bytes
+FileInfo
+SmallFileInfo(uint64_t transferId) {
+    FileInfo info;
+    info.transferId = transferId;
+    info.chunkSize = 4096;
+    info.size = 5 * 4096 + 100;
+    return info;
+}
+
+bool
+WriteChunk(FileSink& sink, const Bytes& contents, uint64_t index) {
+    uint64_t offset = index * sink.Info().chunkSize;
+    size_t size = static_cast<size_t>(std::min<uint64_t>(sink.Info().chunkSize, contents.size() - offset));
+    return sink.Write(offset, contents.data() + offset, size);
+}
+#endif
+
+void
+TestFileRecordRoundTrip() {
+    CryptoHelper crypto;
+    crypto.GenerateAESKey();
+    Bytes chunk = Pattern(1000, 1);
+    Bytes record(FILE_RECORD_OVERHEAD + chunk.size());
+    SealFileRecord(crypto, FrameType::FileChunk, 42, 4096, chunk.data(), chunk.size(), record.data());
+
+    Bytes copy = record;
+    uint64_t offset = 0;
+    unsigned char* data = nullptr;
+    size_t length = 0;
+    CHECK(OpenFileRecord(crypto, FrameType::FileChunk, 42, copy.data(), copy.size(), offset, data, length));
+    CHECK(offset == 4096);
+    CHECK(length == chunk.size());
+    CHECK(data && Bytes(data, data + length) == chunk);
+}
+
+void
+TestFileRecordRejects() {
+    CryptoHelper crypto;
+    crypto.GenerateAESKey();
+    Bytes chunk = Pattern(64, 2);
+    Bytes record(FILE_RECORD_OVERHEAD + chunk.size());
+    SealFileRecord(crypto, FrameType::FileChunk, 42, 0, chunk.data(), chunk.size(), record.data());
+
+    uint64_t offset;
+    unsigned char* data;
+    size_t length;
+    auto opens = [&](Bytes copy, FrameType type, uint64_t transferId) {
+        return OpenFileRecord(crypto, type, transferId, copy.data(), copy.size(), offset, data, length);
+    };
+    CHECK(opens(record, FrameType::FileChunk, 42));
+    // Tipo y transferencia van en los datos asociados
+    CHECK(!opens(record, FrameType::FileEnd, 42));
+    CHECK(!opens(record, FrameType::FileChunk, 43));
+
+    // El offset tambien: un bloque no se puede mover de sitio
+    Bytes moved = record;
+    WriteU64(moved.data(), FILE_CHUNK_SIZE);
+    CHECK(!opens(moved, FrameType::FileChunk, 42));
+
+    Bytes flipped = record;
+    flipped[FILE_RECORD_HEADER_SIZE + CryptoHelper::AEAD_NONCE_SIZE] ^= 1;
+    CHECK(!opens(flipped, FrameType::FileChunk, 42));
+
+    Bytes truncated(record.begin(), record.begin() + FILE_RECORD_OVERHEAD - 1);
+    CHECK(!opens(truncated, FrameType::FileChunk, 42));
+
+    CryptoHelper otherSession;
+    otherSession.GenerateAESKey();
+    Bytes copy = record;
+    CHECK(!OpenFileRecord(otherSession, FrameType::FileChunk, 42, copy.data(), copy.size(), offset, data, length));
+}
+
+void
+TestFileInfoDecode() {
+    FileInfo info;
+    info.transferId = 0x0102030405060708;
+    info.size = 10 * FILE_CHUNK_SIZE + 1;
+    info.chunkSize = FILE_CHUNK_SIZE;
+    info.streams = 4;
+    CHECK(info.ChunkCount() == 11);
+
+    unsigned char encoded[FileInfo::ENCODED_SIZE];
+    info.Encode(encoded);
+    FileInfo decoded;
+    CHECK(decoded.Decode(encoded, sizeof(encoded)));
+    CHECK(decoded == info);
+    CHECK(!decoded.Decode(encoded, sizeof(encoded) - 1));
+
+    FileInfo invalid = info;
+    invalid.chunkSize = 0;
+    invalid.Encode(encoded);
+    CHECK(!decoded.Decode(encoded, sizeof(encoded)));
+    invalid.chunkSize = MAX_FRAME_SIZE;
+    invalid.Encode(encoded);
+    CHECK(!decoded.Decode(encoded, sizeof(encoded)));
+
+    invalid = info;
+    invalid.streams = MAX_FILE_STREAMS + 1;
+    invalid.Encode(encoded);
+    CHECK(!decoded.Decode(encoded, sizeof(encoded)));
+    invalid.streams = 0;
+    invalid.Encode(encoded);
+    CHECK(!decoded.Decode(encoded, sizeof(encoded)));
+}
+
+#ifndef _WIN32
+void
+TestMappedFile() {
+    TempPath temp("mapped");
+    Bytes contents = Pattern(10000, 3);
+    WriteFile(temp.path, contents);
+
+    MappedFile file;
+    CHECK(file.Open(temp.path));
+    CHECK(file.Size() == contents.size());
+    CHECK(file.Data() && std::equal(contents.begin(), contents.end(), file.Data()));
+    CHECK(file.Descriptor() >= 0);
+
+    MappedFile missing;
+    CHECK(!missing.Open(temp.path + ".missing"));
+
+    // Un archivo vacio se abre sin proyeccion
+    std::ofstream(temp.path, std::ios::binary | std::ios::trunc);
+    MappedFile empty;
+    CHECK(empty.Open(temp.path));
+    CHECK(empty.Size() == 0);
+    CHECK(empty.Data() == nullptr);
+}
+
+void
+TestFileSinkResume() {
+    TempPath temp("sink");
+    FileInfo info = SmallFileInfo(7);
+    Bytes contents = Pattern(static_cast<size_t>(info.size), 4);
+    {
+        FileSink sink;
+        CHECK(sink.Open(temp.path, info));
+        CHECK(WriteChunk(sink, contents, 0));
+        CHECK(WriteChunk(sink, contents, 2));
+        CHECK(WriteChunk(sink, contents, 5));
+        CHECK(WriteChunk(sink, contents, 2));
+        // Offset desalineado, tamano distinto del bloque o fuera del archivo
+        CHECK(!sink.Write(1, contents.data(), 4096));
+        CHECK(!sink.Write(4096, contents.data(), 100));
+        CHECK(!sink.Write(6 * 4096, contents.data(), 100));
+        CHECK(sink.Bitmap() == Bytes{0x25});
+        CHECK(!sink.Finish());
+    }
+    CHECK(std::filesystem::exists(temp.path + ".resume"));
+
+    FileSink sink;
+    CHECK(sink.Open(temp.path, info));
+    CHECK(sink.Bitmap() == Bytes{0x25});
+    for (uint64_t index : {1, 3, 4}) {
+        CHECK(WriteChunk(sink, contents, index));
+    }
+    CHECK(sink.WaitComplete());
+    CHECK(sink.Finish());
+    CHECK(!std::filesystem::exists(temp.path + ".resume"));
+    CHECK(ReadFile(temp.path) == contents);
+}
+
+void
+TestFileSinkRestartsForOtherFile() {
+    TempPath temp("restart");
+    FileInfo info = SmallFileInfo(7);
+    Bytes contents = Pattern(static_cast<size_t>(info.size), 5);
+    {
+        FileSink sink;
+        CHECK(sink.Open(temp.path, info));
+        CHECK(WriteChunk(sink, contents, 1));
+        CHECK(!sink.Finish());
+    }
+
+    // Otro id de transferencia: el estado guardado no vale y se empieza de cero
+    FileSink sink;
+    CHECK(sink.Open(temp.path, SmallFileInfo(8)));
+    CHECK(sink.Bitmap() == Bytes{0});
+    CHECK(ReadFile(temp.path) == Bytes(contents.size(), 0));
+    CHECK(!sink.Finish());
+
+    // Un estado truncado tampoco
+    std::filesystem::resize_file(temp.path + ".resume", 10);
+    FileSink truncated;
+    CHECK(truncated.Open(temp.path, SmallFileInfo(8)));
+    CHECK(truncated.Bitmap() == Bytes{0});
+    CHECK(!truncated.Finish());
+}
+
+void
+TestFileSinkReverifiesHeld() {
+    TempPath temp("verify");
+    FileInfo info = SmallFileInfo(9);
+    Bytes contents = Pattern(static_cast<size_t>(info.size), 7);
+    std::vector<MerkleHash> leaves;
+    for (uint64_t offset = 0; offset < info.size; offset += info.chunkSize) {
+        size_t size = std::min<size_t>(info.chunkSize, contents.size() - offset);
+        leaves.push_back(MerkleLeaf(contents.data() + offset, size));
+    }
+    {
+        FileSink sink;
+        CHECK(sink.Open(temp.path, info));
+        for (uint64_t index : {0, 1, 5}) {
+            CHECK(WriteChunk(sink, contents, index));
+        }
+        CHECK(!sink.Finish());
+    }
+
+    // Se dana en disco el bloque 1 mientras la transferencia esta cortada
+    Bytes stored = ReadFile(temp.path);
+    stored[4096 + 10] ^= 1;
+    WriteFile(temp.path, stored);
+
+    FileSink sink;
+    CHECK(sink.Open(temp.path, info));
+    CHECK(sink.Bitmap() == Bytes{0x23});
+    CHECK(sink.SetManifest(MerkleTree(leaves)));
+    CHECK(sink.Bitmap() == Bytes{0x21});
+    CHECK(sink.Matches(4096, contents.data() + 4096, 4096));
+    CHECK(!sink.Matches(4096, stored.data() + 4096, 4096));
+    CHECK(!sink.Matches(1, contents.data(), 4096));
+    CHECK(!sink.Matches(6 * 4096, contents.data(), 100));
+    for (uint64_t index : {1, 2, 3, 4}) {
+        CHECK(WriteChunk(sink, contents, index));
+    }
+    CHECK(sink.Finish());
+    CHECK(ReadFile(temp.path) == contents);
+
+    // El bloque descartado tambien se guarda como pendiente
+    TempPath again("verify-state");
+    {
+        FileSink first;
+        CHECK(first.Open(again.path, info));
+        CHECK(WriteChunk(first, contents, 1));
+        CHECK(!first.Finish());
+    }
+    WriteFile(again.path, stored);
+    {
+        FileSink second;
+        CHECK(second.Open(again.path, info));
+        CHECK(second.SetManifest(MerkleTree(leaves)));
+        CHECK(!second.Finish());
+    }
+    FileSink third;
+    CHECK(third.Open(again.path, info));
+    CHECK(third.Bitmap() == Bytes{0});
+    CHECK(!third.Finish());
+}
+
+void
+TestFileSourceSkipsHeld() {
+    TempPath temp("source");
+    Bytes contents = Pattern(5 * 4096 + 100, 6);
+    WriteFile(temp.path, contents);
+
+    FileSource source;
+    CHECK(source.Open(temp.path, 4096, 2));
+    CHECK(source.Info().size == contents.size());
+    CHECK(source.Info().ChunkCount() == 6);
+    CHECK(source.Manifest().Leaves().size() == 6);
+    CHECK(source.Manifest().Leaves()[5] == MerkleLeaf(contents.data() + 5 * 4096, 100));
+
+    // El mismo archivo da el mismo id al reintentar
+    FileSource again;
+    CHECK(again.Open(temp.path, 4096, 2));
+    CHECK(again.Info().transferId == source.Info().transferId);
+
+    // Un byte de mapa por cada ocho bloques
+    Bytes tooLong{0x25, 0};
+    CHECK(!source.SkipHeld(tooLong.data(), tooLong.size()));
+    Bytes held{0x25};
+    CHECK(source.SkipHeld(held.data(), held.size()));
+    std::vector<uint64_t> offsets;
+    uint64_t offset;
+    size_t size;
+    while (source.Next(offset, size)) {
+        offsets.push_back(offset);
+        CHECK(size == 4096);
+    }
+    CHECK((offsets == std::vector<uint64_t>{4096, 3 * 4096, 4 * 4096}));
+}
+#endif
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"FileRecordRoundTrip", TestFileRecordRoundTrip},
+        {"FileRecordRejects", TestFileRecordRejects},
+        {"FileInfoDecode", TestFileInfoDecode},
+#ifndef _WIN32
+        {"MappedFile", TestMappedFile},
+        {"FileSinkResume", TestFileSinkResume},
+        {"FileSinkRestartsForOtherFile", TestFileSinkRestartsForOtherFile},
+        {"FileSinkReverifiesHeld", TestFileSinkReverifiesHeld},
+        {"FileSourceSkipsHeld", TestFileSourceSkipsHeld},
+#endif
+    };
+    return RunTests(tests);
+}
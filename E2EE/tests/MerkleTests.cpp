@@ -0,0 +1,110 @@
+// Merkle: raiz con anchos impares (nodos sin pareja), separacion de dominios
+// y manifiesto autenticado de FileTransfer
+#include "Check.h"
+#include "FileTransfer.h"
+#include "Merkle.h"
+#include <openssl/evp.h>
+#include <cstring>
+
+namespace {
+MerkleHash
+Leaf(int i) {
+    unsigned char data[2] = {static_cast<unsigned char>(i), 0x5A};
+    return MerkleLeaf(data, sizeof(data));
+}
+
+std::vector<MerkleHash>
+Leaves(size_t count) {
+    std::vector<MerkleHash> leaves;
+    for (size_t i = 0; i < count; ++i) {
+        leaves.push_back(Leaf(static_cast<int>(i)));
+    }
+    return leaves;
+}
+
+void
+TestRootOddWidths() {
+    MerkleHash empty{};
+    EVP_Digest(nullptr, 0, empty.data(), nullptr, EVP_sha256(), nullptr);
+    CHECK(MerkleTree().Root() == empty);
+    CHECK(MerkleTree().Leaves().empty());
+
+    MerkleHash l0 = Leaf(0), l1 = Leaf(1), l2 = Leaf(2), l3 = Leaf(3), l4 = Leaf(4), l5 = Leaf(5), l6 = Leaf(6);
+    MerkleHash n01 = MerkleNode(l0, l1), n23 = MerkleNode(l2, l3), n45 = MerkleNode(l4, l5);
+    CHECK(MerkleTree(Leaves(1)).Root() == l0);
+    CHECK(MerkleTree(Leaves(2)).Root() == n01);
+    // El nodo sin pareja sube sin volver a hashear
+    CHECK(MerkleTree(Leaves(3)).Root() == MerkleNode(n01, l2));
+    CHECK(MerkleTree(Leaves(4)).Root() == MerkleNode(n01, n23));
+    CHECK(MerkleTree(Leaves(5)).Root() == MerkleNode(MerkleNode(n01, n23), l4));
+    CHECK(MerkleTree(Leaves(6)).Root() == MerkleNode(MerkleNode(n01, n23), n45));
+    CHECK(MerkleTree(Leaves(7)).Root() == MerkleNode(MerkleNode(n01, n23), MerkleNode(n45, l6)));
+    CHECK(MerkleTree(Leaves(7)).Leaves() == Leaves(7));
+
+    // Cambiar cualquier hoja, o quitar la ultima, cambia la raiz
+    MerkleHash root = MerkleTree(Leaves(7)).Root();
+    for (size_t i = 0; i < 7; ++i) {
+        std::vector<MerkleHash> leaves = Leaves(7);
+        leaves[i][0] ^= 1;
+        CHECK(MerkleTree(leaves).Root() != root);
+    }
+    CHECK(MerkleTree(Leaves(6)).Root() != root);
+}
+
+void
+TestDomainSeparation() {
+    // Una hoja cuyo contenido es la concatenacion de dos hashes no da el nodo
+    MerkleHash a = Leaf(1), b = Leaf(2);
+    unsigned char concatenated[2 * MERKLE_HASH_SIZE];
+    std::memcpy(concatenated, a.data(), MERKLE_HASH_SIZE);
+    std::memcpy(concatenated + MERKLE_HASH_SIZE, b.data(), MERKLE_HASH_SIZE);
+    CHECK(MerkleLeaf(concatenated, sizeof(concatenated)) != MerkleNode(a, b));
+    CHECK(MerkleNode(a, b) != MerkleNode(b, a));
+}
+
+void
+TestManifest() {
+    CryptoHelper crypto;
+    crypto.GenerateAESKey();
+    FileInfo info;
+    info.transferId = 42;
+    info.chunkSize = 1024;
+    info.size = 5 * 1024 + 7;
+    info.streams = 2;
+    CHECK(info.ChunkCount() == 6);
+    MerkleTree tree(Leaves(6));
+    std::vector<unsigned char> manifest = EncodeFileManifest(crypto, info, tree);
+
+    MerkleTree decoded;
+    CHECK(DecodeFileManifest(crypto, info, manifest.data(), manifest.size(), decoded));
+    CHECK(decoded.Root() == tree.Root() && decoded.Leaves() == tree.Leaves());
+
+    // Hoja cambiada: ya no da la raiz autenticada
+    std::vector<unsigned char> tampered = manifest;
+    tampered.back() ^= 1;
+    CHECK(!DecodeFileManifest(crypto, info, tampered.data(), tampered.size(), decoded));
+    // Raiz cambiada: el HMAC no autentica
+    tampered = manifest;
+    tampered[0] ^= 1;
+    CHECK(!DecodeFileManifest(crypto, info, tampered.data(), tampered.size(), decoded));
+    // Otra transferencia, o una hoja de menos
+    FileInfo other = info;
+    other.transferId = 43;
+    CHECK(!DecodeFileManifest(crypto, other, manifest.data(), manifest.size(), decoded));
+    CHECK(!DecodeFileManifest(crypto, info, manifest.data(), manifest.size() - MERKLE_HASH_SIZE, decoded));
+    // Otra sesion
+    CryptoHelper otherSession;
+    otherSession.GenerateAESKey();
+    CHECK(!DecodeFileManifest(otherSession, info, manifest.data(), manifest.size(), decoded));
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"RootOddWidths", TestRootOddWidths},
+        {"DomainSeparation", TestDomainSeparation},
+        {"Manifest", TestManifest},
+    };
+    return RunTests(tests);
+}
@@ -0,0 +1,124 @@
+// PeerKeyCache: aciertos, desalojo LRU y referencias que sobreviven al desalojo
+#include "Check.h"
+#include "CryptoHelper.h"
+#include "PeerKeyCache.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+std::vector<std::string>
+PublicKeys(size_t count) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < count; ++i) {
+        CryptoHelper crypto;
+        crypto.GenerateRSAKeys();
+        keys.push_back(crypto.GetPublicKeyString());
+    }
+    return keys;
+}
+
+const std::vector<std::string>&
+Keys() {
+    static const std::vector<std::string> keys = PublicKeys(3);
+    return keys;
+}
+
+void
+TestPeerKeyCacheHits() {
+    PeerKeyCache cache(4, 1);
+    RSA* first = cache.Acquire(Keys()[0]);
+    RSA* second = cache.Acquire(Keys()[0]);
+    CHECK(first != nullptr);
+    CHECK(first == second);
+    CHECK(cache.Acquire("-----BEGIN RSA PUBLIC KEY-----\nno\n-----END RSA PUBLIC KEY-----\n") == nullptr);
+
+    PeerKeyCache::Stats stats = cache.GetStats();
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 2);
+    CHECK(stats.size == 1);
+    CHECK(stats.HitRate() > 0.3 && stats.HitRate() < 0.4);
+    RSA_free(first);
+    RSA_free(second);
+
+    CHECK(PeerKeyCache::Fingerprint(Keys()[0]).size() == 32);
+    CHECK(PeerKeyCache::Fingerprint(Keys()[0]) != PeerKeyCache::Fingerprint(Keys()[1]));
+}
+
+void
+TestPeerKeyCacheEvictsLeastRecent() {
+    PeerKeyCache cache(2, 1);
+    RSA* a = cache.Acquire(Keys()[0]);
+    RSA* b = cache.Acquire(Keys()[1]);
+    // a pasa a ser el mas reciente: el siguiente desalojo es b
+    RSA_free(cache.Acquire(Keys()[0]));
+    RSA* c = cache.Acquire(Keys()[2]);
+
+    PeerKeyCache::Stats stats = cache.GetStats();
+    CHECK(stats.evictions == 1);
+    CHECK(stats.size == 2);
+    CHECK(stats.hits == 1);
+
+    RSA* again = cache.Acquire(Keys()[0]);
+    CHECK(again == a);
+    CHECK(cache.GetStats().hits == 2);
+    RSA* reloaded = cache.Acquire(Keys()[1]);
+    CHECK(reloaded != nullptr && reloaded != b);
+    CHECK(cache.GetStats().misses == 4);
+    CHECK(cache.GetStats().evictions == 2);
+
+    // La referencia del llamador sigue valida tras el desalojo
+    CHECK(RSA_size(b) == RSA_size(reloaded));
+    for (RSA* key : {a, b, c, again, reloaded}) {
+        RSA_free(key);
+    }
+}
+
+void
+TestPeerKeyCacheClear() {
+    PeerKeyCache cache(3, 2);
+    CHECK(cache.GetStats().capacity == 4);
+    RSA* key = cache.Acquire(Keys()[0]);
+    cache.Clear();
+    CHECK(cache.GetStats().size == 0);
+    CHECK(RSA_size(key) > 0);
+    RSA_free(key);
+}
+
+void
+TestPeerKeyCacheConcurrent() {
+    PeerKeyCache cache(2, 2);
+    const int perThread = 500;
+    // CHECK no es seguro entre hilos: los fallos se cuentan aparte
+    std::atomic<int> failed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, &failed, t] {
+            for (int i = 0; i < perThread; ++i) {
+                RSA* key = cache.Acquire(Keys()[(t + i) % Keys().size()]);
+                if (!key) {
+                    ++failed;
+                }
+                RSA_free(key);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(failed == 0);
+    PeerKeyCache::Stats stats = cache.GetStats();
+    CHECK(stats.hits + stats.misses == 4 * perThread);
+    CHECK(stats.size <= stats.capacity);
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"PeerKeyCacheHits", TestPeerKeyCacheHits},
+        {"PeerKeyCacheEvictsLeastRecent", TestPeerKeyCacheEvictsLeastRecent},
+        {"PeerKeyCacheClear", TestPeerKeyCacheClear},
+        {"PeerKeyCacheConcurrent", TestPeerKeyCacheConcurrent},
+    };
+    return RunTests(tests);
+}
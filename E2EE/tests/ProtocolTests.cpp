@@ -0,0 +1,57 @@
+// Protocol: lotes de mensajes (MessageBatch)
+#include "Check.h"
+#include "Protocol.h"
+#include <deque>
+
+namespace {
+void
+TestBatchRoundTrip() {
+    std::string batch;
+    AppendBatchMessage(batch, "hola");
+    AppendBatchMessage(batch, "");
+    AppendBatchMessage(batch, std::string(70000, 'x'));
+    CHECK(batch.size() == 3 * BATCH_MESSAGE_HEADER_SIZE + 4 + 70000);
+
+    // Se anade detras de lo que ya habia en la cola
+    std::deque<std::string> messages = {"previo"};
+    CHECK(SplitBatch(batch, messages));
+    CHECK(messages.size() == 4);
+    CHECK(messages[0] == "previo");
+    CHECK(messages[1] == "hola");
+    CHECK(messages[2].empty());
+    CHECK(messages[3] == std::string(70000, 'x'));
+}
+
+void
+TestBatchRejects() {
+    std::deque<std::string> messages = {"previo"};
+    CHECK(!SplitBatch("", messages));
+
+    std::string batch;
+    AppendBatchMessage(batch, "hola");
+    AppendBatchMessage(batch, "mundo");
+
+    // Un fallo no deja mensajes a medias en la cola
+    CHECK(!SplitBatch(batch.substr(0, batch.size() - 1), messages));
+    CHECK(!SplitBatch(batch + std::string(BATCH_MESSAGE_HEADER_SIZE - 1, '\0'), messages));
+    std::string oversized = batch;
+    oversized[0] = '\xFF';
+    CHECK(!SplitBatch(oversized, messages));
+    CHECK(messages.size() == 1);
+
+    // Una cabecera sin mensaje es un mensaje vacio, no un error
+    std::string empty;
+    AppendBatchMessage(empty, "");
+    CHECK(SplitBatch(empty, messages));
+    CHECK(messages.size() == 2 && messages[1].empty());
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"BatchRoundTrip", TestBatchRoundTrip},
+        {"BatchRejects", TestBatchRejects},
+    };
+    return RunTests(tests);
+}
@@ -0,0 +1,87 @@
+// SecureArena: reutilizacion de slots, borrado al liberar y aborto ante un
+// puntero ajeno o una doble liberacion
+#include "Check.h"
+#include "SecureArena.h"
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <set>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+void
+TestAllocateAndReuse() {
+    SecureArena arena(4, 64);
+    std::set<unsigned char*> slots;
+    for (int i = 0; i < 10; ++i) {
+        unsigned char* slot = arena.Allocate();
+        CHECK(reinterpret_cast<uintptr_t>(slot) % 64 == 0);
+        std::memset(slot, 0xAB, arena.SlotSize());
+        slots.insert(slot);
+    }
+    CHECK(slots.size() == 10);
+    CHECK(arena.InUse() == 10);
+    CHECK(arena.Capacity() >= 10);
+
+    unsigned char* freed = *slots.begin();
+    arena.Free(freed);
+    CHECK(arena.InUse() == 9);
+    unsigned char* again = arena.Allocate();
+    CHECK(again == freed);
+    // Se borro al liberarse
+    CHECK(std::all_of(again, again + arena.SlotSize(), [](unsigned char byte) { return byte == 0; }));
+    for (unsigned char* slot : slots) {
+        arena.Free(slot);
+    }
+    CHECK(arena.InUse() == 0);
+    arena.Free(nullptr);
+}
+
+#ifndef _WIN32
+// true si fn aborta en un proceso hijo
+template<typename Fn>
+bool
+Aborts(Fn fn) {
+    pid_t child = fork();
+    if (child == 0) {
+        fn();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+void
+TestFreeAbortsOnMisuse() {
+    SecureArena arena(4, 64);
+    unsigned char* slot = arena.Allocate();
+    CHECK(Aborts([&] {
+        arena.Free(slot);
+        arena.Free(slot);
+    }));
+    CHECK(Aborts([&] { arena.Free(slot + 1); }));
+    unsigned char outside[64];
+    CHECK(Aborts([&] { arena.Free(outside); }));
+    // Un slot libre que nunca se entrego tampoco se puede liberar
+    CHECK(Aborts([&] { arena.Free(slot + 64); }));
+    CHECK(!Aborts([&] { arena.Free(slot); }));
+    arena.Free(slot);
+}
+#endif
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"AllocateAndReuse", TestAllocateAndReuse},
+#ifndef _WIN32
+        {"FreeAbortsOnMisuse", TestFreeAbortsOnMisuse},
+#endif
+    };
+    return RunTests(tests);
+}
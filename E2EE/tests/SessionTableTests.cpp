@@ -0,0 +1,79 @@
+// SessionTable: altas, bajas, limpieza de ranuras borradas y crecimiento
+#include "Check.h"
+#include "Epoch.h"
+#include "SessionTable.h"
+#include <set>
+
+namespace {
+std::unique_ptr<Session>
+NewSession(uint64_t id) {
+    auto session = std::make_unique<Session>();
+    session->id = id;
+    session->peer = "peer-" + std::to_string(id);
+    return session;
+}
+
+void
+TestSessionTableReuse() {
+    SessionTable table(16);
+    CHECK(table.Insert(NewSession(1)));
+    CHECK(!table.Insert(NewSession(1)));
+    CHECK(table.Erase(1));
+    CHECK(!table.Erase(1));
+    {
+        EpochGuard guard;
+        CHECK(table.Find(1, guard) == nullptr);
+    }
+
+    // Altas y bajas continuas con pocas vivas: las ranuras borradas se limpian
+    // al rehacer la tabla y las busquedas siguen encontrando solo las vivas
+    std::set<uint64_t> live;
+    uint64_t next = 2;
+    for (int round = 0; round < 20000; ++round) {
+        CHECK(table.Insert(NewSession(next)));
+        live.insert(next++);
+        if (live.size() > 5) {
+            uint64_t oldest = *live.begin();
+            CHECK(table.Erase(oldest));
+            live.erase(live.begin());
+        }
+        if (round % 997 == 0) {
+            EpochGuard guard;
+            for (uint64_t id = next > 40 ? next - 40 : 1; id < next; ++id) {
+                Session* session = table.Find(id, guard);
+                CHECK((session != nullptr) == (live.count(id) != 0));
+                CHECK(!session || (session->id == id && session->peer == "peer-" + std::to_string(id)));
+            }
+        }
+    }
+    CHECK(table.Size() == live.size());
+    size_t visited = 0;
+    table.ForEach([&](Session& session) {
+        CHECK(live.count(session.id) == 1);
+        ++visited;
+    });
+    CHECK(visited == live.size());
+
+    // Crecimiento: todas siguen encontrandose despues de rehacer
+    for (uint64_t id = next; id < next + 5000; ++id) {
+        CHECK(table.Insert(NewSession(id)));
+    }
+    {
+        EpochGuard guard;
+        for (uint64_t id = next; id < next + 5000; ++id) {
+            Session* session = table.Find(id, guard);
+            CHECK(session && session->id == id);
+        }
+    }
+    CHECK(table.Size() == live.size() + 5000);
+    EpochCollect();
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"SessionTableReuse", TestSessionTableReuse},
+    };
+    return RunTests(tests);
+}
@@ -0,0 +1,122 @@
+// ShmChannel: tramas que dan la vuelta al anillo y registros corruptos del peer
+#include "Check.h"
+#include "ShmChannel.h"
+#include <cstring>
+
+namespace {
+#ifdef __linux__
+struct Pair {
+    std::unique_ptr<ShmChannel> sender = ShmChannel::Create(4096);
+    std::unique_ptr<ShmChannel> receiver = sender ? sender->OpenPeer() : nullptr;
+};
+
+// Publica un registro de size bytes y devuelve su cabecera [longitud][tipo],
+// que se sobrescribe para simular a un peer que escribe en la region
+unsigned char*
+CommitRecord(ShmChannel& channel, size_t size) {
+    unsigned char* payload = channel.TryReserve(size);
+    if (!payload) {
+        return nullptr;
+    }
+    std::memset(payload, 0xAB, size);
+    channel.Commit(FrameType::Data, size);
+    return payload - 8;
+}
+
+void
+ExpectCorrupt(Pair& pair) {
+    FrameType type;
+    size_t size;
+    CHECK(pair.receiver->TryPeek(type, size) == nullptr);
+    CHECK(pair.receiver->PeerClosed());
+    // El receptor cierra su extremo: el emisor deja de escribir
+    CHECK(pair.sender->PeerClosed());
+    CHECK(pair.sender->TryReserve(16) == nullptr);
+    CHECK(pair.receiver->TryPeek(type, size) == nullptr);
+}
+
+void
+TestShmWrapAround() {
+    Pair pair;
+    CHECK(pair.sender && pair.receiver);
+    if (!pair.receiver) {
+        return;
+    }
+    // 1000 bytes no dividen el anillo: se ejercitan los registros de relleno
+    Bytes payload(1000);
+    for (int i = 0; i < 20; ++i) {
+        std::memset(payload.data(), i, payload.size());
+        CHECK(pair.sender->SendFrame(FrameType::Data, payload.data(), payload.size()));
+        Frame frame;
+        CHECK(pair.receiver->ReceiveFrame(frame));
+        CHECK(frame.type == FrameType::Data);
+        CHECK(frame.payload == payload);
+    }
+    CHECK(!pair.receiver->PeerClosed());
+}
+
+void
+TestShmLengthPastPublished() {
+    Pair pair;
+    CHECK(pair.receiver != nullptr);
+    if (!pair.receiver) {
+        return;
+    }
+    unsigned char* header = CommitRecord(*pair.sender, 16);
+    CHECK(header != nullptr);
+    uint32_t length = 64;
+    std::memcpy(header, &length, sizeof(length));
+    ExpectCorrupt(pair);
+}
+
+void
+TestShmLengthPastRingEnd() {
+    Pair pair;
+    CHECK(pair.receiver != nullptr);
+    if (!pair.receiver) {
+        return;
+    }
+    unsigned char* header = CommitRecord(*pair.sender, 16);
+    CHECK(header != nullptr);
+    // Mayor que el anillo entero
+    uint32_t length = 0xFFFFFFF0;
+    std::memcpy(header, &length, sizeof(length));
+    ExpectCorrupt(pair);
+}
+
+void
+TestShmShortPadding() {
+    Pair pair;
+    CHECK(pair.receiver != nullptr);
+    if (!pair.receiver) {
+        return;
+    }
+    // Un relleno debe llegar hasta el final del anillo, y aqui solo hay 24 bytes publicados
+    unsigned char* header = CommitRecord(*pair.sender, 16);
+    CHECK(header != nullptr);
+    uint32_t padding = 0xFFFFFFFF;
+    std::memcpy(header, &padding, sizeof(padding));
+    ExpectCorrupt(pair);
+}
+#else
+void
+TestShmUnsupported() {
+    CHECK(ShmChannel::Create(4096) == nullptr);
+}
+#endif
+}
+
+int
+main() {
+    const TestCase tests[] = {
+#ifdef __linux__
+        {"ShmWrapAround", TestShmWrapAround},
+        {"ShmLengthPastPublished", TestShmLengthPastPublished},
+        {"ShmLengthPastRingEnd", TestShmLengthPastRingEnd},
+        {"ShmShortPadding", TestShmShortPadding},
+#else
+        {"ShmUnsupported", TestShmUnsupported},
+#endif
+    };
+    return RunTests(tests);
+}
@@ -0,0 +1,64 @@
+// TimerWheel: vencimientos a cada lado de los limites de nivel, repartos
+// entre niveles y cancelacion antes del reparto
+#include "Check.h"
+#include "TimerWheel.h"
+#include <map>
+#include <set>
+
+namespace {
+void
+TestTimerWheelCascades() {
+    TimerWheel wheel;
+    TimerWheel::Clock::time_point base = TimerWheel::Clock::now();
+    // Justo a cada lado de los limites de nivel (256, 65536, 2^24 ticks) y mas
+    // alla de la rueda (2^32), que se vuelve a colocar al llegar
+    const std::vector<uint64_t> delays = {1,         255,        256,        257,        65535,        65536,
+                                          65537,     70000,      16777215,   16777216,   16777217,     20000000,
+                                          4294967295, 4294967296, 4294967297, 5000000000};
+    std::map<size_t, uint64_t> fired;
+    uint64_t now = 0;
+    std::vector<TimerWheel::TimerId> ids;
+    for (size_t i = 0; i < delays.size(); ++i) {
+        ids.push_back(wheel.Add(base + std::chrono::milliseconds(delays[i]), [&fired, &now, i] { fired[i] = now; }));
+    }
+    // Uno cancelado en el nivel 2 no debe salir tras el reparto
+    bool cancelledFired = false;
+    TimerWheel::TimerId cancelled =
+        wheel.Add(base + std::chrono::milliseconds(70001), [&cancelledFired] { cancelledFired = true; });
+    CHECK(wheel.Cancel(cancelled));
+    CHECK(!wheel.Cancel(cancelled));
+    CHECK(wheel.Size() == delays.size());
+
+    std::set<uint64_t> checkpoints;
+    for (uint64_t delay : delays) {
+        checkpoints.insert(delay - 1);
+        checkpoints.insert(delay);
+        checkpoints.insert(delay + 1);
+    }
+    for (uint64_t checkpoint : checkpoints) {
+        now = checkpoint;
+        wheel.Advance(base + std::chrono::milliseconds(checkpoint));
+        std::function<void()> fn;
+        while (wheel.PopExpired(fn)) {
+            fn();
+        }
+    }
+    CHECK(fired.size() == delays.size());
+    CHECK(!cancelledFired);
+    CHECK(wheel.Size() == 0);
+    for (size_t i = 0; i < delays.size(); ++i) {
+        // Nunca antes del plazo; como mucho un tick tarde por el redondeo de base
+        CHECK(fired.count(i) && fired[i] >= delays[i] && fired[i] <= delays[i] + 1);
+        CHECK(!wheel.Cancel(ids[i]));
+    }
+    CHECK(wheel.NextWakeup() == TimerWheel::Clock::time_point::max());
+}
+}
+
+int
+main() {
+    const TestCase tests[] = {
+        {"TimerWheelCascades", TestTimerWheelCascades},
+    };
+    return RunTests(tests);
+}